@@ -1,13 +1,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
+#include "engine.h"
+#include "latency.h"
+#include "convergence.h"
+#include "model.h"
+#include "match.h"
+#include "policy.h"
+#include "trajectory.h"
+#include "render.h"
 
 #define BOARD_SIZE 3
 
 // Q-learning parameters
 #define LEARNING_RATE 0.2
 #define DISCOUNT_FACTOR 0.5
+#define LAMBDA 0.8 // Eligibility trace decay, 0 for one-step TD
 #define EPSILON 0.2
 
 // Reward values
@@ -15,222 +25,112 @@
 #define DRAW_REWARD 1
 #define LOSS_REWARD -5
 
-// Player symbols
-#define PLAYER_X 'X'
-#define PLAYER_O 'O'
-#define EMPTY_CELL ' '
-
-char board[BOARD_SIZE][BOARD_SIZE]; // Tic-Tac-Toe board
+Position board; // Tic-Tac-Toe board
+Game game; // Board geometry shared with the engine
+Trajectory trajectory; // Moves of the game being played
+Renderer renderer; // Buffered output for the training games
+TdConfig td_config = {LEARNING_RATE, DISCOUNT_FACTOR, LAMBDA, false, WIN_REWARD, DRAW_REWARD, LOSS_REWARD};
 
 // Function to initialize the board
 void initialize_board() {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            board[i][j] = EMPTY_CELL;
-        }
-    }
+    board = (Position){0, 0};
 }
 
 // Function to print the board
 void print_board() {
-    printf("   0   1   2\n");
-    printf("  -----------\n");
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        printf("%d |", i);
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            printf(" %c |", board[i][j]);
-        }
-        printf("\n");
-        printf("  -----------\n");
-    }
+    render_board(&renderer, &game, board);
 }
 
-// Check if the game is over
-bool game_over() {
-    // Check rows
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        if (board[i][0] != EMPTY_CELL && board[i][0] == board[i][1] && board[i][1] == board[i][2])
-            return true;
-    }
-    // Check columns
-    for (int j = 0; j < BOARD_SIZE; j++) {
-        if (board[0][j] != EMPTY_CELL && board[0][j] == board[1][j] && board[1][j] == board[2][j])
-            return true;
-    }
-    // Check diagonals
-    if (board[0][0] != EMPTY_CELL && board[0][0] == board[1][1] && board[1][1] == board[2][2])
-        return true;
-    if (board[0][2] != EMPTY_CELL && board[0][2] == board[1][1] && board[1][1] == board[2][0])
-        return true;
-    // Check for draw
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (board[i][j] == EMPTY_CELL)
-                return false;
-        }
-    }
-    return true;
+// Update Q-values from every move of the game just played
+void update_q_values(const QTable* table) {
+    trajectory.outcome = game_outcome(&game, board);
+    trajectory_apply(&trajectory, &game, table, &td_config);
 }
 
-// Get available actions (empty cells)
-void get_available_actions(int available_actions[][2], int* num_actions) {
-    *num_actions = 0;
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (board[i][j] == EMPTY_CELL) {
-                available_actions[*num_actions][0] = i;
-                available_actions[*num_actions][1] = j;
-                (*num_actions)++;
-            }
-        }
-    }
-}
-
-// Perform a random action
-void random_action(int* row, int* col) {
-    int available_actions[BOARD_SIZE * BOARD_SIZE][2];
-    int num_actions;
-    get_available_actions(available_actions, &num_actions);
-    int random_index = rand() % num_actions;
-    *row = available_actions[random_index][0];
-    *col = available_actions[random_index][1];
-}
+// Play a game between two Q-learning agents, printing it only if show is set
+void play_game(Policy* agent, bool show) {
+    initialize_board();
+    trajectory_clear(&trajectory);
+    int outcome;
 
-// Perform an action based on epsilon-greedy policy
-void epsilon_greedy_action(char player, float q_values[][BOARD_SIZE][BOARD_SIZE], int* row, int* col) {
-    int available_actions[BOARD_SIZE * BOARD_SIZE][2];
-    int num_actions;
-    get_available_actions(available_actions, &num_actions);
-    
-    if ((float)rand() / RAND_MAX < EPSILON) {
-        // Random action
-        random_action(row, col);
+    // Unseen games run in the inlined game loop; shown ones go ply by ply
+    if (!show) {
+        outcome = match_play(&game, agent, agent, &board, &trajectory);
     } else {
-        // Greedy action
-        float max_q_value = -9999.0;
-        for (int i = 0; i < num_actions; i++) {
-            int r = available_actions[i][0];
-            int c = available_actions[i][1];
-            if (q_values[player == PLAYER_X ? 0 : 1][r][c] > max_q_value) {
-                max_q_value = q_values[player == PLAYER_X ? 0 : 1][r][c];
-                *row = r;
-                *col = c;
-            }
-        }
-    }
-}
-
-// Update Q-values based on the outcome of the game
-void update_q_values(float q_values[][BOARD_SIZE][BOARD_SIZE], char winner) {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (board[i][j] == EMPTY_CELL)
-                continue;
-            if (winner == PLAYER_X)
-                q_values[0][i][j] += LEARNING_RATE * (WIN_REWARD - q_values[0][i][j]);
-            else if (winner == PLAYER_O)
-                q_values[1][i][j] += LEARNING_RATE * (WIN_REWARD - q_values[1][i][j]);
-            else
-                q_values[0][i][j] += LEARNING_RATE * (DRAW_REWARD - q_values[0][i][j]);
+        while ((outcome = game_outcome(&game, board)) == OUTCOME_ONGOING) {
+            int side = position_side_to_move(board);
+            render_printf(&renderer, "\nCurrent board:\n");
+            print_board();
+            render_printf(&renderer, "Player %c's turn.\n", side_symbol(side));
+
+            // Both players share the table, one row each
+            int cell = policy_choose_move(agent, &game, board);
+            render_printf(&renderer, "Player %c chooses position (%d, %d).\n", side_symbol(side), cell / BOARD_SIZE, cell % BOARD_SIZE);
+            trajectory_record(&trajectory, board, side, cell);
+            position_make(&board, side, cell);
         }
-    }
-}
 
-// Play a game between two Q-learning agents
-void play_game(float q_values[][BOARD_SIZE][BOARD_SIZE]) {
-    initialize_board();
-    char current_player = PLAYER_X;
-    int num_moves = 0;
-
-    while (!game_over()) {
-        printf("\nCurrent board:\n");
+        render_printf(&renderer, "\nFinal board:\n");
         print_board();
-        printf("Player %c's turn.\n", current_player);
-
-        int row, col;
-        if (current_player == PLAYER_X) {
-            // Player X's turn
-            epsilon_greedy_action(PLAYER_X, q_values, &row, &col);
-        } else {
-            // Player O's turn
-            epsilon_greedy_action(PLAYER_O, q_values, &row, &col);
-        }
-        printf("Player %c chooses position (%d, %d).\n", current_player, row, col);
-        board[row][col] = current_player;
-        num_moves++;
-        current_player = (current_player == PLAYER_X) ? PLAYER_O : PLAYER_X;
-    }
-
-    printf("\nFinal board:\n");
-    print_board();
-
-    // Determine the winner and update Q-values
-    char winner = EMPTY_CELL;
-    if (game_over()) {
-        for (int i = 0; i < BOARD_SIZE; i++) {
-            if (board[i][0] != EMPTY_CELL && board[i][0] == board[i][1] && board[i][1] == board[i][2])
-                winner = board[i][0];
-        }
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (board[0][j] != EMPTY_CELL && board[0][j] == board[1][j] && board[1][j] == board[2][j])
-                winner = board[0][j];
-        }
-        if (board[0][0] != EMPTY_CELL && board[0][0] == board[1][1] && board[1][1] == board[2][2])
-            winner = board[0][0];
-        if (board[0][2] != EMPTY_CELL && board[0][2] == board[1][1] && board[1][1] == board[2][0])
-            winner = board[0][2];
+        render_printf(&renderer, "Game Over!\n");
+        if (outcome == OUTCOME_X_WINS)
+            render_printf(&renderer, "Player X wins!\n");
+        else if (outcome == OUTCOME_O_WINS)
+            render_printf(&renderer, "Player O wins!\n");
+        else
+            render_printf(&renderer, "It's a draw!\n");
     }
-
-    printf("Game Over!\n");
-    if (winner == PLAYER_X)
-        printf("Player X wins!\n");
-    else if (winner == PLAYER_O)
-        printf("Player O wins!\n");
-    else
-        printf("It's a draw!\n");
+    render_game_finished(&renderer, outcome);
 
     // Update Q-values based on the outcome of the game
-    update_q_values(q_values, winner);
+    update_q_values(agent->table);
 }
 
-// Function to save Q-values to a file
-void save_q_values(float q_values[][BOARD_SIZE][BOARD_SIZE], const char* filename) {
-    FILE* file = fopen(filename, "wb");
-    if (file != NULL) {
-        fwrite(q_values, sizeof(float), 2 * BOARD_SIZE * BOARD_SIZE, file);
-        fclose(file);
-    } else {
-        printf("Error: Unable to open file for writing.\n");
-    }
-}
+// Usage: Tic-Tac-Toe-AI-v2 [silent|summary|sampled|all] [show every Nth game when sampled]
+int main(int argc, char* argv[]) {
+    srand(time(NULL)); // Seed for random number generation
+    latency_init_from_env(); // TICTACTOE_LATENCY=1 prints per-move latency percentiles at exit
+    game_init(&game, BOARD_SIZE, BOARD_SIZE);
 
-// Function to load Q-values from a file
-void load_q_values(float q_values[][BOARD_SIZE][BOARD_SIZE], const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (file != NULL) {
-        fread(q_values, sizeof(float), 2 * BOARD_SIZE * BOARD_SIZE, file);
-        fclose(file);
-    } else {
-        printf("Error: Unable to open file for reading.\n");
+    RenderLevel level = RENDER_SAMPLED;
+    if (argc > 1 && render_parse_level(argv[1], &level) != 0) {
+        printf("Invalid verbosity. Use silent, summary, sampled or all.\n");
+        return 1;
+    }
+    if (render_init(&renderer, 1, level, argc > 2 ? atol(argv[2]) : 1000) != 0) {
+        printf("Error: Unable to allocate the output buffer.\n");
+        return 1;
     }
-}
-
-int main() {
-    srand(time(NULL)); // Seed for random number generation
 
     float q_values[2][BOARD_SIZE][BOARD_SIZE] = {0}; // Q-values for player X and player O
+    QTable table = {.values = &q_values[0][0][0], .num_cells = BOARD_SIZE * BOARD_SIZE};
+    Policy agent;
+    policy_init_qtable(&agent, &table, EPSILON, (uint64_t)rand());
 
-    // Train the Q-learning agent by playing multiple games
+    // Train the Q-learning agent until it converges or runs out of episodes
     int num_episodes = 10000;
+    ConvergenceConfig config = convergence_default_config();
+    ConvergenceTracker tracker;
+    convergence_init(&tracker, &config);
     for (int episode = 0; episode < num_episodes; episode++) {
-        play_game(q_values);
+        float before[2][BOARD_SIZE][BOARD_SIZE];
+        memcpy(before, q_values, sizeof(before));
+        play_game(&agent, render_game_visible(&renderer, episode));
+        convergence_record_episode(&tracker, q_delta_norm(&before[0][0][0], &q_values[0][0][0], 2 * BOARD_SIZE * BOARD_SIZE));
+        if (convergence_evaluation_due(&tracker)) {
+            EvaluationResult result;
+            evaluate_against_random(&game, &table, config.eval_games, config.eval_seed, &result);
+            if (convergence_record_evaluation(&tracker, &result))
+                break;
+        }
     }
+    convergence_finish(&tracker, "reached the episode limit");
 
     // Save the learned Q-values to a file
-    save_q_values(q_values, "q_values.dat");
-
-    // Load the Q-values from the file
-    load_q_values(q_values, "q_values.dat");
+    model_save_qtable("q_values.dat", &game, &table);
+    convergence_write_summary(&tracker, "q_values_summary.txt");
+    render_printf(&renderer, "Training stopped after %ld episodes (%s).\n", tracker.episodes, tracker.reason);
+    render_free(&renderer);
 
     return 0;
 }
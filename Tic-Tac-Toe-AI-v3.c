@@ -1,15 +1,31 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
+#include "engine.h"
+#include "latency.h"
+#include "metrics.h"
+#include "batch_inference.h"
+#include "convergence.h"
+#include "model.h"
+#include "policy.h"
+#include "population.h"
+#include "rng.h"
+#include "snapshot.h"
+#include "trajectory.h"
 
 #define BOARD_SIZE 3
-#define NUM_INSTANCES 100
+#define NUM_INSTANCES 100 // Default population, override on the command line
 #define NUM_GENERATIONS 500
+#define SNAPSHOT_FILE "training_state_v3.snap"
+#define SNAPSHOT_INTERVAL 25 // Generations between snapshots of the whole run
 
 // Q-learning parameters
 #define LEARNING_RATE 0.1
 #define DISCOUNT_FACTOR 0.9
+#define LAMBDA 0.8 // Eligibility trace decay, 0 for one-step TD
 #define EPSILON 0.1
 
 // Reward values
@@ -17,282 +33,250 @@
 #define DRAW_REWARD 0
 #define LOSS_REWARD -1
 
-// Player symbols
-#define PLAYER_X 'X'
-#define PLAYER_O 'O'
-#define EMPTY_CELL ' '
+Population population; // Every instance's board, score and Q-values, packed in one arena
+Game game; // Board geometry shared with the engine
+TdConfig td_config = {LEARNING_RATE, DISCOUNT_FACTOR, LAMBDA, false, WIN_REWARD, DRAW_REWARD, LOSS_REWARD};
+Rng rng; // Seeds every batch of moves; unlike rand() its state can be saved
+ConvergenceTracker tracker; // Evaluations so far and when to stop
+Snapshotter snapshotter; // Writes SNAPSHOT_FILE in the background
 
-char boards[NUM_INSTANCES][BOARD_SIZE][BOARD_SIZE]; // Tic-Tac-Toe boards for multiple instances
-int current_players[NUM_INSTANCES]; // Current players for each instance
-float q_values[NUM_INSTANCES][2][BOARD_SIZE][BOARD_SIZE]; // Q-values for each instance
-int wins[NUM_INSTANCES] = {0}; // Number of wins for each instance
+// Counters of the run, saved with every snapshot
+typedef struct {
+    uint64_t num_instances;
+    uint64_t generation; // generations finished
+} RunState;
 
-// Function to initialize the boards and Q-values for all instances
-void initialize_instances() {
-    for (int i = 0; i < NUM_INSTANCES; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            for (int k = 0; k < BOARD_SIZE; k++) {
-                boards[i][j][k] = EMPTY_CELL;
-                q_values[i][0][j][k] = 0;
-                q_values[i][1][j][k] = 0;
-            }
-        }
-        current_players[i] = PLAYER_X;
-    }
+// Function to list everything a snapshot holds: with the population arena
+// (boards, wins, Q-values), the random state and the tracker, the run
+// continues exactly as if it had never stopped
+int snapshot_sections(SnapshotSection* sections, RunState* run) {
+    sections[0] = (SnapshotSection){SNAPSHOT_RUN, run, sizeof(*run)};
+    sections[1] = (SnapshotSection){SNAPSHOT_POPULATION, population.base, (uint64_t)population.count * population.stride};
+    sections[2] = (SnapshotSection){SNAPSHOT_RNG, &rng, sizeof(rng)};
+    sections[3] = (SnapshotSection){SNAPSHOT_CONVERGENCE, &tracker, sizeof(tracker)};
+    return 4;
 }
 
-// Check if a specific instance's game is over
-bool game_over_instance(int instance) {
-    // Check rows
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        if (boards[instance][i][0] != EMPTY_CELL && boards[instance][i][0] == boards[instance][i][1] && boards[instance][i][1] == boards[instance][i][2])
-            return true;
-    }
-    // Check columns
-    for (int j = 0; j < BOARD_SIZE; j++) {
-        if (boards[instance][0][j] != EMPTY_CELL && boards[instance][0][j] == boards[instance][1][j] && boards[instance][1][j] == boards[instance][2][j])
-            return true;
-    }
-    // Check diagonals
-    if (boards[instance][0][0] != EMPTY_CELL && boards[instance][0][0] == boards[instance][1][1] && boards[instance][1][1] == boards[instance][2][2])
-        return true;
-    if (boards[instance][0][2] != EMPTY_CELL && boards[instance][0][2] == boards[instance][1][1] && boards[instance][1][1] == boards[instance][2][0])
-        return true;
-    // Check for draw
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][i][j] == EMPTY_CELL)
-                return false;
-        }
-    }
-    return true;
+// Per-instance scratch for the tile being played, reused from tile to tile
+Trajectory* trajectories; // Moves of the game each instance of the tile is playing
+QTable* tile_tables; // The tile's Q-values, as the engine sees them
+const QTable** tables;
+Position* positions;
+float* epsilons;
+int* active;
+int* moves;
+
+// Function to allocate the scratch for one tile
+bool allocate_tile_scratch(int tile_size) {
+    trajectories = malloc(tile_size * sizeof(Trajectory));
+    tile_tables = malloc(tile_size * sizeof(QTable));
+    tables = malloc(tile_size * sizeof(QTable*));
+    positions = malloc(tile_size * sizeof(Position));
+    epsilons = malloc(tile_size * sizeof(float));
+    active = malloc(tile_size * sizeof(int));
+    moves = malloc(tile_size * sizeof(int));
+    return trajectories != NULL && tile_tables != NULL && tables != NULL && positions != NULL && epsilons != NULL && active != NULL && moves != NULL;
 }
 
-// Get available actions (empty cells) for a specific instance
-void get_available_actions_instance(int instance, int available_actions[][2], int* num_actions) {
-    *num_actions = 0;
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][i][j] == EMPTY_CELL) {
-                available_actions[*num_actions][0] = i;
-                available_actions[*num_actions][1] = j;
-                (*num_actions)++;
-            }
-        }
+// Function to initialize the boards for the instances of a tile
+void initialize_instances(long first, int count) {
+    for (int i = 0; i < count; i++) {
+        population_record(&population, first + i)->board = (Position){0, 0};
+        tile_tables[i] = population_table(&population, first + i);
+        trajectory_clear(&trajectories[i]);
     }
 }
 
-// Perform a random action for a specific instance
-void random_action_instance(int instance, int* row, int* col) {
-    int available_actions[BOARD_SIZE * BOARD_SIZE][2];
-    int num_actions;
-    get_available_actions_instance(instance, available_actions, &num_actions);
-    int random_index = rand() % num_actions;
-    *row = available_actions[random_index][0];
-    *col = available_actions[random_index][1];
+// Score a finished game for an instance of the tile and learn from it;
+// returns the squared change made to its Q-values
+float finish_game_instance(long first, int i) {
+    PopulationRecord* record = population_record(&population, first + i);
+    trajectories[i].outcome = game_outcome(&game, record->board);
+    if (trajectories[i].outcome == OUTCOME_X_WINS)
+        record->wins++;
+    metrics_add_outcome(trajectories[i].outcome, trajectories[i].length);
+    return trajectory_apply(&trajectories[i], &game, &tile_tables[i], &td_config);
 }
 
-// Perform an action based on epsilon-greedy policy for a specific instance
-void epsilon_greedy_action_instance(int instance, float q_values_instance[][BOARD_SIZE][BOARD_SIZE], int* row, int* col) {
-    int available_actions[BOARD_SIZE * BOARD_SIZE][2];
-    int num_actions;
-    get_available_actions_instance(instance, available_actions, &num_actions);
-    
-    if ((float)rand() / RAND_MAX < EPSILON) {
-        // Random action
-        random_action_instance(instance, row, col);
-    } else {
-        // Greedy action
-        float max_q_value = -9999.0;
-        for (int i = 0; i < num_actions; i++) {
-            int r = available_actions[i][0];
-            int c = available_actions[i][1];
-            if (q_values_instance[current_players[instance] == PLAYER_X ? 0 : 1][r][c] > max_q_value) {
-                max_q_value = q_values_instance[current_players[instance] == PLAYER_X ? 0 : 1][r][c];
-                *row = r;
-                *col = c;
-            }
+// Play one game per instance of a tile in lockstep: each ply's moves for all
+// unfinished games are chosen with a single batch call
+double play_tile(long first, int count) {
+    initialize_instances(first, count);
+    uint64_t phase = metrics_phase_begin();
+    while (true) {
+        int num_active = 0;
+        for (int i = 0; i < count; i++) {
+            Position board = population_record(&population, first + i)->board;
+            if (game_outcome(&game, board) != OUTCOME_ONGOING)
+                continue;
+            active[num_active] = i;
+            positions[num_active] = board;
+            epsilons[num_active] = EPSILON;
+            tables[num_active] = &tile_tables[i];
+            num_active++;
         }
-    }
-}
+        if (num_active == 0)
+            break;
 
-// Update Q-values based on the outcome of the game for a specific instance
-void update_q_values_instance(int instance, char winner) {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][i][j] == EMPTY_CELL)
-                continue;
-            if (winner == PLAYER_X)
-                q_values[instance][0][i][j] += LEARNING_RATE * (WIN_REWARD - q_values[instance][0][i][j]);
-            else if (winner == PLAYER_O)
-                q_values[instance][1][i][j] += LEARNING_RATE * (WIN_REWARD - q_values[instance][1][i][j]);
-            else
-                q_values[instance][0][i][j] += LEARNING_RATE * (DRAW_REWARD - q_values[instance][0][i][j]);
+        BatchRequest request = {.game = &game, .tables = tables, .epsilons = epsilons, .seed = rng_next(&rng), .num_threads = 1};
+        choose_moves_batch(&request, positions, NULL, num_active, moves);
+        for (int k = 0; k < num_active; k++) {
+            int i = active[k];
+            int side = position_side_to_move(positions[k]);
+            trajectory_record(&trajectories[i], positions[k], side, moves[k]);
+            position_make(&population_record(&population, first + i)->board, side, moves[k]);
         }
     }
-}
 
-// Function to save Q-values to a file for a specific instance
-void save_q_values_instance(int instance, float q_values_instance[][BOARD_SIZE][BOARD_SIZE], const char* filename) {
-    FILE* file = fopen(filename, "wb");
-    if (file != NULL) {
-        fwrite(q_values_instance, sizeof(float), 2 * BOARD_SIZE * BOARD_SIZE, file);
-        fclose(file);
-    } else {
-        printf("Error: Unable to open file for writing.\n");
-    }
-}
+    metrics_phase_end(METRIC_PLAY, phase);
 
-// Function to load Q-values from a file for a specific instance
-void load_q_values_instance(int instance, float q_values_instance[][BOARD_SIZE][BOARD_SIZE], const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (file != NULL) {
-        fread(q_values_instance, sizeof(float), 2 * BOARD_SIZE * BOARD_SIZE, file);
-        fclose(file);
-    } else {
-        printf("Error: Unable to open file for reading.\n");
-    }
+    phase = metrics_phase_begin();
+    double change = 0;
+    for (int i = 0; i < count; i++)
+        change += finish_game_instance(first, i);
+    metrics_phase_end(METRIC_LEARN, phase);
+    return change;
 }
 
-
-// Play a game between two Q-learning agents for a specific instance
-void play_game_instance(int instance) {
-    while (!game_over_instance(instance)) {
-        int row, col;
-        epsilon_greedy_action_instance(instance, q_values[instance], &row, &col);
-        boards[instance][row][col] = current_players[instance];
-        current_players[instance] = (current_players[instance] == PLAYER_X) ? PLAYER_O : PLAYER_X;
-    }
-
-    // Determine the winner and update Q-values
-    char winner = EMPTY_CELL;
-    if (game_over_instance(instance)) {
-        for (int i = 0; i < BOARD_SIZE; i++) {
-            if (boards[instance][i][0] != EMPTY_CELL && boards[instance][i][0] == boards[instance][i][1] && boards[instance][i][1] == boards[instance][i][2])
-                winner = boards[instance][i][0];
-        }
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][0][j] != EMPTY_CELL && boards[instance][0][j] == boards[instance][1][j] && boards[instance][1][j] == boards[instance][2][j])
-                winner = boards[instance][0][j];
-        }
-        if (boards[instance][0][0] != EMPTY_CELL && boards[instance][0][0] == boards[instance][1][1] && boards[instance][1][1] == boards[instance][2][2])
-            winner = boards[instance][0][0];
-        if (boards[instance][0][2] != EMPTY_CELL && boards[instance][0][2] == boards[instance][1][1] && boards[instance][1][1] == boards[instance][2][0])
-            winner = boards[instance][0][2];
+// Play one game per instance, a cache-sized tile at a time; returns the
+// squared change made to all Q-values
+double play_generation() {
+    double change = 0;
+    for (long first = 0; first < population.count; first += population.tile_size) {
+        long left = population.count - first;
+        change += play_tile(first, left < population.tile_size ? (int)left : population.tile_size);
     }
-    if (winner == PLAYER_X)
-        wins[instance]++;
-
-    update_q_values_instance(instance, winner);
+    return change;
 }
 
 // Find the instance with the highest win rate
-int find_best_instance() {
-    int best_instance = 0;
-    float max_win_rate = (float)wins[0] / NUM_GENERATIONS;
-    for (int i = 1; i < NUM_INSTANCES; i++) {
-        float win_rate = (float)wins[i] / NUM_GENERATIONS;
-        if (win_rate > max_win_rate) {
-            max_win_rate = win_rate;
+long find_best_instance() {
+    long best_instance = 0;
+    uint32_t max_wins = population_record(&population, 0)->wins;
+    for (long i = 1; i < population.count; i++) {
+        uint32_t wins = population_record(&population, i)->wins;
+        if (wins > max_wins) {
+            max_wins = wins;
             best_instance = i;
         }
     }
     return best_instance;
 }
 
-// Function to initialize the board for a specific instance
-void initialize_board_instance(int instance) {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            boards[instance][i][j] = EMPTY_CELL;
-        }
-    }
-}
-
-// Function to print the board for a specific instance
-void print_board_instance(int instance) {
-    printf("   0   1   2\n");
-    printf("  -----------\n");
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        printf("%d |", i);
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            printf(" %c |", boards[instance][i][j]);
-        }
-        printf("\n");
-        printf("  -----------\n");
-    }
-}
-
-
 // Display the full game of the best instance in the last generation
 void display_best_instance_game() {
-    int best_instance = find_best_instance();
+    long best_instance = find_best_instance();
+    QTable table = population_table(&population, best_instance);
     printf("\nBest instance's game (Player X vs Player O):\n");
-    printf("Instance: %d\n", best_instance + 1);
-    initialize_board_instance(best_instance);
-    char current_player = PLAYER_X;
-    while (!game_over_instance(best_instance)) {
+    printf("Instance: %ld\n", best_instance + 1);
+    Policy agent;
+    policy_init_qtable(&agent, &table, EPSILON, rng_next(&rng));
+    Position board = {0, 0};
+    int outcome;
+    while ((outcome = game_outcome(&game, board)) == OUTCOME_ONGOING) {
+        char current_player = side_symbol(position_side_to_move(board));
         printf("\nCurrent board:\n");
-        print_board_instance(best_instance);
+        game_print_board(&game, board);
         printf("Player %c's turn.\n", current_player);
 
-        int row, col;
-        if (current_player == PLAYER_X) {
-            // Player X's turn
-            epsilon_greedy_action_instance(best_instance, q_values[best_instance], &row, &col);
-        } else {
-            // Player O's turn
-            epsilon_greedy_action_instance(best_instance, q_values[best_instance], &row, &col);
-        }
-        printf("Player %c chooses position (%d, %d).\n", current_player, row, col);
-        boards[best_instance][row][col] = current_player;
-        current_player = (current_player == PLAYER_X) ? PLAYER_O : PLAYER_X;
+        int cell = policy_choose_move(&agent, &game, board);
+        printf("Player %c chooses position (%d, %d).\n", current_player, cell / BOARD_SIZE, cell % BOARD_SIZE);
+        position_make(&board, side_index(current_player), cell);
     }
 
     printf("\nFinal board:\n");
-    print_board_instance(best_instance);
-
-    // Determine the winner
-    char winner = EMPTY_CELL;
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        if (boards[best_instance][i][0] != EMPTY_CELL && boards[best_instance][i][0] == boards[best_instance][i][1] && boards[best_instance][i][1] == boards[best_instance][i][2])
-            winner = boards[best_instance][i][0];
-    }
-    for (int j = 0; j < BOARD_SIZE; j++) {
-        if (boards[best_instance][0][j] != EMPTY_CELL && boards[best_instance][0][j] == boards[best_instance][1][j] && boards[best_instance][1][j] == boards[best_instance][2][j])
-            winner = boards[best_instance][0][j];
-    }
-    if (boards[best_instance][0][0] != EMPTY_CELL && boards[best_instance][0][0] == boards[best_instance][1][1] && boards[best_instance][1][1] == boards[best_instance][2][2])
-        winner = boards[best_instance][0][0];
-    if (boards[best_instance][0][2] != EMPTY_CELL && boards[best_instance][0][2] == boards[best_instance][1][1] && boards[best_instance][1][1] == boards[best_instance][2][0])
-        winner = boards[best_instance][0][2];
+    game_print_board(&game, board);
 
     printf("Game Over!\n");
-    if (winner == PLAYER_X)
+    if (outcome == OUTCOME_X_WINS)
         printf("Player X wins!\n");
-    else if (winner == PLAYER_O)
+    else if (outcome == OUTCOME_O_WINS)
         printf("Player O wins!\n");
     else
         printf("It's a draw!\n");
 }
 
-int main() {
-    srand(time(NULL)); // Seed for random number generation
+// Usage: Tic-Tac-Toe-AI-v3 [population] [--seed S] [--resume]
+// --resume picks the run up from the last snapshot in SNAPSHOT_FILE
+int main(int argc, char* argv[]) {
+    latency_init_from_env(); // TICTACTOE_LATENCY=1 prints per-move latency percentiles at exit
+    metrics_init_from_env(); // TICTACTOE_METRICS=9100 serves Prometheus metrics at /metrics
+    metrics_set(METRIC_EPSILON, EPSILON);
+    game_init(&game, BOARD_SIZE, BOARD_SIZE);
+    RunState run = {NUM_INSTANCES, 0};
+    rng_seed(&rng, (uint64_t)time(NULL)); // Seed for random number generation
+    bool resume = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--resume") == 0)
+            resume = true;
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            rng_seed(&rng, strtoull(argv[++i], NULL, 10));
+        else
+            run.num_instances = (uint64_t)atol(argv[i]);
+    }
+    // On resume the run counters come first, to size the population
+    SnapshotSection counters = {SNAPSHOT_RUN, &run, sizeof(run)};
+    if (resume && snapshot_load(SNAPSHOT_FILE, &counters, 1) != 0)
+        return 1;
+    long num_instances = (long)run.num_instances;
+    // Tiles are sized by the scratch as allocated: a whole Trajectory holds
+    // TRAJECTORY_CAPACITY steps however few a 3x3 game uses
+    size_t scratch = sizeof(Trajectory) + sizeof(QTable) + sizeof(QTable*) + sizeof(Position) + sizeof(float) + 2 * sizeof(int);
+    if (population_init(&population, &game, num_instances, scratch) != 0 || !allocate_tile_scratch(population.tile_size)) {
+        printf("Error: Unable to allocate a population of %ld instances.\n", num_instances);
+        return 1;
+    }
+    printf("%ld instances, %zu bytes each, %d per tile%s\n", population.count, population.stride, population.tile_size,
+           population.huge_pages ? ", on huge pages" : "");
 
-    // Train the Q-learning agents by playing multiple games
-    for (int generation = 0; generation < NUM_GENERATIONS; generation++) {
-        initialize_instances();
-        for (int instance = 0; instance < NUM_INSTANCES; instance++) {
-            play_game_instance(instance);
+    // Train the Q-learning agents until they converge or run out of generations.
+    // Q-values start at zero once and carry over from generation to generation.
+    ConvergenceConfig config = convergence_default_config();
+    config.eval_interval = 10;
+    convergence_init(&tracker, &config);
+    SnapshotSection sections[SNAPSHOT_MAX_SECTIONS];
+    int num_sections = snapshot_sections(sections, &run);
+    if (resume) {
+        if (snapshot_load(SNAPSHOT_FILE, sections, num_sections) != 0)
+            return 1;
+        printf("Resuming after generation %llu.\n", (unsigned long long)run.generation);
+    }
+    snapshot_init(&snapshotter, SNAPSHOT_FILE);
+    for (int generation = (int)run.generation; generation < NUM_GENERATIONS; generation++) {
+        double change = play_generation();
+        metrics_set(METRIC_Q_DELTA, sqrt(change));
+        convergence_record_episode(&tracker, (float)sqrt(change));
+        if (convergence_evaluation_due(&tracker)) {
+            EvaluationResult result;
+            QTable table = population_table(&population, find_best_instance());
+            uint64_t phase = metrics_phase_begin();
+            evaluate_against_random(&game, &table, config.eval_games, config.eval_seed, &result);
+            metrics_phase_end(METRIC_EVALUATE, phase);
+            metrics_set(METRIC_EVAL_WIN_RATE, (double)result.wins / result.games);
+            metrics_set(METRIC_EVAL_DRAW_RATE, (double)result.draws / result.games);
+            metrics_set(METRIC_EVAL_LOSS_RATE, (double)result.losses / result.games);
+            if (convergence_record_evaluation(&tracker, &result))
+                break;
+        }
+        if ((generation + 1) % SNAPSHOT_INTERVAL == 0) {
+            run.generation = (uint64_t)generation + 1;
+            uint64_t phase = metrics_phase_begin();
+            snapshot_save(&snapshotter, sections, num_sections);
+            metrics_phase_end(METRIC_CHECKPOINT, phase);
         }
     }
+    snapshot_wait(&snapshotter);
+    convergence_finish(&tracker, "reached the generation limit");
     
     //Save the q_values for the best instance in the generation
-    int best_instance = find_best_instance();
-    save_q_values_instance(best_instance, q_values[best_instance], "best_instance_q_values.dat");
+    QTable best_table = population_table(&population, find_best_instance());
+    model_save_qtable("best_instance_q_values.dat", &game, &best_table);
+    convergence_write_summary(&tracker, "best_instance_q_values_summary.txt");
+    printf("Training stopped after %ld generations (%s).\n", tracker.episodes, tracker.reason);
 
     // Display the full game of the best instance in the last generation
     display_best_instance_game();
 
+    population_free(&population);
     return 0;
 }
@@ -1,15 +1,30 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
+#include "engine.h"
+#include "latency.h"
+#include "convergence.h"
+#include "model.h"
+#include "match.h"
+#include "metrics.h"
+#include "policy.h"
+#include "population.h"
+#include "snapshot.h"
+#include "trajectory.h"
 
 #define BOARD_SIZE 3
-#define NUM_INSTANCES 50
+#define NUM_INSTANCES 50 // Default population, override on the command line
 #define NUM_GENERATIONS 100
+#define SNAPSHOT_FILE "training_state_v4.snap"
+#define SNAPSHOT_INTERVAL 10 // Generations between snapshots of the whole run
 
 // Q-learning parameters
 #define LEARNING_RATE 0.1
 #define DISCOUNT_FACTOR 0.9
+#define LAMBDA 0.8 // Eligibility trace decay, 0 for one-step TD
 #define INITIAL_EPSILON 0.5 // Initial value for epsilon
 #define EPSILON_DECAY_RATE 0.01 // Rate at which epsilon decreases over time
 
@@ -18,218 +33,68 @@
 #define DRAW_REWARD 0
 #define LOSS_REWARD -1
 
-// Player symbols
-#define PLAYER_X 'X'
-#define PLAYER_O 'O'
-#define EMPTY_CELL ' '
-
-char boards[NUM_INSTANCES][BOARD_SIZE][BOARD_SIZE]; // Tic-Tac-Toe boards for multiple instances
-int current_players[NUM_INSTANCES]; // Current players for each instance
-float q_values[NUM_INSTANCES][2][BOARD_SIZE][BOARD_SIZE]; // Q-values for each instance
-int wins[NUM_INSTANCES] = {0}; // Number of wins for each instance
+Population population; // Every instance's board, score and Q-values, packed in one arena
+QTable agent_table; // Q-values of the instance the agent is playing for
+Policy agent; // Epsilon-greedy player on agent_table
 float epsilon = INITIAL_EPSILON; // Initial value for epsilon
-
-// Function to initialize the board for a specific instance
-void initialize_board_instance(int instance) {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            boards[instance][i][j] = EMPTY_CELL;
-        }
-    }
-}
-
-// Function to print the board for a specific instance
-void print_board_instance(int instance) {
-    printf("   0   1   2\n");
-    printf("  -----------\n");
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        printf("%d |", i);
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            printf(" %c |", boards[instance][i][j]);
-        }
-        printf("\n");
-        printf("  -----------\n");
-    }
-}
-
-// Check if a specific instance's game is over
-bool game_over_instance(int instance) {
-    // Check rows
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        if (boards[instance][i][0] != EMPTY_CELL && boards[instance][i][0] == boards[instance][i][1] && boards[instance][i][1] == boards[instance][i][2])
-            return true;
-    }
-    // Check columns
-    for (int j = 0; j < BOARD_SIZE; j++) {
-        if (boards[instance][0][j] != EMPTY_CELL && boards[instance][0][j] == boards[instance][1][j] && boards[instance][1][j] == boards[instance][2][j])
-            return true;
-    }
-    // Check diagonals
-    if (boards[instance][0][0] != EMPTY_CELL && boards[instance][0][0] == boards[instance][1][1] && boards[instance][1][1] == boards[instance][2][2])
-        return true;
-    if (boards[instance][0][2] != EMPTY_CELL && boards[instance][0][2] == boards[instance][1][1] && boards[instance][1][1] == boards[instance][2][0])
-        return true;
-    // Check for draw
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][i][j] == EMPTY_CELL)
-                return false;
-        }
-    }
-    return true;
-}
-
-// Get available actions (empty cells) for a specific instance
-void get_available_actions_instance(int instance, int available_actions[][2], int* num_actions) {
-    *num_actions = 0;
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][i][j] == EMPTY_CELL) {
-                available_actions[*num_actions][0] = i;
-                available_actions[*num_actions][1] = j;
-                (*num_actions)++;
-            }
-        }
-    }
-}
-
-// Perform a random action for a specific instance
-void random_action_instance(int instance, int* row, int* col) {
-    int available_actions[BOARD_SIZE * BOARD_SIZE][2];
-    int num_actions;
-    get_available_actions_instance(instance, available_actions, &num_actions);
-    int random_index = rand() % num_actions;
-    *row = available_actions[random_index][0];
-    *col = available_actions[random_index][1];
-}
-
-// Perform an action based on ε-greedy policy for a specific instance
-void epsilon_greedy_action_instance(int instance, float q_values_instance[][BOARD_SIZE][BOARD_SIZE], int* row, int* col) {
-    int available_actions[BOARD_SIZE * BOARD_SIZE][2];
-    int num_actions;
-    get_available_actions_instance(instance, available_actions, &num_actions);
-    
-    if ((float)rand() / RAND_MAX < epsilon) {
-        // Random action (exploration)
-        random_action_instance(instance, row, col);
-    } else {
-        // Greedy action (exploitation)
-        float max_q_value = -9999.0;
-        for (int i = 0; i < num_actions; i++) {
-            int r = available_actions[i][0];
-            int c = available_actions[i][1];
-            if (q_values_instance[current_players[instance] == PLAYER_X ? 0 : 1][r][c] > max_q_value) {
-                max_q_value = q_values_instance[current_players[instance] == PLAYER_X ? 0 : 1][r][c];
-                *row = r;
-                *col = c;
-            }
-        }
-    }
-}
-
-// Update Q-values based on the outcome of the game for a specific instance
-void update_q_values_instance(int instance, char winner) {
-    char opponent = (current_players[instance] == PLAYER_X) ? PLAYER_O : PLAYER_X;
-
-    // Determine the reward for each cell based on the outcome
-    float rewards[BOARD_SIZE][BOARD_SIZE];
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][i][j] == EMPTY_CELL) {
-                if (winner == current_players[instance]) {
-                    rewards[i][j] = WIN_REWARD;
-                } else if (winner == opponent && (boards[instance][(i+1)%3][j] == opponent || boards[instance][(i+2)%3][j] == opponent ||
-                                                   boards[instance][i][(j+1)%3] == opponent || boards[instance][i][(j+2)%3] == opponent ||
-                                                   boards[instance][(i+1)%3][(j+1)%3] == opponent || boards[instance][(i+2)%3][(j+2)%3] == opponent ||
-                                                   boards[instance][(i+1)%3][(j+2)%3] == opponent || boards[instance][(i+2)%3][(j+1)%3] == opponent)) {
-                    rewards[i][j] = LOSS_REWARD * 2;
-                } else {
-                    rewards[i][j] = DRAW_REWARD;
-                }
-            } else {
-                rewards[i][j] = 0;
-            }
-        }
-    }
-
-    // Update Q-values using the rewards
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][i][j] == EMPTY_CELL) {
-                if (winner == current_players[instance]) {
-                    q_values[instance][current_players[instance] == PLAYER_X ? 0 : 1][i][j] += LEARNING_RATE * (rewards[i][j] - q_values[instance][current_players[instance] == PLAYER_X ? 0 : 1][i][j]);
-                } else if (winner == opponent) {
-                    q_values[instance][current_players[instance] == PLAYER_X ? 0 : 1][i][j] += LEARNING_RATE * (rewards[i][j] - q_values[instance][current_players[instance] == PLAYER_X ? 0 : 1][i][j]);
-                } else {
-                    q_values[instance][current_players[instance] == PLAYER_X ? 0 : 1][i][j] += LEARNING_RATE * (rewards[i][j] - q_values[instance][current_players[instance] == PLAYER_X ? 0 : 1][i][j]);
-                }
-            }
-        }
-    }
+Game game; // Board geometry shared with the engine
+Trajectory trajectory; // Moves of the game being played
+TdConfig td_config = {LEARNING_RATE, DISCOUNT_FACTOR, LAMBDA, false, WIN_REWARD, DRAW_REWARD, LOSS_REWARD};
+ConvergenceTracker tracker; // Evaluations so far and when to stop
+Snapshotter snapshotter; // Writes SNAPSHOT_FILE in the background
+
+// Counters of the run, saved with every snapshot
+typedef struct {
+    uint64_t num_instances;
+    uint64_t generation; // generations finished
+    float epsilon;
+    uint32_t reserved;
+} RunState;
+
+// Function to list everything a snapshot holds: with the population arena
+// (boards, wins, Q-values), the agent's random state and the tracker, the
+// run continues exactly as if it had never stopped
+int snapshot_sections(SnapshotSection* sections, RunState* run) {
+    sections[0] = (SnapshotSection){SNAPSHOT_RUN, run, sizeof(*run)};
+    sections[1] = (SnapshotSection){SNAPSHOT_POPULATION, population.base, (uint64_t)population.count * population.stride};
+    sections[2] = (SnapshotSection){SNAPSHOT_RNG, &agent.rng, sizeof(agent.rng)};
+    sections[3] = (SnapshotSection){SNAPSHOT_CONVERGENCE, &tracker, sizeof(tracker)};
+    return 4;
 }
 
-
-// Function to save Q-values to a file for a specific instance
-void save_q_values_instance(int instance, float q_values_instance[][BOARD_SIZE][BOARD_SIZE], const char* filename) {
-    FILE* file = fopen(filename, "wb");
-    if (file != NULL) {
-        fwrite(q_values_instance, sizeof(float), 2 * BOARD_SIZE * BOARD_SIZE, file);
-        fclose(file);
-    } else {
-        printf("Error: Unable to open file for writing.\n");
-    }
+// Function to initialize the board for a specific instance
+void initialize_board_instance(long instance) {
+    population_record(&population, instance)->board = (Position){0, 0};
 }
 
-// Function to load Q-values from a file for a specific instance
-void load_q_values_instance(int instance, float q_values_instance[][BOARD_SIZE][BOARD_SIZE], const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (file != NULL) {
-        fread(q_values_instance, sizeof(float), 2 * BOARD_SIZE * BOARD_SIZE, file);
-        fclose(file);
-    } else {
-        printf("Error: Unable to open file for reading.\n");
-    }
+// Update Q-values from every move of the game a specific instance just played;
+// returns the squared change made to them
+float update_q_values_instance(long instance) {
+    return trajectory_apply(&trajectory, &game, &agent_table, &td_config);
 }
 
 // Play a game between two Q-learning agents for a specific instance
-void play_game_instance(int instance) {
-    while (!game_over_instance(instance)) {
-        int row, col;
-        epsilon_greedy_action_instance(instance, q_values[instance], &row, &col);
-        boards[instance][row][col] = current_players[instance];
-        current_players[instance] = (current_players[instance] == PLAYER_X) ? PLAYER_O : PLAYER_X;
-    }
+float play_game_instance(long instance) {
+    PopulationRecord* record = population_record(&population, instance);
+    agent_table = population_table(&population, instance);
+    agent.epsilon = epsilon;
+    trajectory_clear(&trajectory);
+    int outcome = match_play(&game, &agent, &agent, &record->board, &trajectory);
 
-    // Determine the winner and update Q-values
-    char winner = EMPTY_CELL;
-    if (game_over_instance(instance)) {
-        for (int i = 0; i < BOARD_SIZE; i++) {
-            if (boards[instance][i][0] != EMPTY_CELL && boards[instance][i][0] == boards[instance][i][1] && boards[instance][i][1] == boards[instance][i][2])
-                winner = boards[instance][i][0];
-        }
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (boards[instance][0][j] != EMPTY_CELL && boards[instance][0][j] == boards[instance][1][j] && boards[instance][1][j] == boards[instance][2][j])
-                winner = boards[instance][0][j];
-        }
-        if (boards[instance][0][0] != EMPTY_CELL && boards[instance][0][0] == boards[instance][1][1] && boards[instance][1][1] == boards[instance][2][2])
-            winner = boards[instance][0][0];
-        if (boards[instance][0][2] != EMPTY_CELL && boards[instance][0][2] == boards[instance][1][1] && boards[instance][1][1] == boards[instance][2][0])
-            winner = boards[instance][0][2];
-    }
-    if (winner == PLAYER_X)
-        wins[instance]++;
+    if (outcome == OUTCOME_X_WINS)
+        record->wins++;
 
-    update_q_values_instance(instance, winner);
+    return update_q_values_instance(instance);
 }
 
 // Find the instance with the highest win rate
-int find_best_instance() {
-    int best_instance = 0;
-    float max_win_rate = (float)wins[0] / NUM_GENERATIONS;
-    for (int i = 1; i < NUM_INSTANCES; i++) {
-        float win_rate = (float)wins[i] / NUM_GENERATIONS;
-        if (win_rate > max_win_rate) {
-            max_win_rate = win_rate;
+long find_best_instance() {
+    long best_instance = 0;
+    uint32_t max_wins = population_record(&population, 0)->wins;
+    for (long i = 1; i < population.count; i++) {
+        uint32_t wins = population_record(&population, i)->wins;
+        if (wins > max_wins) {
+            max_wins = wins;
             best_instance = i;
         }
     }
@@ -238,73 +103,111 @@ int find_best_instance() {
 
 // Display the full game of the best instance in the last generation
 void display_best_instance_game() {
-    int best_instance = find_best_instance();
+    long best_instance = find_best_instance();
+    PopulationRecord* record = population_record(&population, best_instance);
     printf("\nBest instance's game (Player X vs Player O):\n");
-    printf("Instance: %d\n", best_instance + 1);
+    printf("Instance: %ld\n", best_instance + 1);
     initialize_board_instance(best_instance);
-    char current_player = PLAYER_X;
-    while (!game_over_instance(best_instance)) {
+    agent_table = population_table(&population, best_instance);
+    agent.epsilon = epsilon;
+    int outcome;
+    while ((outcome = game_outcome(&game, record->board)) == OUTCOME_ONGOING) {
+        char current_player = side_symbol(position_side_to_move(record->board));
         printf("\nCurrent board:\n");
-        print_board_instance(best_instance);
+        game_print_board(&game, record->board);
         printf("Player %c's turn.\n", current_player);
 
-        int row, col;
-        if (current_player == PLAYER_X) {
-            // Player X's turn
-            epsilon_greedy_action_instance(best_instance, q_values[best_instance], &row, &col);
-        } else {
-            // Player O's turn
-            epsilon_greedy_action_instance(best_instance, q_values[best_instance], &row, &col);
-        }
-        printf("Player %c chooses position (%d, %d).\n", current_player, row, col);
-        boards[best_instance][row][col] = current_player;
-        current_player = (current_player == PLAYER_X) ? PLAYER_O : PLAYER_X;
+        int cell = policy_choose_move(&agent, &game, record->board);
+        printf("Player %c chooses position (%d, %d).\n", current_player, cell / BOARD_SIZE, cell % BOARD_SIZE);
+        position_make(&record->board, side_index(current_player), cell);
     }
 
     printf("\nFinal board:\n");
-    print_board_instance(best_instance);
-
-    // Determine the winner
-    char winner = EMPTY_CELL;
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        if (boards[best_instance][i][0] != EMPTY_CELL && boards[best_instance][i][0] == boards[best_instance][i][1] && boards[best_instance][i][1] == boards[best_instance][i][2])
-            winner = boards[best_instance][i][0];
-    }
-    for (int j = 0; j < BOARD_SIZE; j++) {
-        if (boards[best_instance][0][j] != EMPTY_CELL && boards[best_instance][0][j] == boards[best_instance][1][j] && boards[best_instance][1][j] == boards[best_instance][2][j])
-            winner = boards[best_instance][0][j];
-    }
-    if (boards[best_instance][0][0] != EMPTY_CELL && boards[best_instance][0][0] == boards[best_instance][1][1] && boards[best_instance][1][1] == boards[best_instance][2][2])
-        winner = boards[best_instance][0][0];
-    if (boards[best_instance][0][2] != EMPTY_CELL && boards[best_instance][0][2] == boards[best_instance][1][1] && boards[best_instance][1][1] == boards[best_instance][2][0])
-        winner = boards[best_instance][0][2];
+    game_print_board(&game, record->board);
 
     printf("Game Over!\n");
-    if (winner == PLAYER_X)
+    if (outcome == OUTCOME_X_WINS)
         printf("Player X wins!\n");
-    else if (winner == PLAYER_O)
+    else if (outcome == OUTCOME_O_WINS)
         printf("Player O wins!\n");
     else
         printf("It's a draw!\n");
 }
 
-int main() {
+// Usage: Tic-Tac-Toe-AI-v4 [population] [--seed S] [--resume]
+// --resume picks the run up from the last snapshot in SNAPSHOT_FILE
+int main(int argc, char* argv[]) {
     srand(time(NULL)); // Seed for random number generation
-
-    // Train the Q-learning agents by playing multiple games
-    for (int generation = 0; generation < NUM_GENERATIONS; generation++) {
-        initialize_board_instance(generation % NUM_INSTANCES); // Initialize the board for each instance
-        current_players[generation % NUM_INSTANCES] = PLAYER_X; // Set the current player for each instance
-        play_game_instance(generation % NUM_INSTANCES); // Play a game for each instance
+    latency_init_from_env(); // TICTACTOE_LATENCY=1 prints per-move latency percentiles at exit
+    metrics_init_from_env(); // TICTACTOE_METRICS=9100 serves Prometheus metrics at /metrics
+    game_init(&game, BOARD_SIZE, BOARD_SIZE);
+    RunState run = {NUM_INSTANCES, 0, INITIAL_EPSILON, 0};
+    uint64_t seed = (uint64_t)rand();
+    bool resume = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--resume") == 0)
+            resume = true;
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+            run.num_instances = (uint64_t)atol(argv[i]);
+    }
+    // On resume the run counters come first, to size the population
+    SnapshotSection counters = {SNAPSHOT_RUN, &run, sizeof(run)};
+    if (resume && snapshot_load(SNAPSHOT_FILE, &counters, 1) != 0)
+        return 1;
+    if (population_init(&population, &game, (long)run.num_instances, 0) != 0) {
+        printf("Error: Unable to allocate a population of %llu instances.\n", (unsigned long long)run.num_instances);
+        return 1;
+    }
+    policy_init_qtable(&agent, &agent_table, epsilon, seed);
+
+    // Train the Q-learning agents until they converge or run out of generations
+    ConvergenceConfig config = convergence_default_config();
+    config.eval_interval = 10;
+    convergence_init(&tracker, &config);
+    SnapshotSection sections[SNAPSHOT_MAX_SECTIONS];
+    int num_sections = snapshot_sections(sections, &run);
+    if (resume) {
+        if (snapshot_load(SNAPSHOT_FILE, sections, num_sections) != 0)
+            return 1;
+        epsilon = run.epsilon;
+        printf("Resuming after generation %llu.\n", (unsigned long long)run.generation);
+    }
+    snapshot_init(&snapshotter, SNAPSHOT_FILE);
+    for (int generation = (int)run.generation; generation < NUM_GENERATIONS; generation++) {
+        long instance = generation % population.count;
+        initialize_board_instance(instance); // Initialize the board for each instance
+        float change = play_game_instance(instance); // Play a game for each instance
         epsilon -= EPSILON_DECAY_RATE; // Decrease epsilon over time
+        metrics_set(METRIC_EPSILON, epsilon);
+        metrics_set(METRIC_Q_DELTA, sqrtf(change));
+        convergence_record_episode(&tracker, sqrtf(change));
+        if (convergence_evaluation_due(&tracker)) {
+            EvaluationResult result;
+            QTable table = population_table(&population, find_best_instance());
+            evaluate_against_random(&game, &table, config.eval_games, config.eval_seed, &result);
+            if (convergence_record_evaluation(&tracker, &result))
+                break;
+        }
+        if ((generation + 1) % SNAPSHOT_INTERVAL == 0) {
+            run.generation = (uint64_t)generation + 1;
+            run.epsilon = epsilon;
+            snapshot_save(&snapshotter, sections, num_sections);
+        }
     }
+    snapshot_wait(&snapshotter);
+    convergence_finish(&tracker, "reached the generation limit");
 
     // Display the full game of the best instance in the last generation
     display_best_instance_game();
 
     // Save Q-values for the best instance
-    int best_instance = find_best_instance();
-    save_q_values_instance(best_instance, q_values[best_instance], "best_instance_q_values_v4.dat");
+    QTable best_table = population_table(&population, find_best_instance());
+    model_save_qtable("best_instance_q_values_v4.dat", &game, &best_table);
+    convergence_write_summary(&tracker, "best_instance_q_values_v4_summary.txt");
+    printf("Training stopped after %ld generations (%s).\n", tracker.episodes, tracker.reason);
 
+    population_free(&population);
     return 0;
 }
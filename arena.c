@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "latency.h"
+#include "match.h"
+#include "metrics.h"
+#include "mcts.h"
+#include "model.h"
+#include "policy.h"
+#include "qtable.h"
+#include "search.h"
+#include "state_index.h"
+#include "tablebase.h"
+#include "timer.h"
+
+// Everything a player of any kind may need
+typedef struct {
+    const Game* game;
+    const char* model;
+    const char* tablebase_file;
+    float epsilon;
+    long playouts;
+    uint64_t budget_ns;
+    int max_depth;
+    int search_threads;
+    int table_mb;
+    uint64_t seed;
+    QTable table;
+    StateIndex index;
+    bool has_table;
+    bool has_index;
+    Tablebase tablebase;
+    bool has_tablebase;
+    MctsTree trees[2];
+    bool has_tree[2];
+    SearchTable search_tables[2];
+    bool has_search_table[2];
+} Resources;
+
+static void usage(void) {
+    printf("Usage: arena <x-player> <o-player> [games] [--size N] [--win-length K] [--layers L] [--model file]\n");
+    printf("             [--tablebase file] [--epsilon E] [--playouts N] [--budget-us T] [--depth D] [--seed S]\n");
+    printf("             [--threads N] [--table-mb M]\n");
+    printf("Players:");
+    for (int kind = 0; kind < POLICY_NUM_KINDS; kind++)
+        printf(" %s", policy_kind_name((PolicyKind)kind));
+    printf("\n");
+}
+
+// Function to load the Q-table the first time a player needs it
+static int load_table(Resources* resources) {
+    if (resources->has_table)
+        return 0;
+    if (model_open_qtable(resources->model, resources->game, &resources->table, &resources->index, &resources->has_index) != 0)
+        return -1;
+    resources->has_table = true;
+    return 0;
+}
+
+// Function to set up side's player of the given kind
+static int init_player(Policy* policy, PolicyKind kind, int side, Resources* resources) {
+    uint64_t seed = resources->seed + (uint64_t)side + 1;
+    switch (kind) {
+    case POLICY_HUMAN:
+        printf("Error: The arena does not show the board; play against the AI with theGame.\n");
+        return -1;
+    case POLICY_RANDOM:
+        policy_init_random(policy, seed);
+        return 0;
+    case POLICY_GREEDY:
+    case POLICY_EPSILON:
+        if (load_table(resources) != 0)
+            return -1;
+        if (kind == POLICY_GREEDY)
+            policy_init_greedy(policy, &resources->table);
+        else
+            policy_init_qtable(policy, &resources->table, resources->epsilon, seed);
+        return 0;
+    case POLICY_SCRIPTED:
+        // Without a script the player takes the lowest empty cell every time
+        policy_init_scripted(policy, NULL, 0);
+        return 0;
+    case POLICY_TABLEBASE:
+        if (!resources->has_tablebase) {
+            if (tablebase_open(&resources->tablebase, resources->tablebase_file) != 0)
+                return -1;
+            resources->has_tablebase = true;
+            if (resources->tablebase.game.size != resources->game->size ||
+                resources->tablebase.game.win_length != resources->game->win_length ||
+                resources->tablebase.game.layers != resources->game->layers) {
+                printf("Error: %s is not a tablebase for this board.\n", resources->tablebase_file);
+                return -1;
+            }
+        }
+        policy_init_tablebase(policy, &resources->tablebase, seed);
+        return 0;
+    case POLICY_MCTS:
+        if (mcts_init(&resources->trees[side], resources->game, 1u << 20, seed) != 0) {
+            printf("Error: Unable to allocate the MCTS arena.\n");
+            return -1;
+        }
+        resources->has_tree[side] = true;
+        policy_init_mcts(policy, &resources->trees[side], resources->playouts);
+        return 0;
+    case POLICY_SEARCH:
+        policy_init_search(policy, resources->budget_ns, resources->max_depth);
+        policy->limits.num_threads = resources->search_threads;
+        if (resources->table_mb > 0) {
+            if (search_table_init(&resources->search_tables[side], (size_t)resources->table_mb << 20) != 0) {
+                printf("Error: Unable to allocate the transposition table.\n");
+                return -1;
+            }
+            resources->has_search_table[side] = true;
+            policy->limits.table = &resources->search_tables[side];
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+// Play any two kinds of player against each other and count the results.
+// The pairing is chosen here, once; every game runs in that pairing's loop.
+int main(int argc, char* argv[]) {
+    const char* names[2] = {NULL, NULL};
+    long games = 1000;
+    int size = 3, win_length = 0, layers = 1;
+    Resources resources = {.model = "q_values.dat", .epsilon = 0.1f, .playouts = 2000, .budget_ns = 5000000,
+                           .search_threads = 1, .table_mb = SEARCH_TABLE_DEFAULT_MB, .seed = 1};
+    int num_positional = 0;
+    latency_init_from_env();
+    metrics_init_from_env();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--layers") == 0 && i + 1 < argc)
+            layers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--win-length") == 0 && i + 1 < argc)
+            win_length = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+            resources.model = argv[++i];
+        else if (strcmp(argv[i], "--tablebase") == 0 && i + 1 < argc)
+            resources.tablebase_file = argv[++i];
+        else if (strcmp(argv[i], "--epsilon") == 0 && i + 1 < argc)
+            resources.epsilon = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--playouts") == 0 && i + 1 < argc)
+            resources.playouts = atol(argv[++i]);
+        else if (strcmp(argv[i], "--budget-us") == 0 && i + 1 < argc)
+            resources.budget_ns = (uint64_t)(atof(argv[++i]) * 1e3);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            resources.max_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            resources.search_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--table-mb") == 0 && i + 1 < argc)
+            resources.table_mb = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            resources.seed = strtoull(argv[++i], NULL, 10);
+        else if (num_positional < 2 && argv[i][0] != '-')
+            names[num_positional++] = argv[i];
+        else if (num_positional++ == 2 && argv[i][0] != '-')
+            games = atol(argv[i]);
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (names[1] == NULL) {
+        usage();
+        return 1;
+    }
+
+    Game game;
+    if (game_init_variant(&game, size, win_length > 0 ? win_length : size, layers) != 0) {
+        printf("Error: Unsupported board %dx%d (%d layers) with %d in a row.\n", size, size, layers, win_length > 0 ? win_length : size);
+        return 1;
+    }
+    resources.game = &game;
+    char default_tablebase[64];
+    if (resources.tablebase_file == NULL) {
+        snprintf(default_tablebase, sizeof(default_tablebase), "tablebase_%dx%d_%d.tb", game.size, game.size, game.win_length);
+        resources.tablebase_file = default_tablebase;
+    }
+
+    Policy players[2];
+    int status = 0;
+    for (int side = 0; side < 2 && status == 0; side++) {
+        int kind = policy_kind_from_name(names[side]);
+        if (kind < 0) {
+            printf("Error: Unknown player \"%s\".\n", names[side]);
+            usage();
+            status = 1;
+        } else if (init_player(&players[side], (PolicyKind)kind, side, &resources) != 0) {
+            status = 1;
+        }
+    }
+
+    if (status == 0) {
+        long results[4] = {0, 0, 0, 0}; // X wins, O wins, draws, games a player gave up
+        double start = monotonic_seconds();
+        for (long g = 0; g < games; g++) {
+            Position board = {0, 0};
+            int outcome = match_play(&game, &players[0], &players[1], &board, NULL);
+            results[outcome == OUTCOME_X_WINS ? 0 : outcome == OUTCOME_O_WINS ? 1 : outcome == OUTCOME_DRAW ? 2 : 3]++;
+        }
+        double seconds = monotonic_seconds() - start;
+        long played = results[0] + results[1] + results[2] + results[3];
+        if (layers > 1)
+            printf("%s (X) vs %s (O) on %dx%dx%d, %d in a row: %ld games\n", names[0], names[1], size, size, layers, game.win_length, played);
+        else
+            printf("%s (X) vs %s (O) on %dx%d, %d in a row: %ld games\n", names[0], names[1], size, size, game.win_length, played);
+        if (played > 0)
+            printf("X wins %.3f  O wins %.3f  draws %.3f  (%.0f games/sec)\n", (double)results[0] / played,
+                   (double)results[1] / played, (double)results[2] / played, played / seconds);
+        if (results[3] > 0)
+            printf("%ld games abandoned (a player gave up), counted in none of the rates above\n", results[3]);
+    }
+
+    for (int side = 0; side < 2; side++) {
+        if (resources.has_tree[side])
+            mcts_free(&resources.trees[side]);
+        if (resources.has_search_table[side])
+            search_table_free(&resources.search_tables[side]);
+    }
+    if (resources.has_tablebase)
+        tablebase_close(&resources.tablebase);
+    if (resources.has_table)
+        qtable_free(&resources.table);
+    if (resources.has_index)
+        state_index_free(&resources.index);
+    return status;
+}
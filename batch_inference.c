@@ -0,0 +1,83 @@
+#include <pthread.h>
+#include "batch_inference.h"
+#include "rng.h"
+
+typedef struct {
+    const BatchRequest* request;
+    const Position* positions;
+    const uint8_t* sides;
+    int* moves;
+    int begin;
+    int end;
+} BatchSlice;
+
+// Function to choose moves for boards [begin, end) of a batch
+static void choose_moves_range(const BatchRequest* request, const Position* positions, const uint8_t* sides, int* moves, int begin, int end) {
+    const Game* game = request->game;
+    // A shared network evaluates MLP_MAX_BATCH boards per pass
+    Mlp* mlp = request->tables == NULL ? request->table->mlp : NULL;
+    const float* outputs = NULL;
+    for (int i = begin; i < end; i++) {
+        if (mlp != NULL && (i - begin) % MLP_MAX_BATCH == 0) {
+            int count = end - i < MLP_MAX_BATCH ? end - i : MLP_MAX_BATCH;
+            outputs = mlp_forward(mlp, positions + i, sides != NULL ? sides + i : NULL, count);
+        }
+        Position pos = positions[i];
+        int side = sides != NULL ? sides[i] : position_side_to_move(pos);
+        uint64_t legal = position_empty(game, pos);
+        if (legal == 0) {
+            moves[i] = -1;
+            continue;
+        }
+
+        const float* q = mlp != NULL ? outputs + (size_t)((i - begin) % MLP_MAX_BATCH) * game->num_cells
+                                     : qtable_row(request->tables != NULL ? request->tables[i] : request->table, pos, side);
+
+        int move;
+        Rng rng;
+        rng_seed(&rng, request->seed ^ rng_mix((uint64_t)i + 1));
+        if (q == NULL || (request->epsilons != NULL && rng_uniform(&rng) < request->epsilons[i]))
+            move = engine_select_cell(legal, (int)rng_below(&rng, (uint32_t)engine_popcount(legal)));
+        else
+            move = qtable_greedy_cell(q, legal, game->num_cells);
+
+        moves[i] = move;
+        if (request->q_out != NULL)
+            request->q_out[i] = q != NULL ? q[move] : 0.0f;
+    }
+}
+
+static void* choose_moves_slice(void* arg) {
+    BatchSlice* slice = arg;
+    choose_moves_range(slice->request, slice->positions, slice->sides, slice->moves, slice->begin, slice->end);
+    return NULL;
+}
+
+void choose_moves_batch(const BatchRequest* request, const Position* positions, const uint8_t* sides, int count, int* moves) {
+    int num_threads = request->num_threads;
+    if (request->tables == NULL && request->table->mlp != NULL)
+        num_threads = 1; // the network's scratch is not shared
+    if (num_threads > count / BATCH_MIN_PER_THREAD)
+        num_threads = count / BATCH_MIN_PER_THREAD;
+    if (num_threads <= 1) {
+        choose_moves_range(request, positions, sides, moves, 0, count);
+        return;
+    }
+
+    pthread_t threads[num_threads];
+    bool started[num_threads];
+    BatchSlice slices[num_threads];
+    for (int t = 0; t < num_threads; t++) {
+        slices[t] = (BatchSlice){request, positions, sides, moves, (int)((long long)count * t / num_threads), (int)((long long)count * (t + 1) / num_threads)};
+        started[t] = t > 0 && pthread_create(&threads[t], NULL, choose_moves_slice, &slices[t]) == 0;
+    }
+    // Slice 0, and any slice whose thread failed to start, runs on the caller
+    for (int t = 0; t < num_threads; t++) {
+        if (!started[t])
+            choose_moves_slice(&slices[t]);
+    }
+    for (int t = 1; t < num_threads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef BATCH_INFERENCE_H
+#define BATCH_INFERENCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+#include "qtable.h"
+
+// Below this many boards per thread, splitting a batch costs more than it saves
+#define BATCH_MIN_PER_THREAD 4096
+
+// Parameters shared by every board of a batch.
+//
+// Moves are chosen from either one shared table (table) or from one table
+// per board (tables), of any layout. A shared network runs on one thread.
+typedef struct {
+    const Game* game;
+    const QTable* table;
+    const QTable* const* tables;
+    const float* epsilons;  // per-board exploration rate, NULL for greedy play
+    float* q_out;           // Q-value of each chosen move, optional
+    uint64_t seed;          // exploration is a pure function of (seed, board number)
+    int num_threads;
+} BatchRequest;
+
+// Choose a move (cell number, -1 if the board is full) for each of count
+// positions. sides may be NULL to use the side to move of each position.
+void choose_moves_batch(const BatchRequest* request, const Position* positions, const uint8_t* sides, int count, int* moves);
+
+#endif
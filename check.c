@@ -0,0 +1,401 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "checkpoint.h"
+#include "engine.h"
+#include "mcts.h"
+#include "model.h"
+#include "qtable.h"
+#include "rng.h"
+#include "sparse_qtable.h"
+#include "state_index.h"
+#include "tablebase.h"
+
+#define SPARSE_CHECK_BYTES (256 << 10) // 64 slots a shard for 9-cell rows
+#define SPARSE_CHECK_COLD 100000
+#define SPARSE_CHECK_HOT 8
+#define SPARSE_CHECK_THREADS 4
+#define SPARSE_CHECK_SHARED 1000
+#define SPARSE_CHECK_ROUNDS 100
+#define CHECKPOINT_CHECK_PATH "check_checkpoint.dat"
+#define CHECKPOINT_CHECK_SAVES 20
+#define CHECKPOINT_CHECK_UPDATES 50 // values changed between saves
+#define STATE_INDEX_CHECK_BOARDS 1000000 // random boards offered to state_index_rank
+#define MCTS_CHECK_CAPACITY 1000 // far fewer nodes than the search wants
+#define MCTS_CHECK_PLAYOUTS 20000
+#define MCTS_CHECK_THREADS 4
+#define TABLEBASE_CHECK_PATH "check_tablebase.dat"
+#define TABLEBASE_CHECK_SPLIT 5 // the first run stops at this level, the second resumes
+
+static bool check(const char* name, uint64_t got, uint64_t expected) {
+    if (got == expected)
+        return true;
+    printf("MISMATCH %s: got %llu, expected %llu\n", name, (unsigned long long)got, (unsigned long long)expected);
+    return false;
+}
+
+// Distinct keys; the table only hashes them, so they need not be real boards
+static Position key(uint64_t n) {
+    return (Position){n + 1, 0};
+}
+
+static void* add_shared(void* arg) {
+    SparseQTable* table = arg;
+    for (int round = 0; round < SPARSE_CHECK_ROUNDS; round++) {
+        for (int k = 0; k < SPARSE_CHECK_SHARED; k++)
+            sparse_qtable_add(table, key(k), k % 9, 1.0f);
+    }
+    return NULL;
+}
+
+// Function to check the sparse table: filled far past its cap, no shard
+// grows beyond its share, every row is either present or counted as
+// evicted, and rows visited often survive with their values; then threads
+// adding to the same rows under the locks lose no update
+static bool check_sparse(void) {
+    SparseQTable table;
+    if (sparse_qtable_init(&table, 9, SPARSE_CHECK_BYTES) != 0) {
+        printf("Error: Unable to allocate the sparse table.\n");
+        return false;
+    }
+    for (int h = 0; h < SPARSE_CHECK_HOT; h++)
+        sparse_qtable_insert(&table, key(SPARSE_CHECK_COLD + h))[0] = (float)(h + 1);
+    for (int i = 0; i < SPARSE_CHECK_COLD; i++) {
+        sparse_qtable_insert(&table, key(i));
+        for (int h = 0; i % 64 == 0 && h < SPARSE_CHECK_HOT; h++)
+            sparse_qtable_insert(&table, key(SPARSE_CHECK_COLD + h));
+    }
+    uint64_t oversized = 0, hot_lost = 0;
+    for (int s = 0; s < SPARSE_QTABLE_SHARDS; s++)
+        oversized += table.shards[s].capacity > table.shards[s].max_capacity || table.shards[s].count * 8 > table.shards[s].capacity * 7;
+    for (int h = 0; h < SPARSE_CHECK_HOT; h++) {
+        const float* row = sparse_qtable_find(&table, key(SPARSE_CHECK_COLD + h));
+        hot_lost += row == NULL || row[0] != (float)(h + 1);
+    }
+    bool ok = check("shards beyond their share", oversized, 0);
+    ok &= check("bytes within the cap", sparse_qtable_bytes(&table) <= SPARSE_CHECK_BYTES, 1);
+    ok &= check("rows evicted", sparse_qtable_evicted(&table) > 0, 1);
+    ok &= check("rows kept or evicted", sparse_qtable_count(&table) + sparse_qtable_evicted(&table), SPARSE_CHECK_COLD + SPARSE_CHECK_HOT);
+    ok &= check("hot rows lost", hot_lost, 0);
+    printf("sparse: %zu rows in %zu bytes (cap %d), %llu evicted\n", sparse_qtable_count(&table), sparse_qtable_bytes(&table),
+           SPARSE_CHECK_BYTES, (unsigned long long)sparse_qtable_evicted(&table));
+    sparse_qtable_free(&table);
+
+    if (sparse_qtable_init(&table, 9, (size_t)SPARSE_QTABLE_DEFAULT_MB << 20) != 0) {
+        printf("Error: Unable to allocate the sparse table.\n");
+        return false;
+    }
+    pthread_t threads[SPARSE_CHECK_THREADS];
+    bool started[SPARSE_CHECK_THREADS];
+    for (int t = 0; t < SPARSE_CHECK_THREADS; t++)
+        started[t] = pthread_create(&threads[t], NULL, add_shared, &table) == 0;
+    int num_started = 0;
+    for (int t = 0; t < SPARSE_CHECK_THREADS; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+            num_started++;
+        }
+    }
+    uint64_t wrong = 0;
+    for (int k = 0; k < SPARSE_CHECK_SHARED; k++) {
+        float row[9];
+        wrong += !sparse_qtable_read(&table, key(k), row) || row[k % 9] != (float)(num_started * SPARSE_CHECK_ROUNDS);
+    }
+    ok &= check("threads started", (uint64_t)num_started, SPARSE_CHECK_THREADS);
+    ok &= check("rows with lost updates", wrong, 0);
+    ok &= check("shared rows", sparse_qtable_count(&table), SPARSE_CHECK_SHARED);
+    sparse_qtable_free(&table);
+    return ok;
+}
+
+// Function to compare two tables value by value (bit for bit, so -0 and NaN
+// count), returning how many differ
+static uint64_t count_differences(const QTable* a, const QTable* b) {
+    uint64_t differences = 0;
+    for (size_t i = 0; i < qtable_num_values(a); i++)
+        differences += memcmp(&a->values[i], &b->values[i], sizeof(float)) != 0;
+    return differences;
+}
+
+// Function to load path into a fresh table of the same layout as like
+static uint64_t differences_from_file(const char* path, const Game* game, const QTable* like, StateIndex* index) {
+    QTable loaded;
+    if (qtable_init_state_indexed(&loaded, index) != 0)
+        return UINT64_MAX;
+    uint64_t differences = model_load_qtable(path, game, &loaded) == 0 ? count_differences(like, &loaded) : UINT64_MAX;
+    qtable_free(&loaded);
+    return differences;
+}
+
+// Function to check delta checkpoints: after every save of a table changed
+// at random, the base plus its deltas loads back as exactly the table, and
+// a save that fails part-way leaves the last good chain loadable
+static bool check_checkpoint(void) {
+    Game game;
+    StateIndex index;
+    QTable table, saved;
+    game_init(&game, 3, 3);
+    if (state_index_build(&index, &game) != 0 || qtable_init_state_indexed(&table, &index) != 0 ||
+        qtable_init_state_indexed(&saved, &index) != 0 || qtable_track_dirty(&table) != 0) {
+        printf("Error: Unable to allocate the tables.\n");
+        return false;
+    }
+    Checkpointer checkpoint;
+    checkpoint_init(&checkpoint, CHECKPOINT_CHECK_PATH, &game, 4);
+    Rng rng;
+    rng_seed(&rng, 7);
+    uint64_t mismatched = 0, failed = 0;
+    for (int save = 0; save < CHECKPOINT_CHECK_SAVES; save++) {
+        for (int u = 0; u < CHECKPOINT_CHECK_UPDATES; u++) {
+            Position pos = {0, 0};
+            for (int ply = (int)rng_below(&rng, 8); ply > 0; ply--) {
+                uint64_t empty = position_empty(&game, pos);
+                position_make(&pos, position_side_to_move(pos), engine_select_cell(empty, (int)rng_below(&rng, (uint32_t)engine_popcount(empty))));
+            }
+            if (game_outcome(&game, pos) != OUTCOME_ONGOING)
+                continue;
+            float* row = qtable_row_for_update(&table, pos, position_side_to_move(pos));
+            int cell = (int)rng_below(&rng, (uint32_t)game.num_cells);
+            row[cell] = rng_uniform(&rng) < 0.25f ? 0 : 2 * rng_uniform(&rng) - 1;
+            qtable_mark_dirty(&table, &row[cell]);
+        }
+        failed += checkpoint_save(&checkpoint, &table) != 0;
+        mismatched += differences_from_file(CHECKPOINT_CHECK_PATH, &game, &table, &index) != 0;
+    }
+    bool ok = check("failed saves", failed, 0);
+    ok &= check("saves that load back differently", mismatched, 0);
+    ok &= check("deltas in the chain", checkpoint.num_deltas > 0, 1);
+
+#ifndef _WIN32
+    // A directory where the temporary file goes makes the next save fail
+    memcpy(saved.values, table.values, qtable_num_values(&table) * sizeof(float));
+    table.values[0] += 1;
+    mkdir(CHECKPOINT_CHECK_PATH ".tmp", 0700);
+    printf("(one save is meant to fail here)\n");
+    ok &= check("failed save reported", model_save_qtable(CHECKPOINT_CHECK_PATH, &game, &table) != 0, 1);
+    rmdir(CHECKPOINT_CHECK_PATH ".tmp");
+    ok &= check("values lost by a failed save", differences_from_file(CHECKPOINT_CHECK_PATH, &game, &saved, &index), 0);
+#endif
+    ok &= check("direct save", model_save_qtable(CHECKPOINT_CHECK_PATH, &game, &table), 0);
+    ok &= check("values lost by a direct save", differences_from_file(CHECKPOINT_CHECK_PATH, &game, &table, &index), 0);
+    FILE* stale = fopen(CHECKPOINT_CHECK_PATH ".delta1", "rb");
+    ok &= check("deltas left by a direct save", stale != NULL, 0);
+    if (stale != NULL)
+        fclose(stale);
+    printf("checkpoint: %d bases and %d deltas, %llu bytes\n", checkpoint.bases_written, checkpoint.deltas_written,
+           (unsigned long long)checkpoint.bytes_written);
+
+    checkpoint_remove_deltas(CHECKPOINT_CHECK_PATH);
+    remove(CHECKPOINT_CHECK_PATH);
+    qtable_free(&table);
+    qtable_free(&saved);
+    state_index_free(&index);
+    return ok;
+}
+
+// Function to check one board's dense index: every rank unranks to a board
+// that ranks back to it, levels are contiguous, and random boards rank to
+// NONE unless they are the board at that rank
+static bool check_index(int size, int win_length, uint32_t expected_states) {
+    Game game;
+    StateIndex index;
+    game_init(&game, size, win_length);
+    if (state_index_build(&index, &game) != 0) {
+        printf("Error: Unable to index a %dx%d board.\n", size, size);
+        return false;
+    }
+    uint64_t round_trip = 0, misplaced = 0;
+    for (uint32_t rank = 0; rank < index.num_states; rank++) {
+        Position pos = state_index_unrank(&index, rank);
+        uint32_t begin, end;
+        state_index_level_range(&index, position_num_stones(pos), &begin, &end);
+        round_trip += state_index_rank(&index, pos) != rank;
+        misplaced += rank < begin || rank >= end;
+    }
+
+    // Mostly impossible boards: overlaps, stones off the board, bad counts
+    Rng rng;
+    rng_seed(&rng, 11);
+    uint64_t accepted = 0, wrong = 0, impossible = 0;
+    for (int i = 0; i < STATE_INDEX_CHECK_BOARDS; i++) {
+        Position pos = {rng_next(&rng) & rng_next(&rng), rng_next(&rng) & rng_next(&rng)};
+        if (i & 1) {
+            pos.x &= game.full_mask;
+            pos.o &= game.full_mask;
+        }
+        int balance = engine_popcount(pos.x) - engine_popcount(pos.o);
+        bool possible = (pos.x & pos.o) == 0 && ((pos.x | pos.o) & ~game.full_mask) == 0 && balance >= 0 && balance <= 1;
+        uint32_t rank = state_index_rank(&index, pos);
+        if (rank == STATE_INDEX_NONE)
+            continue;
+        accepted++;
+        impossible += !possible;
+        Position back = state_index_unrank(&index, rank);
+        wrong += back.x != pos.x || back.o != pos.o;
+    }
+
+    char name[64];
+    bool ok = true;
+    snprintf(name, sizeof(name), "%dx%d states", size, size);
+    ok &= check(name, index.num_states, expected_states);
+    snprintf(name, sizeof(name), "%dx%d ranks that do not round-trip", size, size);
+    ok &= check(name, round_trip, 0);
+    snprintf(name, sizeof(name), "%dx%d ranks outside their level", size, size);
+    ok &= check(name, misplaced, 0);
+    snprintf(name, sizeof(name), "%dx%d impossible boards ranked", size, size);
+    ok &= check(name, impossible, 0);
+    snprintf(name, sizeof(name), "%dx%d boards ranked as another", size, size);
+    ok &= check(name, wrong, 0);
+    printf("state_index: %dx%d has %u states, %llu of %d random boards ranked\n", size, size, index.num_states,
+           (unsigned long long)accepted, STATE_INDEX_CHECK_BOARDS);
+    state_index_free(&index);
+    return ok;
+}
+
+static bool check_state_index(void) {
+    bool ok = check_index(3, 3, 5478);
+    ok &= check_index(2, 2, 29); // X always wins on the third stone
+    return ok;
+}
+
+// Function to check that threads expanding a tree into a small arena never
+// reserve past its end, and that every playout is counted once at the root
+static bool check_mcts(void) {
+    Game game;
+    MctsTree tree;
+    game_init(&game, 4, 4);
+    if (mcts_init(&tree, &game, MCTS_CHECK_CAPACITY, 5) != 0) {
+        printf("Error: Unable to allocate the tree.\n");
+        return false;
+    }
+    MctsLimits limits = {MCTS_CHECK_PLAYOUTS, 0, MCTS_CHECK_THREADS};
+    MctsStats stats;
+    int move = mcts_search(&tree, &limits, &stats);
+    bool ok = check("nodes past the arena", stats.nodes_used > MCTS_CHECK_CAPACITY ? stats.nodes_used - MCTS_CHECK_CAPACITY : 0, 0);
+    ok &= check("playouts", (uint64_t)stats.playouts, MCTS_CHECK_PLAYOUTS);
+    ok &= check("root visits", atomic_load(&tree.nodes[tree.root].visits), MCTS_CHECK_PLAYOUTS);
+    ok &= check("move found", move >= 0, 1);
+    printf("mcts: %ld playouts on %d threads in %u of %d nodes\n", stats.playouts, MCTS_CHECK_THREADS, stats.nodes_used,
+           MCTS_CHECK_CAPACITY);
+    mcts_free(&tree);
+    return ok;
+}
+
+#ifndef _WIN32
+
+// Function to solve a position by plain negamax, as the tablebase's reference
+static int negamax_value(const Game* game, Position pos) {
+    int side = position_side_to_move(pos);
+    if (game_is_win(game, position_stones(pos, side ^ 1)))
+        return TB_LOSS;
+    uint64_t empty = position_empty(game, pos);
+    if (empty == 0)
+        return TB_DRAW;
+    int best = TB_LOSS;
+    for (; empty; empty &= empty - 1) {
+        Position child = pos;
+        position_make(&child, side, engine_lowest_cell(empty));
+        int value = negamax_value(game, child);
+        if (value == TB_LOSS)
+            return TB_WIN;
+        if (value == TB_DRAW)
+            best = TB_DRAW;
+    }
+    return best;
+}
+
+// Function to check the tablebase: a run interrupted part way, whose header
+// counts are then damaged, resumes to a file where every value agrees with
+// negamax and the counts agree with the values
+static bool check_tablebase(void) {
+    Game game;
+    game_init(&game, 3, 3);
+    remove(TABLEBASE_CHECK_PATH);
+    bool ok = check("first run", tablebase_generate(&game, TABLEBASE_CHECK_PATH, TABLEBASE_CHECK_SPLIT, 2), 0);
+    FILE* file = fopen(TABLEBASE_CHECK_PATH, "r+b");
+    uint64_t damaged[4] = {1, 2, 3, 4};
+    ok &= check("header damaged", file != NULL && fseek(file, offsetof(TablebaseHeader, counts), SEEK_SET) == 0 &&
+                                      fwrite(damaged, sizeof(damaged), 1, file) == 1, 1);
+    if (file != NULL)
+        fclose(file);
+    ok &= check("resumed run", tablebase_generate(&game, TABLEBASE_CHECK_PATH, 0, 2), 0);
+
+    Tablebase tablebase;
+    if (tablebase_open(&tablebase, TABLEBASE_CHECK_PATH) != 0) {
+        remove(TABLEBASE_CHECK_PATH);
+        return false;
+    }
+    uint64_t counts[4] = {0, 0, 0, 0}, mismatched = 0;
+    for (uint32_t rank = 0; rank < tablebase.index.num_states; rank++) {
+        Position pos = state_index_unrank(&tablebase.index, rank);
+        int value = tablebase_probe(&tablebase, pos);
+        counts[value]++;
+        mismatched += value != negamax_value(&game, pos);
+    }
+    const TablebaseHeader* header = tablebase.header;
+    ok &= check("levels done", header->lowest_done, 0);
+    ok &= check("values that disagree with negamax", mismatched, 0);
+    ok &= check("unknown values", counts[TB_UNKNOWN], 0);
+    ok &= check("win count", header->counts[TB_WIN], counts[TB_WIN]);
+    ok &= check("draw count", header->counts[TB_DRAW], counts[TB_DRAW]);
+    ok &= check("loss count", header->counts[TB_LOSS], counts[TB_LOSS]);
+    ok &= check("empty board", (uint64_t)tablebase_probe(&tablebase, (Position){0, 0}), TB_DRAW);
+    printf("tablebase: %u positions, win %llu draw %llu loss %llu\n", tablebase.index.num_states,
+           (unsigned long long)counts[TB_WIN], (unsigned long long)counts[TB_DRAW], (unsigned long long)counts[TB_LOSS]);
+
+    tablebase_close(&tablebase);
+    remove(TABLEBASE_CHECK_PATH);
+    return ok;
+}
+
+#endif
+
+static const struct {
+    const char* name;
+    bool (*run)(void);
+} checks[] = {
+    {"checkpoint", check_checkpoint},
+    {"mcts", check_mcts},
+    {"sparse", check_sparse},
+    {"state_index", check_state_index},
+#ifndef _WIN32
+    {"tablebase", check_tablebase},
+#endif
+};
+
+#define NUM_CHECKS (int)(sizeof(checks) / sizeof(checks[0]))
+
+// Check the engine's data structures against what must hold of them, the
+// way enumerate --verify checks the move generator. Exits with 1 if any
+// check fails.
+// Usage: check [name ...]
+int main(int argc, char* argv[]) {
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        int c = 0;
+        while (c < NUM_CHECKS && strcmp(argv[i], checks[c].name) != 0)
+            c++;
+        if (c == NUM_CHECKS) {
+            printf("Usage: check [name ...]\nChecks:");
+            for (c = 0; c < NUM_CHECKS; c++)
+                printf(" %s", checks[c].name);
+            printf("\n");
+            return 1;
+        }
+    }
+    for (int c = 0; c < NUM_CHECKS; c++) {
+        bool wanted = argc == 1;
+        for (int i = 1; i < argc; i++)
+            wanted |= strcmp(argv[i], checks[c].name) == 0;
+        if (wanted)
+            ok &= checks[c].run();
+    }
+    printf("%s\n", ok ? "All checks pass." : "Checks FAILED.");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "model.h"
+
+#define RUN_VALUES (CHECKPOINT_RUN_BLOCKS * QTABLE_DIRTY_BLOCK)
+#define RUN_BYTES (RUN_VALUES * sizeof(float))
+#define PACKED_CAPACITY (RUN_BYTES + RUN_BYTES / 128 + 1) // PackBits never grows data by more than this
+
+static uint32_t table_kind(const QTable* table) {
+    if (table->sparse != NULL)
+        return MODEL_SPARSE;
+    if (table->mlp != NULL)
+        return MODEL_MLP;
+    return table->index != NULL ? MODEL_STATE_INDEXED : MODEL_POSITIONAL;
+}
+
+static void delta_name(char* name, size_t size, const char* path, int sequence) {
+    snprintf(name, size, "%s.delta%d", path, sequence);
+}
+
+// Function to compress bytes with PackBits: a control byte n of 0..127 is
+// followed by n + 1 literal bytes, one of -1..-127 by a byte repeated 1 - n
+// times. Unvisited parts of a table are long runs of zero bytes.
+static size_t packbits(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t i = 0, o = 0;
+    while (i < length) {
+        size_t run = 1;
+        while (i + run < length && run < 128 && in[i + run] == in[i])
+            run++;
+        if (run >= 3) {
+            out[o++] = (uint8_t)(1 - (int)run);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        // Literals up to the next run of three or more
+        size_t start = i, count = 0;
+        while (i < length && count < 128) {
+            if (i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2])
+                break;
+            i++;
+            count++;
+        }
+        out[o++] = (uint8_t)(count - 1);
+        memcpy(out + o, in + start, count);
+        o += count;
+    }
+    return o;
+}
+
+static int unpackbits(const uint8_t* in, size_t length, uint8_t* out, size_t expected) {
+    size_t i = 0, o = 0;
+    while (i < length) {
+        int control = (int8_t)in[i++];
+        if (control >= 0) {
+            size_t count = (size_t)control + 1;
+            if (i + count > length || o + count > expected)
+                return -1;
+            memcpy(out + o, in + i, count);
+            i += count;
+            o += count;
+        } else if (control != -128) {
+            size_t count = (size_t)(1 - control);
+            if (i >= length || o + count > expected)
+                return -1;
+            memset(out + o, in[i++], count);
+            o += count;
+        }
+    }
+    return o == expected ? 0 : -1;
+}
+
+void checkpoint_init(Checkpointer* checkpoint, const char* path, const Game* game, int compact_interval) {
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    snprintf(checkpoint->path, sizeof(checkpoint->path), "%s", path);
+    checkpoint->game = game;
+    checkpoint->compact_interval = compact_interval > 0 ? compact_interval : 1;
+}
+
+static void clear_dirty(QTable* table) {
+    if (table->dirty != NULL)
+        memset(table->dirty, 0, (qtable_num_blocks(table) + 63) / 64 * sizeof(uint64_t));
+}
+
+void checkpoint_remove_deltas(const char* path) {
+    char name[CHECKPOINT_MAX_PATH + 16];
+    int count = 0;
+    for (;;) {
+        delta_name(name, sizeof(name), path, count + 1);
+        FILE* file = fopen(name, "rb");
+        if (file == NULL)
+            break;
+        fclose(file);
+        count++;
+    }
+    for (int sequence = count; sequence >= 1; sequence--) {
+        delta_name(name, sizeof(name), path, sequence);
+        remove(name);
+    }
+}
+
+// Function to write a full model file, which drops the old chain (see
+// model_save_qtable)
+int checkpoint_save_base(Checkpointer* checkpoint, QTable* table) {
+    if (model_save_qtable(checkpoint->path, checkpoint->game, table) != 0)
+        return -1;
+    clear_dirty(table);
+    checkpoint->table = table;
+    checkpoint->num_deltas = 0;
+    checkpoint->bases_written++;
+    checkpoint->bytes_written += sizeof(ModelHeader) + qtable_num_values(table) * sizeof(float);
+    return 0;
+}
+
+static int write_runs(FILE* file, const QTable* table, uint8_t* packed, uint32_t* num_runs) {
+    size_t num_blocks = qtable_num_blocks(table), total = qtable_num_values(table);
+    for (size_t block = 0; block < num_blocks;) {
+        if (table->dirty[block >> 6] == 0) {
+            block = (block | 63) + 1;
+            continue;
+        }
+        if (!(table->dirty[block >> 6] >> (block & 63) & 1)) {
+            block++;
+            continue;
+        }
+        size_t end = block + 1;
+        while (end < num_blocks && end - block < CHECKPOINT_RUN_BLOCKS && (table->dirty[end >> 6] >> (end & 63) & 1))
+            end++;
+        size_t first = block * QTABLE_DIRTY_BLOCK;
+        size_t last = end * QTABLE_DIRTY_BLOCK < total ? end * QTABLE_DIRTY_BLOCK : total;
+        DeltaRun run = {first, (uint32_t)(last - first), 0};
+        const uint8_t* raw = (const uint8_t*)(table->values + first);
+        size_t raw_bytes = run.count * sizeof(float);
+        size_t packed_bytes = packbits(raw, raw_bytes, packed);
+        if (packed_bytes < raw_bytes)
+            run.packed_bytes = (uint32_t)packed_bytes;
+        if (fwrite(&run, sizeof(run), 1, file) != 1)
+            return -1;
+        if (run.packed_bytes != 0 ? fwrite(packed, 1, packed_bytes, file) != packed_bytes
+                                  : fwrite(raw, 1, raw_bytes, file) != raw_bytes)
+            return -1;
+        (*num_runs)++;
+        block = end;
+    }
+    return 0;
+}
+
+// Function to write the dirty blocks as the next delta of the chain
+static int save_delta(Checkpointer* checkpoint, QTable* table) {
+    int sequence = checkpoint->num_deltas + 1;
+    char name[CHECKPOINT_MAX_PATH + 16], temp[CHECKPOINT_MAX_PATH + 24];
+    delta_name(name, sizeof(name), checkpoint->path, sequence);
+    snprintf(temp, sizeof(temp), "%s.tmp", name);
+    uint8_t* packed = malloc(PACKED_CAPACITY);
+    FILE* file = fopen(temp, "wb");
+    if (packed == NULL || file == NULL) {
+        printf("Error: Unable to open %s for writing.\n", temp);
+        free(packed);
+        if (file != NULL)
+            fclose(file);
+        return -1;
+    }
+
+    DeltaHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+    header.version = CHECKPOINT_VERSION;
+    header.kind = table_kind(table);
+    header.board_size = checkpoint->game->size;
+    header.win_length = checkpoint->game->win_length;
+    header.num_cells = table->num_cells;
+    header.num_values = qtable_num_values(table);
+    header.sequence = (uint32_t)sequence;
+    // The run count is only known at the end, so the header is written twice
+    int status = fwrite(&header, sizeof(header), 1, file) == 1 && write_runs(file, table, packed, &header.num_runs) == 0 ? 0 : -1;
+    long size = ftell(file);
+    if (status == 0 && (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1))
+        status = -1;
+    if (fclose(file) != 0)
+        status = -1;
+    free(packed);
+    if (status == 0 && rename(temp, name) != 0)
+        status = -1;
+    if (status != 0) {
+        printf("Error: Unable to write %s.\n", name);
+        remove(temp);
+        return -1;
+    }
+    clear_dirty(table);
+    checkpoint->num_deltas = sequence;
+    checkpoint->deltas_written++;
+    checkpoint->bytes_written += (uint64_t)size;
+    return 0;
+}
+
+int checkpoint_save(Checkpointer* checkpoint, QTable* table) {
+    if (table->dirty == NULL || checkpoint->table != table || checkpoint->num_deltas >= checkpoint->compact_interval ||
+        checkpoint->num_deltas >= CHECKPOINT_MAX_DELTAS)
+        return checkpoint_save_base(checkpoint, table);
+    return save_delta(checkpoint, table);
+}
+
+static int read_delta(FILE* file, int sequence, const Game* game, QTable* table, uint8_t* packed) {
+    DeltaHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0 ||
+        header.version != CHECKPOINT_VERSION || header.sequence != (uint32_t)sequence)
+        return -1;
+    if (header.kind != table_kind(table) || (int)header.board_size != game->size ||
+        (int)header.win_length != game->win_length || header.num_values != qtable_num_values(table))
+        return -1;
+    for (uint32_t r = 0; r < header.num_runs; r++) {
+        DeltaRun run;
+        if (fread(&run, sizeof(run), 1, file) != 1 || run.count > RUN_VALUES || run.first > header.num_values ||
+            run.count > header.num_values - run.first || run.packed_bytes > PACKED_CAPACITY)
+            return -1;
+        uint8_t* values = (uint8_t*)(table->values + run.first);
+        size_t raw_bytes = run.count * sizeof(float);
+        if (run.packed_bytes == 0) {
+            if (fread(values, 1, raw_bytes, file) != raw_bytes)
+                return -1;
+        } else if (fread(packed, 1, run.packed_bytes, file) != run.packed_bytes ||
+                   unpackbits(packed, run.packed_bytes, values, raw_bytes) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int checkpoint_apply_deltas(const char* path, const Game* game, QTable* table) {
+    char name[CHECKPOINT_MAX_PATH + 16];
+    uint8_t* packed = NULL;
+    int applied = 0;
+    for (int sequence = 1; sequence <= CHECKPOINT_MAX_DELTAS; sequence++) {
+        delta_name(name, sizeof(name), path, sequence);
+        FILE* file = fopen(name, "rb");
+        if (file == NULL)
+            break;
+        if (packed == NULL && (packed = malloc(PACKED_CAPACITY)) == NULL) {
+            fclose(file);
+            return -1;
+        }
+        int status = read_delta(file, sequence, game, table, packed);
+        fclose(file);
+        if (status != 0) {
+            printf("Error: %s is damaged or belongs to a different model.\n", name);
+            free(packed);
+            return -1;
+        }
+        applied++;
+    }
+    free(packed);
+    return applied;
+}
@@ -0,0 +1,69 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+#include "qtable.h"
+
+#define CHECKPOINT_MAGIC "TTTD"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_MAX_PATH 256
+#define CHECKPOINT_MAX_DELTAS 9999
+#define CHECKPOINT_RUN_BLOCKS 64 // longest run of dirty blocks written as one record
+
+// A delta file, "<model>.delta<N>", holds the blocks of a Q-table written
+// since delta N - 1 (or since the base model file for N = 1). After the
+// header come num_runs records, each a DeltaRun followed by its values:
+// PackBits-compressed when packed_bytes is non-zero, raw floats otherwise.
+// Runs carry whole values, not differences, so any prefix of the chain
+// loads as a consistent older table.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t board_size;
+    uint32_t win_length;
+    uint32_t num_cells;
+    uint64_t num_values;
+    uint32_t sequence;
+    uint32_t num_runs;
+} DeltaHeader;
+
+typedef struct {
+    uint64_t first; // index of the first value
+    uint32_t count; // values in the run
+    uint32_t packed_bytes;
+} DeltaRun;
+
+// Writes checkpoints of one table to one model path: deltas while the same
+// table keeps being saved, and a full base (with the deltas removed) every
+// compact_interval deltas or when a different table is handed in
+typedef struct {
+    char path[CHECKPOINT_MAX_PATH];
+    const Game* game;
+    const QTable* table; // table the current chain describes, NULL before the first base
+    int num_deltas;
+    int compact_interval;
+    int bases_written;
+    int deltas_written;
+    uint64_t bytes_written;
+} Checkpointer;
+
+void checkpoint_init(Checkpointer* checkpoint, const char* path, const Game* game, int compact_interval);
+
+// Save table as a delta if the chain allows it, otherwise as a new base.
+// The table must be tracking dirty blocks; they are cleared once written.
+int checkpoint_save(Checkpointer* checkpoint, QTable* table);
+int checkpoint_save_base(Checkpointer* checkpoint, QTable* table);
+
+// Apply "<path>.delta1", "<path>.delta2", ... to a table just loaded from
+// path, stopping at the first one missing. Returns how many were applied,
+// or -1 on a damaged or mismatched delta.
+int checkpoint_apply_deltas(const char* path, const Game* game, QTable* table);
+
+// Remove every delta of path, newest first so a crash part-way leaves a
+// shorter chain that still loads
+void checkpoint_remove_deltas(const char* path);
+
+#endif
@@ -0,0 +1,182 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "convergence.h"
+#include "batch_inference.h"
+#include "rng.h"
+
+ConvergenceConfig convergence_default_config() {
+    ConvergenceConfig config;
+    config.window = 5;
+    config.delta_threshold = 1e-3f;
+    config.rate_tolerance = 0.02f;
+    config.eval_interval = 500;
+    config.eval_games = 1000;
+    config.min_episodes = 0;
+    config.eval_seed = 12345;
+    return config;
+}
+
+void convergence_init(ConvergenceTracker* tracker, const ConvergenceConfig* config) {
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->config = *config;
+    if (tracker->config.window < 1)
+        tracker->config.window = 1;
+    if (tracker->config.window > CONVERGENCE_MAX_WINDOW)
+        tracker->config.window = CONVERGENCE_MAX_WINDOW;
+    if (tracker->config.eval_interval < 1)
+        tracker->config.eval_interval = 1;
+}
+
+// L2 norm of the change made to a Q-table by one episode
+float q_delta_norm(const float* before, const float* after, size_t count) {
+    double sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        double d = after[i] - before[i];
+        sum += d * d;
+    }
+    return (float)sqrt(sum);
+}
+
+void convergence_record_episode(ConvergenceTracker* tracker, float q_delta) {
+    tracker->episodes++;
+    tracker->delta_sum += q_delta;
+    tracker->delta_count++;
+}
+
+bool convergence_evaluation_due(const ConvergenceTracker* tracker) {
+    return tracker->delta_count >= tracker->config.eval_interval;
+}
+
+// Spread (max - min) of the last n entries of a ring of samples
+static float window_spread(const float* samples, int num_samples, int n) {
+    float lo = INFINITY, hi = -INFINITY;
+    for (int i = num_samples - n; i < num_samples; i++) {
+        float v = samples[i % CONVERGENCE_MAX_WINDOW];
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+    }
+    return hi - lo;
+}
+
+// Record an evaluation; returns true once the convergence criterion holds
+bool convergence_record_evaluation(ConvergenceTracker* tracker, const EvaluationResult* result) {
+    const ConvergenceConfig* config = &tracker->config;
+    int slot = tracker->num_evaluations % CONVERGENCE_MAX_WINDOW;
+    tracker->delta_means[slot] = tracker->delta_count > 0 ? (float)(tracker->delta_sum / tracker->delta_count) : 0;
+    tracker->win_rates[slot] = result->games > 0 ? (float)result->wins / result->games : 0;
+    tracker->draw_rates[slot] = result->games > 0 ? (float)result->draws / result->games : 0;
+    tracker->num_evaluations++;
+    tracker->delta_sum = 0;
+    tracker->delta_count = 0;
+
+    if (tracker->num_evaluations < config->window || tracker->episodes < config->min_episodes)
+        return false;
+
+    float max_delta = 0;
+    for (int i = tracker->num_evaluations - config->window; i < tracker->num_evaluations; i++) {
+        float d = tracker->delta_means[i % CONVERGENCE_MAX_WINDOW];
+        max_delta = d > max_delta ? d : max_delta;
+    }
+    float win_spread = window_spread(tracker->win_rates, tracker->num_evaluations, config->window);
+    float draw_spread = window_spread(tracker->draw_rates, tracker->num_evaluations, config->window);
+    if (max_delta > config->delta_threshold || win_spread > config->rate_tolerance || draw_spread > config->rate_tolerance)
+        return false;
+
+    tracker->converged = true;
+    snprintf(tracker->reason, sizeof(tracker->reason),
+             "converged: mean Q-delta <= %g and win/draw rates within %.3f/%.3f over the last %d evaluations",
+             max_delta, win_spread, draw_spread, config->window);
+    return true;
+}
+
+// Record why training stopped when it was not because of convergence
+void convergence_finish(ConvergenceTracker* tracker, const char* reason) {
+    if (!tracker->converged)
+        snprintf(tracker->reason, sizeof(tracker->reason), "%s", reason);
+}
+
+// Function to write a short plain-text summary of a finished run
+int convergence_write_summary(const ConvergenceTracker* tracker, const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Error: Unable to open file for writing.\n");
+        return -1;
+    }
+    fprintf(file, "stop_reason: %s\n", tracker->reason);
+    fprintf(file, "episodes: %ld\n", tracker->episodes);
+    fprintf(file, "evaluations: %d\n", tracker->num_evaluations);
+    if (tracker->num_evaluations > 0) {
+        int last = (tracker->num_evaluations - 1) % CONVERGENCE_MAX_WINDOW;
+        fprintf(file, "mean_q_delta: %g\n", tracker->delta_means[last]);
+        fprintf(file, "win_rate: %.4f\n", tracker->win_rates[last]);
+        fprintf(file, "draw_rate: %.4f\n", tracker->draw_rates[last]);
+    }
+    fclose(file);
+    return 0;
+}
+
+void evaluate_against_random(const Game* game, const QTable* table, int games, uint64_t seed, EvaluationResult* result) {
+    Position* positions = malloc(games * sizeof(Position));
+    Position* batch = malloc(games * sizeof(Position));
+    int* batch_games = malloc(games * sizeof(int));
+    int* moves = malloc(games * sizeof(int));
+    bool* done = calloc(games, sizeof(bool));
+    memset(result, 0, sizeof(*result));
+    if (positions == NULL || batch == NULL || batch_games == NULL || moves == NULL || done == NULL)
+        goto out;
+
+    Rng rng;
+    rng_seed(&rng, seed);
+    for (int g = 0; g < games; g++)
+        positions[g] = (Position){0, 0};
+
+    BatchRequest request = {.game = game, .table = table, .num_threads = 1};
+    for (int remaining = games; remaining > 0;) {
+        // The agent plays X in even games and O in odd ones
+        int count = 0;
+        for (int g = 0; g < games; g++) {
+            if (done[g])
+                continue;
+            int side = position_side_to_move(positions[g]);
+            if (side == (g & 1)) {
+                batch_games[count] = g;
+                batch[count++] = positions[g];
+            } else {
+                uint64_t empty = position_empty(game, positions[g]);
+                int cell = engine_select_cell(empty, (int)rng_below(&rng, (uint32_t)engine_popcount(empty)));
+                position_make(&positions[g], side, cell);
+            }
+        }
+        choose_moves_batch(&request, batch, NULL, count, moves);
+        for (int i = 0; i < count; i++) {
+            Position* pos = &positions[batch_games[i]];
+            position_make(pos, position_side_to_move(*pos), moves[i]);
+        }
+
+        for (int g = 0; g < games; g++) {
+            if (done[g])
+                continue;
+            int outcome = game_outcome(game, positions[g]);
+            if (outcome == OUTCOME_ONGOING)
+                continue;
+            done[g] = true;
+            remaining--;
+            result->games++;
+            if (outcome == OUTCOME_DRAW)
+                result->draws++;
+            else if ((outcome == OUTCOME_X_WINS) == ((g & 1) == 0))
+                result->wins++;
+            else
+                result->losses++;
+        }
+    }
+
+out:
+    free(positions);
+    free(batch);
+    free(batch_games);
+    free(moves);
+    free(done);
+}
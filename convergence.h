@@ -0,0 +1,60 @@
+#ifndef CONVERGENCE_H
+#define CONVERGENCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+#include "qtable.h"
+
+#define CONVERGENCE_MAX_WINDOW 64
+
+// Training counts as converged once, over the last `window` evaluations,
+// the win and draw rates against the evaluation opponent moved by at most
+// rate_tolerance and the mean per-episode Q-delta norm stayed below
+// delta_threshold.
+typedef struct {
+    int window;
+    float delta_threshold;
+    float rate_tolerance;
+    int eval_interval;      // episodes between evaluations
+    int eval_games;         // games against the evaluation opponent per evaluation
+    long min_episodes;
+    uint64_t eval_seed;     // fixes the evaluation opponent's moves
+} ConvergenceConfig;
+
+typedef struct {
+    int games;
+    int wins;
+    int draws;
+    int losses;
+} EvaluationResult;
+
+typedef struct {
+    ConvergenceConfig config;
+    long episodes;
+    double delta_sum;       // since the last evaluation
+    int delta_count;
+    float delta_means[CONVERGENCE_MAX_WINDOW];
+    float win_rates[CONVERGENCE_MAX_WINDOW];
+    float draw_rates[CONVERGENCE_MAX_WINDOW];
+    int num_evaluations;
+    bool converged;
+    char reason[256];
+} ConvergenceTracker;
+
+ConvergenceConfig convergence_default_config();
+void convergence_init(ConvergenceTracker* tracker, const ConvergenceConfig* config);
+
+float q_delta_norm(const float* before, const float* after, size_t count);
+void convergence_record_episode(ConvergenceTracker* tracker, float q_delta);
+bool convergence_evaluation_due(const ConvergenceTracker* tracker);
+bool convergence_record_evaluation(ConvergenceTracker* tracker, const EvaluationResult* result);
+void convergence_finish(ConvergenceTracker* tracker, const char* reason);
+int convergence_write_summary(const ConvergenceTracker* tracker, const char* filename);
+
+// Greedy play of a Q-table against a uniformly random opponent, half of the
+// games as X and half as O
+void evaluate_against_random(const Game* game, const QTable* table, int games, uint64_t seed, EvaluationResult* result);
+
+#endif
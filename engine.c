@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <string.h>
+#include "engine.h"
+#include "qubic.h"
+
+// Function to add a winning line and index it under every cell it covers
+static void add_line(Game* game, uint64_t line) {
+    int index = game->num_lines++;
+    game->lines[index] = line;
+    for (uint64_t bits = line; bits; bits &= bits - 1) {
+        int cell = engine_lowest_cell(bits);
+        game->cell_lines[cell][game->cell_num_lines[cell]++] = (uint16_t)index;
+    }
+}
+
+// Function to initialize the geometry of a size x size board with win_length in a row
+int game_init(Game* game, int size, int win_length) {
+    if (size < 1 || size > ENGINE_MAX_SIZE || win_length < 2 || win_length > size)
+        return -1;
+
+    game->size = size;
+    game->win_length = win_length;
+    game->layers = 1;
+    game->num_cells = size * size;
+    game->num_lines = 0;
+    game->full_mask = game->num_cells == 64 ? ~0ULL : (1ULL << game->num_cells) - 1;
+    for (int cell = 0; cell < ENGINE_MAX_CELLS; cell++)
+        game->cell_num_lines[cell] = 0;
+
+    // Rows, columns, diagonals and anti-diagonals
+    static const int directions[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+    for (int d = 0; d < 4; d++) {
+        int dr = directions[d][0];
+        int dc = directions[d][1];
+        for (int r = 0; r < size; r++) {
+            for (int c = 0; c < size; c++) {
+                int end_r = r + dr * (win_length - 1);
+                int end_c = c + dc * (win_length - 1);
+                if (end_r < 0 || end_r >= size || end_c < 0 || end_c >= size)
+                    continue;
+                uint64_t line = 0;
+                for (int k = 0; k < win_length; k++)
+                    line |= 1ULL << ((r + dr * k) * size + (c + dc * k));
+                add_line(game, line);
+            }
+        }
+    }
+    return 0;
+}
+
+// Function to initialize the 4x4x4 cube from its precomputed lines
+int game_init_qubic(Game* game) {
+    game->size = QUBIC_SIZE;
+    game->win_length = QUBIC_SIZE;
+    game->layers = QUBIC_SIZE;
+    game->num_cells = QUBIC_NUM_CELLS;
+    game->num_lines = 0;
+    game->full_mask = ~0ULL;
+    for (int cell = 0; cell < ENGINE_MAX_CELLS; cell++)
+        game->cell_num_lines[cell] = 0;
+    for (int i = 0; i < QUBIC_NUM_LINES; i++)
+        add_line(game, qubic_lines[i]);
+    return 0;
+}
+
+int game_init_variant(Game* game, int size, int win_length, int layers) {
+    if (layers == 1)
+        return game_init(game, size, win_length);
+    if (layers == QUBIC_SIZE && size == QUBIC_SIZE && win_length == QUBIC_SIZE)
+        return game_init_qubic(game);
+    return -1;
+}
+
+// Check if a set of stones contains a complete line
+bool game_is_win(const Game* game, uint64_t stones) {
+    if (game->layers > 1)
+        return qubic_is_win(stones);
+    for (int i = 0; i < game->num_lines; i++) {
+        if ((stones & game->lines[i]) == game->lines[i])
+            return true;
+    }
+    return false;
+}
+
+// Check if the stone just placed on cell completes a line
+bool game_move_wins(const Game* game, uint64_t stones, int cell) {
+    for (int i = 0; i < game->cell_num_lines[cell]; i++) {
+        uint64_t line = game->lines[game->cell_lines[cell][i]];
+        if ((stones & line) == line)
+            return true;
+    }
+    return false;
+}
+
+// Function to check if the game is over
+int game_outcome(const Game* game, Position pos) {
+    if (game_is_win(game, pos.x))
+        return OUTCOME_X_WINS;
+    if (game_is_win(game, pos.o))
+        return OUTCOME_O_WINS;
+    if (position_empty(game, pos) == 0)
+        return OUTCOME_DRAW;
+    return OUTCOME_ONGOING;
+}
+
+// Convert a row-major char board (PLAYER_X / PLAYER_O / EMPTY_CELL) to a position
+Position position_from_board(const Game* game, const char* cells) {
+    Position pos = {0, 0};
+    for (int cell = 0; cell < game->num_cells; cell++) {
+        if (cells[cell] == PLAYER_X)
+            pos.x |= 1ULL << cell;
+        else if (cells[cell] == PLAYER_O)
+            pos.o |= 1ULL << cell;
+    }
+    return pos;
+}
+
+// Convert a position back to a row-major char board
+void position_to_board(const Game* game, Position pos, char* cells) {
+    for (int cell = 0; cell < game->num_cells; cell++) {
+        if (pos.x >> cell & 1)
+            cells[cell] = PLAYER_X;
+        else if (pos.o >> cell & 1)
+            cells[cell] = PLAYER_O;
+        else
+            cells[cell] = EMPTY_CELL;
+    }
+}
+
+// Function to compute where each cell goes under each symmetry of the board.
+// Symmetry 0 is the identity, 1-3 rotate by 90/180/270 degrees, 4-7 reflect.
+// On the cube every layer is turned the same way, which maps lines to lines.
+void game_symmetries(const Game* game, uint8_t map[ENGINE_NUM_SYMMETRIES][ENGINE_MAX_CELLS]) {
+    int n = game->size;
+    for (int layer = 0; layer < game->layers; layer++) {
+        int base = layer * n * n;
+        for (int r = 0; r < n; r++) {
+            for (int c = 0; c < n; c++) {
+                int images[ENGINE_NUM_SYMMETRIES][2] = {
+                    {r, c}, {c, n - 1 - r}, {n - 1 - r, n - 1 - c}, {n - 1 - c, r},
+                    {r, n - 1 - c}, {n - 1 - r, c}, {c, r}, {n - 1 - c, n - 1 - r},
+                };
+                for (int t = 0; t < ENGINE_NUM_SYMMETRIES; t++)
+                    map[t][base + r * n + c] = (uint8_t)(base + images[t][0] * n + images[t][1]);
+            }
+        }
+    }
+}
+
+// Function to lay out one layer: column numbers, then one row per line
+// between separators
+static int format_layer(const Game* game, Position pos, int layer, const char* separator, char* text, int size) {
+    int n = 0;
+    for (int col = 0; col < game->size && n < size; col++)
+        n += snprintf(text + n, size - n, "   %d", col);
+    if (n < size)
+        n += snprintf(text + n, size - n, "\n  %s\n", separator);
+    for (int row = 0; row < game->size && n < size; row++) {
+        n += snprintf(text + n, size - n, "%d |", row);
+        for (int col = 0; col < game->size && n < size; col++) {
+            int cell = (layer * game->size + row) * game->size + col;
+            char symbol = (pos.x >> cell & 1) ? PLAYER_X : (pos.o >> cell & 1) ? PLAYER_O : EMPTY_CELL;
+            n += snprintf(text + n, size - n, " %c |", symbol);
+        }
+        if (n < size)
+            n += snprintf(text + n, size - n, "\n  %s\n", separator);
+    }
+    return n < size ? n : size - 1;
+}
+
+// Function to lay out the board as text (column numbers, then one row per line
+// between separators, layer after layer on the cube); returns the length written
+int game_format_board(const Game* game, Position pos, char* text, int size) {
+    char separator[ENGINE_MAX_SIZE * 4 + 8];
+    memset(separator, '-', sizeof(separator));
+    separator[game->size * 4 - 1] = '\0';
+
+    int n = 0;
+    for (int layer = 0; layer < game->layers && n < size; layer++) {
+        if (game->layers > 1)
+            n += snprintf(text + n, size - n, "%sLayer %d\n", layer > 0 ? "\n" : "", layer);
+        if (n < size)
+            n += format_layer(game, pos, layer, separator, text + n, size - n);
+    }
+    return n < size ? n : size - 1;
+}
+
+// Function to print the board
+void game_print_board(const Game* game, Position pos) {
+    char text[ENGINE_BOARD_TEXT_SIZE];
+    game_format_board(game, pos, text, sizeof(text));
+    fputs(text, stdout);
+}
@@ -0,0 +1,132 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ENGINE_MAX_SIZE 8
+#define ENGINE_MAX_CELLS 64
+#define ENGINE_MAX_LINES 256
+#define ENGINE_MAX_CELL_LINES 32
+#define ENGINE_BOARD_TEXT_SIZE 2048
+#define ENGINE_NUM_SYMMETRIES 8 // rotations and reflections of the square (D4), layer by layer on the cube
+
+// Player symbols
+#define PLAYER_X 'X'
+#define PLAYER_O 'O'
+#define EMPTY_CELL ' '
+
+// Outcomes, same convention as theGame.c's game_over()
+#define OUTCOME_ONGOING 0
+#define OUTCOME_X_WINS 1
+#define OUTCOME_O_WINS 2
+#define OUTCOME_DRAW -1
+
+// A position is one bitboard per player, bit n = cell n
+// ((layer * size + row) * size + col)
+typedef struct {
+    uint64_t x;
+    uint64_t o;
+} Position;
+
+// Board geometry: size x size cells (in each of layers layers), win_length
+// stones in a row to win
+typedef struct {
+    int size;
+    int win_length;
+    int layers; // 1 for a flat board, QUBIC_SIZE for the 4x4x4 cube
+    int num_cells;
+    int num_lines;
+    uint64_t full_mask;
+    uint64_t lines[ENGINE_MAX_LINES];
+    uint8_t cell_num_lines[ENGINE_MAX_CELLS];
+    uint16_t cell_lines[ENGINE_MAX_CELLS][ENGINE_MAX_CELL_LINES];
+} Game;
+
+static inline int engine_popcount(uint64_t bits) {
+    return __builtin_popcountll(bits);
+}
+
+static inline int engine_lowest_cell(uint64_t bits) {
+    return __builtin_ctzll(bits);
+}
+
+// Cell of the n-th (0-based) set bit
+static inline int engine_select_cell(uint64_t bits, int n) {
+    while (n-- > 0)
+        bits &= bits - 1;
+    return engine_lowest_cell(bits);
+}
+
+// Small number naming the geometry, for tables kept per geometry: the board
+// size for flat boards and 0, never a flat size, for the cube
+static inline int game_slot(const Game* game) {
+    return game->layers > 1 ? 0 : game->size;
+}
+
+// Side to move: 0 for X, 1 for O (X always moves first)
+static inline int position_side_to_move(Position pos) {
+    return engine_popcount(pos.x) > engine_popcount(pos.o) ? 1 : 0;
+}
+
+static inline int position_num_stones(Position pos) {
+    return engine_popcount(pos.x | pos.o);
+}
+
+static inline uint64_t position_empty(const Game* game, Position pos) {
+    return game->full_mask & ~(pos.x | pos.o);
+}
+
+static inline uint64_t position_stones(Position pos, int side) {
+    return side == 0 ? pos.x : pos.o;
+}
+
+// Place a stone for side (0 = X, 1 = O) on an empty cell, without branching on side
+static inline void position_make(Position* pos, int side, int cell) {
+    uint64_t bit = 1ULL << cell;
+    uint64_t o_mask = 0 - (uint64_t)side;
+    pos->x |= bit & ~o_mask;
+    pos->o |= bit & o_mask;
+}
+
+// Take back the stone on cell, whoever placed it
+static inline void position_unmake(Position* pos, int cell) {
+    uint64_t bit = 1ULL << cell;
+    pos->x &= ~bit;
+    pos->o &= ~bit;
+}
+
+// Write the empty cells in increasing order to moves; returns how many there are
+static inline int position_legal_moves(const Game* game, Position pos, uint8_t* moves) {
+    int count = 0;
+    for (uint64_t empty = position_empty(game, pos); empty; empty &= empty - 1)
+        moves[count++] = (uint8_t)engine_lowest_cell(empty);
+    return count;
+}
+
+static inline int side_index(char player) {
+    return player == PLAYER_X ? 0 : 1;
+}
+
+static inline char side_symbol(int side) {
+    return side == 0 ? PLAYER_X : PLAYER_O;
+}
+
+int game_init(Game* game, int size, int win_length);
+int game_init_qubic(Game* game);
+// Either of the above: layers 1 is a flat board, layers 4 with size 4 and 4
+// in a row is Qubic
+int game_init_variant(Game* game, int size, int win_length, int layers);
+bool game_is_win(const Game* game, uint64_t stones);
+bool game_move_wins(const Game* game, uint64_t stones, int cell);
+int game_outcome(const Game* game, Position pos);
+
+Position position_from_board(const Game* game, const char* cells);
+void position_to_board(const Game* game, Position pos, char* cells);
+
+void game_symmetries(const Game* game, uint8_t map[ENGINE_NUM_SYMMETRIES][ENGINE_MAX_CELLS]);
+
+int game_format_board(const Game* game, Position pos, char* text, int size);
+void game_print_board(const Game* game, Position pos);
+
+#endif
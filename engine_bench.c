@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "engine.h"
+#include "batch_inference.h"
+#include "qtable.h"
+#include "rng.h"
+#include "state_index.h"
+#include "timer.h"
+#include "zobrist.h"
+
+#define BENCH_POSITIONS 4096
+
+// Keeps results alive so the compiler cannot drop the timed loops
+static volatile uint64_t sink;
+
+// Function to fill positions with random mid-game positions (the game may be over)
+static void random_positions(const Game* game, Position* positions, int count, Rng* rng) {
+    for (int i = 0; i < count; i++) {
+        Position pos = {0, 0};
+        int plies = (int)rng_below(rng, (uint32_t)game->num_cells);
+        for (int ply = 0; ply < plies; ply++) {
+            uint64_t empty = position_empty(game, pos);
+            int cell = engine_select_cell(empty, (int)rng_below(rng, (uint32_t)engine_popcount(empty)));
+            position_make(&pos, position_side_to_move(pos), cell);
+        }
+        positions[i] = pos;
+    }
+}
+
+static void report(const char* name, long operations, double seconds) {
+    printf("%-22s %12.1f ns/op  %14.0f ops/sec\n", name, seconds * 1e9 / operations, operations / seconds);
+}
+
+// Random playouts from the empty board, finished with the incremental win check
+static void bench_playouts(const Game* game, long count, Rng* rng) {
+    double start = monotonic_seconds();
+    uint64_t total = 0;
+    for (long i = 0; i < count; i++) {
+        Position pos = {0, 0};
+        for (;;) {
+            uint64_t empty = position_empty(game, pos);
+            if (empty == 0)
+                break;
+            int side = position_side_to_move(pos);
+            int cell = engine_select_cell(empty, (int)rng_below(rng, (uint32_t)engine_popcount(empty)));
+            position_make(&pos, side, cell);
+            if (game_move_wins(game, position_stones(pos, side), cell))
+                break;
+        }
+        total += pos.x ^ pos.o;
+    }
+    sink = total;
+    report("random playout", count, monotonic_seconds() - start);
+}
+
+// Benchmark the core engine kernels every tool is built on
+// Usage: engine_bench [size] [win_length] [iterations] [layers]
+int main(int argc, char* argv[]) {
+    int size = argc > 1 ? atoi(argv[1]) : 3;
+    int win_length = argc > 2 ? atoi(argv[2]) : size;
+    long iterations = argc > 3 ? atol(argv[3]) : 2000000;
+    int layers = argc > 4 ? atoi(argv[4]) : 1;
+
+    Game game;
+    if (game_init_variant(&game, size, win_length, layers) != 0) {
+        printf("Error: Unsupported board %dx%d (%d layers) with %d in a row.\n", size, size, layers, win_length);
+        return 1;
+    }
+    Position* positions = malloc(BENCH_POSITIONS * sizeof(Position));
+    int* moves = malloc(BENCH_POSITIONS * sizeof(int));
+    if (positions == NULL || moves == NULL) {
+        printf("Error: Unable to allocate the benchmark positions.\n");
+        return 1;
+    }
+    Rng rng;
+    rng_seed(&rng, 1);
+    random_positions(&game, positions, BENCH_POSITIONS, &rng);
+    if (layers > 1)
+        printf("%dx%dx%d, %d in a row, %d lines\n", size, size, layers, win_length, game.num_lines);
+    else
+        printf("%dx%d, %d in a row, %d lines\n", size, size, win_length, game.num_lines);
+
+    double start = monotonic_seconds();
+    uint64_t total = 0;
+    for (long i = 0; i < iterations; i++)
+        total += (uint64_t)game_outcome(&game, positions[i & (BENCH_POSITIONS - 1)]);
+    sink = total;
+    report("game_outcome", iterations, monotonic_seconds() - start);
+
+    // The cube checks all its lines with SIMD; time the plain scan for comparison
+    if (game.layers > 1) {
+        start = monotonic_seconds();
+        for (long i = 0; i < iterations; i++) {
+            uint64_t stones = position_stones(positions[i & (BENCH_POSITIONS - 1)], (int)(i & 1));
+            for (int l = 0; l < game.num_lines; l++) {
+                if ((stones & game.lines[l]) == game.lines[l]) {
+                    total++;
+                    break;
+                }
+            }
+        }
+        sink = total;
+        report("line scan (scalar)", iterations, monotonic_seconds() - start);
+
+        start = monotonic_seconds();
+        for (long i = 0; i < iterations; i++)
+            total += game_is_win(&game, position_stones(positions[i & (BENCH_POSITIONS - 1)], (int)(i & 1)));
+        sink = total;
+        report("game_is_win (SSE2)", iterations, monotonic_seconds() - start);
+    }
+
+    start = monotonic_seconds();
+    for (long i = 0; i < iterations; i++) {
+        Position pos = positions[i & (BENCH_POSITIONS - 1)];
+        uint64_t stones = position_stones(pos, (int)(i & 1));
+        total += game_move_wins(&game, stones, (int)(i % game.num_cells));
+    }
+    sink = total;
+    report("game_move_wins", iterations, monotonic_seconds() - start);
+
+    start = monotonic_seconds();
+    uint8_t legal[ENGINE_MAX_CELLS];
+    for (long i = 0; i < iterations; i++)
+        total += (uint64_t)position_legal_moves(&game, positions[i & (BENCH_POSITIONS - 1)], legal);
+    sink = total;
+    report("position_legal_moves", iterations, monotonic_seconds() - start);
+
+    start = monotonic_seconds();
+    for (long i = 0; i < iterations; i++) {
+        Position pos = positions[i & (BENCH_POSITIONS - 1)];
+        int cell = (int)(i % game.num_cells);
+        position_make(&pos, (int)(i & 1), cell);
+        total += pos.x + pos.o;
+        position_unmake(&pos, cell);
+        total += pos.x;
+    }
+    sink = total;
+    report("make + unmake", iterations, monotonic_seconds() - start);
+
+    start = monotonic_seconds();
+    HashedPosition hashed;
+    hashed_position_init(&hashed, &game, (Position){0, 0});
+    for (long i = 0; i < iterations; i++) {
+        int cell = (int)(i % game.num_cells);
+        hashed_position_make(&hashed, &game, (int)(i & 1), cell);
+        total += hashed.hash;
+        hashed_position_unmake(&hashed, &game, (int)(i & 1), cell);
+    }
+    sink = total;
+    report("zobrist make + unmake", iterations, monotonic_seconds() - start);
+
+    ZobristSymmetry symmetry;
+    SymmetricHash symmetric;
+    zobrist_symmetry_init(&symmetry, &game);
+    symmetric_hash_init(&symmetric, &symmetry, (Position){0, 0});
+    start = monotonic_seconds();
+    for (long i = 0; i < iterations; i++) {
+        symmetric_hash_toggle(&symmetric, &symmetry, (int)(i & 1), (int)(i % game.num_cells));
+        total += symmetric_hash_canonical(&symmetric);
+    }
+    sink = total;
+    report("symmetric hash toggle", iterations, monotonic_seconds() - start);
+
+    start = monotonic_seconds();
+    for (long i = 0; i < iterations; i++)
+        total += zobrist_hash(&game, positions[i & (BENCH_POSITIONS - 1)]);
+    sink = total;
+    report("zobrist from scratch", iterations, monotonic_seconds() - start);
+
+    QTable table;
+    if (qtable_init_positional(&table, &game) != 0) {
+        printf("Error: Unable to allocate the Q-table.\n");
+        return 1;
+    }
+    for (size_t i = 0; i < qtable_num_values(&table); i++)
+        table.values[i] = rng_uniform(&rng);
+    BatchRequest request = {.game = &game, .table = &table, .num_threads = 1};
+    long batches = iterations / BENCH_POSITIONS + 1;
+    start = monotonic_seconds();
+    for (long b = 0; b < batches; b++)
+        choose_moves_batch(&request, positions, NULL, BENCH_POSITIONS, moves);
+    report("choose_moves_batch", batches * BENCH_POSITIONS, monotonic_seconds() - start);
+    qtable_free(&table);
+
+    if (game.num_cells <= 9) {
+        StateIndex index;
+        if (state_index_build(&index, &game) == 0) {
+            start = monotonic_seconds();
+            for (long i = 0; i < iterations; i++)
+                total += state_index_rank(&index, positions[i & (BENCH_POSITIONS - 1)]);
+            sink = total;
+            report("state_index_rank", iterations, monotonic_seconds() - start);
+            state_index_free(&index);
+        }
+    }
+
+    bench_playouts(&game, iterations / 10, &rng);
+
+    free(positions);
+    free(moves);
+    return 0;
+}
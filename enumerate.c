@@ -0,0 +1,385 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "state_index.h"
+#include "timer.h"
+
+#define MAX_THREADS 64
+#define DEQUE_CAPACITY 1024 // subtrees a worker can hold; when full it just searches in place
+#define DEQUE_LOW 8         // a worker splits a subtree when its deque runs lower than this
+#define SEQUENTIAL_DEPTH 4  // subtrees this shallow are never split
+
+// Known values for the full 3x3 tree
+#define KNOWN_3X3_GAMES 255168ULL
+#define KNOWN_3X3_X_WINS 131184ULL
+#define KNOWN_3X3_O_WINS 77904ULL
+#define KNOWN_3X3_DRAWS 46080ULL
+#define KNOWN_3X3_POSITIONS 5478ULL
+static const uint64_t known_3x3_nodes[10] = {1, 9, 72, 504, 3024, 15120, 54720, 148176, 200448, 127872};
+
+// A subtree still to be searched: the position and the move that led to it
+typedef struct {
+    Position pos;
+    int8_t ply;
+    int8_t last_cell; // -1 at the root
+} Task;
+
+// Mutex-protected deque: the owner pushes and pops at the bottom (depth
+// first, so it stays in cache), thieves take the oldest and largest subtrees
+// from the top
+typedef struct {
+    pthread_mutex_t lock;
+    Task tasks[DEQUE_CAPACITY];
+    int top;
+    int bottom;
+} Deque;
+
+typedef struct Pool Pool;
+
+// One thread's deque and counters, on their own cache lines
+typedef struct {
+    Pool* pool;
+    int id;
+    uint64_t nodes[ENGINE_MAX_CELLS + 1]; // nodes per ply
+    uint64_t outcomes[3];                 // finished games: X wins, O wins, draws
+    uint64_t frontier;                    // games cut off by the depth limit
+    uint64_t steals;
+    uint64_t errors;                      // kernel disagreements found by --verify
+    Deque deque;
+} __attribute__((aligned(64))) Worker;
+
+struct Pool {
+    const Game* game;
+    const StateIndex* index; // distinct positions are counted when set
+    uint64_t* seen;          // one bit per indexed position
+    int max_depth;
+    bool verify;
+    int num_threads;
+    Worker* workers;
+    _Atomic long pending;    // tasks pushed and not yet finished
+};
+
+enum { RESULT_X_WINS, RESULT_O_WINS, RESULT_DRAW };
+
+static bool deque_push(Deque* deque, Task task) {
+    pthread_mutex_lock(&deque->lock);
+    bool pushed = deque->bottom - deque->top < DEQUE_CAPACITY;
+    if (pushed)
+        deque->tasks[deque->bottom++ % DEQUE_CAPACITY] = task;
+    pthread_mutex_unlock(&deque->lock);
+    return pushed;
+}
+
+static bool deque_pop(Deque* deque, Task* task) {
+    pthread_mutex_lock(&deque->lock);
+    bool popped = deque->bottom > deque->top;
+    if (popped)
+        *task = deque->tasks[--deque->bottom % DEQUE_CAPACITY];
+    pthread_mutex_unlock(&deque->lock);
+    return popped;
+}
+
+static bool deque_steal(Deque* deque, Task* task) {
+    pthread_mutex_lock(&deque->lock);
+    bool stolen = deque->bottom > deque->top;
+    if (stolen)
+        *task = deque->tasks[deque->top++ % DEQUE_CAPACITY];
+    pthread_mutex_unlock(&deque->lock);
+    return stolen;
+}
+
+static int deque_size(Deque* deque) {
+    pthread_mutex_lock(&deque->lock);
+    int size = deque->bottom - deque->top;
+    pthread_mutex_unlock(&deque->lock);
+    return size;
+}
+
+// Function to check the incremental kernels against the from-scratch ones
+static void verify_node(Worker* worker, Position pos, int ply, int result) {
+    const Game* game = worker->pool->game;
+    int outcome = game_outcome(game, pos);
+    int expected = result == RESULT_X_WINS ? OUTCOME_X_WINS
+                 : result == RESULT_O_WINS ? OUTCOME_O_WINS
+                 : result == RESULT_DRAW   ? OUTCOME_DRAW
+                                           : OUTCOME_ONGOING;
+    uint8_t moves[ENGINE_MAX_CELLS];
+    if (outcome != expected || position_legal_moves(game, pos, moves) != game->num_cells - ply ||
+        position_num_stones(pos) != ply)
+        worker->errors++;
+}
+
+// Function to count a node and classify it: a game result, or -1 if play goes on
+static int visit(Worker* worker, Position pos, int ply, int last_cell) {
+    Pool* pool = worker->pool;
+    worker->nodes[ply]++;
+    if (pool->seen != NULL) {
+        uint32_t rank = state_index_rank(pool->index, pos);
+        if (rank == STATE_INDEX_NONE)
+            worker->errors++;
+        else
+            __atomic_fetch_or(&pool->seen[rank >> 6], 1ULL << (rank & 63), __ATOMIC_RELAXED);
+    }
+
+    int result = -1;
+    if (last_cell >= 0) {
+        int mover = position_side_to_move(pos) ^ 1;
+        if (game_move_wins(pool->game, position_stones(pos, mover), last_cell))
+            result = mover == 0 ? RESULT_X_WINS : RESULT_O_WINS;
+    }
+    if (result < 0 && ply == pool->game->num_cells)
+        result = RESULT_DRAW;
+    if (pool->verify)
+        verify_node(worker, pos, ply, result);
+    if (result >= 0)
+        worker->outcomes[result]++;
+    else if (ply == pool->max_depth)
+        worker->frontier++;
+    return result;
+}
+
+// Plain depth-first search with make/unmake, below the split depth
+static void search(Worker* worker, Position pos, int ply, int last_cell) {
+    if (visit(worker, pos, ply, last_cell) >= 0 || ply == worker->pool->max_depth)
+        return;
+    int side = position_side_to_move(pos);
+    for (uint64_t empty = position_empty(worker->pool->game, pos); empty; empty &= empty - 1) {
+        int cell = engine_lowest_cell(empty);
+        position_make(&pos, side, cell);
+        search(worker, pos, ply + 1, cell);
+        position_unmake(&pos, cell);
+    }
+}
+
+// Function to run one task: a deep subtree is split into its children while
+// this worker is short of work (so idle threads have something to steal),
+// anything else is searched in place
+static void run_task(Worker* worker, Task task) {
+    Pool* pool = worker->pool;
+    if (pool->max_depth - task.ply <= SEQUENTIAL_DEPTH || deque_size(&worker->deque) >= DEQUE_LOW) {
+        search(worker, task.pos, task.ply, task.last_cell);
+        return;
+    }
+    if (visit(worker, task.pos, task.ply, task.last_cell) >= 0)
+        return;
+    int side = position_side_to_move(task.pos);
+    for (uint64_t empty = position_empty(pool->game, task.pos); empty; empty &= empty - 1) {
+        int cell = engine_lowest_cell(empty);
+        Task child = {task.pos, (int8_t)(task.ply + 1), (int8_t)cell};
+        position_make(&child.pos, side, cell);
+        atomic_fetch_add(&pool->pending, 1);
+        if (!deque_push(&worker->deque, child)) {
+            atomic_fetch_sub(&pool->pending, 1);
+            search(worker, child.pos, child.ply, child.last_cell);
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    Pool* pool = worker->pool;
+    uint32_t victim = (uint32_t)worker->id;
+    for (;;) {
+        Task task;
+        bool found = deque_pop(&worker->deque, &task);
+        // Out of work: try every other worker once, starting after the last victim
+        for (int tries = 1; !found && tries < pool->num_threads; tries++) {
+            victim = (victim + 1) % (uint32_t)pool->num_threads;
+            if ((int)victim != worker->id && deque_steal(&pool->workers[victim].deque, &task)) {
+                found = true;
+                worker->steals++;
+            }
+        }
+        if (found) {
+            run_task(worker, task);
+            atomic_fetch_sub(&pool->pending, 1);
+        } else if (atomic_load(&pool->pending) == 0) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+// Function to enumerate the tree with num_threads workers; returns the wall time
+static double enumerate(Pool* pool, int num_threads) {
+    pool->num_threads = num_threads;
+    for (int t = 0; t < num_threads; t++) {
+        Worker* worker = &pool->workers[t];
+        memset(worker->nodes, 0, sizeof(worker->nodes));
+        memset(worker->outcomes, 0, sizeof(worker->outcomes));
+        worker->frontier = worker->steals = worker->errors = 0;
+        worker->deque.top = worker->deque.bottom = 0;
+        worker->pool = pool;
+        worker->id = t;
+    }
+    if (pool->seen != NULL)
+        memset(pool->seen, 0, ((size_t)pool->index->num_states + 63) / 64 * sizeof(uint64_t));
+
+    Task root = {{0, 0}, 0, -1};
+    atomic_store(&pool->pending, 1);
+    deque_push(&pool->workers[0].deque, root);
+
+    double start = monotonic_seconds();
+    pthread_t threads[MAX_THREADS];
+    bool started[MAX_THREADS];
+    for (int t = 1; t < num_threads; t++)
+        started[t] = pthread_create(&threads[t], NULL, worker_main, &pool->workers[t]) == 0;
+    worker_main(&pool->workers[0]);
+    for (int t = 1; t < num_threads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+    return monotonic_seconds() - start;
+}
+
+static bool check(const char* name, uint64_t got, uint64_t expected) {
+    if (got == expected)
+        return true;
+    printf("MISMATCH %s: got %llu, expected %llu\n", name, (unsigned long long)got, (unsigned long long)expected);
+    return false;
+}
+
+// Function to sum the workers' counters and check them against what is known
+static bool report(const Pool* pool, int num_threads, double seconds, double single, bool print_totals) {
+    const Game* game = pool->game;
+    uint64_t nodes[ENGINE_MAX_CELLS + 1] = {0};
+    uint64_t outcomes[3] = {0, 0, 0}, frontier = 0, steals = 0, errors = 0, total = 0;
+    for (int t = 0; t < num_threads; t++) {
+        const Worker* worker = &pool->workers[t];
+        for (int ply = 0; ply <= pool->max_depth; ply++)
+            nodes[ply] += worker->nodes[ply];
+        for (int r = 0; r < 3; r++)
+            outcomes[r] += worker->outcomes[r];
+        frontier += worker->frontier;
+        steals += worker->steals;
+        errors += worker->errors;
+    }
+    for (int ply = 0; ply <= pool->max_depth; ply++)
+        total += nodes[ply];
+    uint64_t games = outcomes[0] + outcomes[1] + outcomes[2];
+    uint64_t distinct = 0;
+    if (pool->seen != NULL) {
+        for (uint32_t w = 0; w < (pool->index->num_states + 63) / 64; w++)
+            distinct += (uint64_t)engine_popcount(pool->seen[w]);
+    }
+
+    printf("%7d  %13llu  %13.0f  %7.2f  %8llu  ", num_threads, (unsigned long long)total, total / seconds,
+           single > 0 ? single / seconds : 1.0, (unsigned long long)steals);
+    for (int t = 0; t < num_threads; t++) {
+        uint64_t worker_nodes = 0;
+        for (int ply = 0; ply <= pool->max_depth; ply++)
+            worker_nodes += pool->workers[t].nodes[ply];
+        printf("%s%.1f", t ? " " : "", worker_nodes / seconds / 1e6);
+    }
+    printf("\n");
+
+    if (print_totals) {
+        printf("\nply  nodes\n");
+        for (int ply = 0; ply <= pool->max_depth; ply++)
+            printf("%3d  %llu\n", ply, (unsigned long long)nodes[ply]);
+        printf("finished games %llu (X %llu, O %llu, draws %llu), cut off %llu", (unsigned long long)games,
+               (unsigned long long)outcomes[RESULT_X_WINS], (unsigned long long)outcomes[RESULT_O_WINS],
+               (unsigned long long)outcomes[RESULT_DRAW], (unsigned long long)frontier);
+        if (pool->seen != NULL)
+            printf(", distinct positions %llu", (unsigned long long)distinct);
+        printf("\n\n");
+    }
+
+    bool ok = check("kernel errors", errors, 0);
+    // No game can end before X's win_length-th stone, so the first plies hold
+    // every ordering of distinct cells: n * (n - 1) * ... * (n - ply + 1)
+    uint64_t falling = 1;
+    for (int ply = 0; ply <= pool->max_depth && ply <= 2 * game->win_length - 1; ply++) {
+        char name[32];
+        snprintf(name, sizeof(name), "nodes at ply %d", ply);
+        ok &= check(name, nodes[ply], falling);
+        falling *= (uint64_t)(game->num_cells - ply);
+    }
+    if (game->size == 3 && game->win_length == 3 && pool->max_depth == 9) {
+        for (int ply = 0; ply <= 9; ply++) {
+            char name[32];
+            snprintf(name, sizeof(name), "nodes at ply %d", ply);
+            ok &= check(name, nodes[ply], known_3x3_nodes[ply]);
+        }
+        ok &= check("games", games, KNOWN_3X3_GAMES);
+        ok &= check("X wins", outcomes[RESULT_X_WINS], KNOWN_3X3_X_WINS);
+        ok &= check("O wins", outcomes[RESULT_O_WINS], KNOWN_3X3_O_WINS);
+        ok &= check("draws", outcomes[RESULT_DRAW], KNOWN_3X3_DRAWS);
+        ok &= check("distinct positions", distinct, KNOWN_3X3_POSITIONS);
+    } else if (pool->seen != NULL && pool->max_depth == game->num_cells) {
+        ok &= check("distinct positions", distinct, pool->index->num_states);
+    }
+    return ok;
+}
+
+// Enumerate every game to a depth limit with work-stealing DFS, check the
+// counts against known values, and report nodes/sec for 1, 2, 4, ... threads.
+// Usage: enumerate [size] [win_length] [max_depth] [max_threads] [--verify]
+int main(int argc, char* argv[]) {
+    int numbers[4] = {3, 0, 0, 4};
+    int num_numbers = 0;
+    bool verify = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else if (num_numbers < 4) {
+            numbers[num_numbers++] = atoi(argv[i]);
+        } else {
+            printf("Usage: enumerate [size] [win_length] [max_depth] [max_threads] [--verify]\n");
+            return 1;
+        }
+    }
+    int size = numbers[0];
+    int win_length = num_numbers > 1 ? numbers[1] : size;
+    int max_threads = numbers[3] < 1 ? 1 : numbers[3] > MAX_THREADS ? MAX_THREADS : numbers[3];
+
+    Game game;
+    if (game_init(&game, size, win_length) != 0) {
+        printf("Error: Unsupported board %dx%d with %d in a row.\n", size, size, win_length);
+        return 1;
+    }
+    int max_depth = num_numbers > 2 && numbers[2] > 0 && numbers[2] < game.num_cells ? numbers[2] : game.num_cells;
+
+    Pool pool = {.game = &game, .max_depth = max_depth, .verify = verify};
+    StateIndex index;
+    // Distinct positions are tracked on boards small enough to index cheaply
+    if (game.num_cells <= 9 && state_index_build(&index, &game) == 0) {
+        pool.index = &index;
+        pool.seen = malloc(((size_t)index.num_states + 63) / 64 * sizeof(uint64_t));
+    }
+    pool.workers = aligned_alloc(64, sizeof(Worker) * MAX_THREADS);
+    if (pool.workers == NULL || (pool.index != NULL && pool.seen == NULL)) {
+        printf("Error: Unable to allocate the workers.\n");
+        return 1;
+    }
+    for (int t = 0; t < max_threads; t++)
+        pthread_mutex_init(&pool.workers[t].deque.lock, NULL);
+
+    printf("%dx%d, %d in a row, depth %d%s\n", size, size, win_length, max_depth, verify ? ", verifying kernels" : "");
+    printf("threads  nodes          nodes/sec      speedup  steals    Mnodes/sec per thread\n");
+    bool ok = true;
+    double single = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double seconds = enumerate(&pool, threads);
+        if (threads == 1)
+            single = seconds;
+        ok &= report(&pool, threads, seconds, single, threads * 2 > max_threads);
+    }
+    printf("%s\n", ok ? "All counts match." : "Counts do NOT match.");
+
+    for (int t = 0; t < max_threads; t++)
+        pthread_mutex_destroy(&pool.workers[t].deque.lock);
+    free(pool.workers);
+    if (pool.index != NULL) {
+        free(pool.seen);
+        state_index_free(&index);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "latency.h"
+#include "policy.h"
+#include "qubic.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+typedef struct {
+    _Atomic uint64_t counts[LATENCY_BUCKETS];
+    _Atomic uint64_t max;
+} LatencyHistogram;
+
+// One thread's histograms, allocated as it first records each pair. Threads
+// push their recorder onto a list and never remove it, so decisions made by
+// threads that have finished still show up in the report.
+typedef struct LatencyRecorder {
+    struct LatencyRecorder* next;
+    _Atomic(LatencyHistogram*) histograms[LATENCY_MAX_KINDS][ENGINE_MAX_SIZE + 1];
+} LatencyRecorder;
+
+_Static_assert(POLICY_NUM_KINDS <= LATENCY_MAX_KINDS, "LATENCY_MAX_KINDS is too small");
+
+bool latency_enabled = false;
+static _Atomic(LatencyRecorder*) recorders;
+static __thread LatencyRecorder* local_recorder;
+static const char* report_path; // NULL for stderr
+
+static LatencyRecorder* register_recorder(void) {
+    LatencyRecorder* recorder = calloc(1, sizeof(LatencyRecorder));
+    if (recorder == NULL)
+        return NULL;
+    recorder->next = atomic_load(&recorders);
+    while (!atomic_compare_exchange_weak(&recorders, &recorder->next, recorder))
+        ;
+    return recorder;
+}
+
+void latency_record(int kind, int board_size, uint64_t ns) {
+    if (local_recorder == NULL && (local_recorder = register_recorder()) == NULL)
+        return;
+    _Atomic(LatencyHistogram*)* slot = &local_recorder->histograms[kind][board_size];
+    LatencyHistogram* histogram = atomic_load_explicit(slot, memory_order_relaxed);
+    if (histogram == NULL) {
+        if ((histogram = calloc(1, sizeof(LatencyHistogram))) == NULL)
+            return;
+        atomic_store_explicit(slot, histogram, memory_order_release);
+    }
+    // This thread is the only writer, so a plain load and store is enough;
+    // the atomics only keep concurrent merges well defined
+    _Atomic uint64_t* count = &histogram->counts[latency_bucket(ns)];
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+    if (ns > atomic_load_explicit(&histogram->max, memory_order_relaxed))
+        atomic_store_explicit(&histogram->max, ns, memory_order_relaxed);
+}
+
+uint64_t latency_merge(int kind, int board_size, uint64_t counts[LATENCY_BUCKETS], uint64_t* max) {
+    uint64_t total = 0;
+    memset(counts, 0, LATENCY_BUCKETS * sizeof(uint64_t));
+    *max = 0;
+    for (LatencyRecorder* recorder = atomic_load(&recorders); recorder != NULL; recorder = recorder->next) {
+        LatencyHistogram* histogram = atomic_load_explicit(&recorder->histograms[kind][board_size], memory_order_acquire);
+        if (histogram == NULL)
+            continue;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            uint64_t count = atomic_load_explicit(&histogram->counts[b], memory_order_relaxed);
+            counts[b] += count;
+            total += count;
+        }
+        uint64_t histogram_max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+        if (histogram_max > *max)
+            *max = histogram_max;
+    }
+    return total;
+}
+
+uint64_t latency_percentile(const uint64_t counts[LATENCY_BUCKETS], uint64_t total, uint64_t max, double fraction) {
+    uint64_t rank = (uint64_t)(fraction * (double)total + 0.999999);
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            uint64_t value = latency_bucket_value(b);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+void latency_format(char* text, size_t size, uint64_t ns) {
+    if (ns < 1000)
+        snprintf(text, size, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000)
+        snprintf(text, size, "%.1fus", ns / 1e3);
+    else if (ns < 1000000000)
+        snprintf(text, size, "%.1fms", ns / 1e6);
+    else
+        snprintf(text, size, "%.1fs", ns / 1e9);
+}
+
+void latency_report(FILE* out) {
+    static const double fractions[4] = {0.5, 0.9, 0.99, 0.999};
+    uint64_t* counts = malloc(LATENCY_BUCKETS * sizeof(uint64_t));
+    if (counts == NULL)
+        return;
+    fprintf(out, "%-10s %5s %12s %9s %9s %9s %9s %9s\n", "policy", "board", "decisions", "p50", "p90", "p99", "p99.9", "max");
+    for (int kind = 0; kind < LATENCY_MAX_KINDS; kind++) {
+        for (int size = 0; size <= ENGINE_MAX_SIZE; size++) {
+            uint64_t max;
+            uint64_t total = latency_merge(kind, size, counts, &max);
+            if (total == 0)
+                continue;
+            char board[16], text[5][16];
+            if (size == 0)
+                snprintf(board, sizeof(board), "%dx%dx%d", QUBIC_SIZE, QUBIC_SIZE, QUBIC_SIZE);
+            else
+                snprintf(board, sizeof(board), "%dx%d", size, size);
+            for (int p = 0; p < 4; p++)
+                latency_format(text[p], sizeof(text[p]), latency_percentile(counts, total, max, fractions[p]));
+            latency_format(text[4], sizeof(text[4]), max);
+            fprintf(out, "%-10s %5s %12llu %9s %9s %9s %9s %9s\n", policy_kind_name((PolicyKind)kind), board,
+                    (unsigned long long)total, text[0], text[1], text[2], text[3], text[4]);
+        }
+    }
+    fflush(out);
+    free(counts);
+}
+
+// Function to write the report where TICTACTOE_LATENCY asked for it
+static void write_report(void) {
+    if (report_path == NULL) {
+        fflush(stdout); // keep the report after whatever the program printed
+        fprintf(stderr, "\nDecision latency:\n");
+        latency_report(stderr);
+        return;
+    }
+    FILE* out = fopen(report_path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Unable to write the latency report to %s.\n", report_path);
+        return;
+    }
+    latency_report(out);
+    fclose(out);
+}
+
+#ifndef _WIN32
+// SIGUSR1 is blocked in every thread and taken here with sigwait, so the
+// report is written by an ordinary thread rather than a signal handler
+static void* signal_reporter(void* arg) {
+    sigset_t* signals = arg;
+    for (;;) {
+        int signal;
+        if (sigwait(signals, &signal) == 0)
+            write_report();
+    }
+    return NULL;
+}
+#endif
+
+void latency_init_from_env(void) {
+    const char* setting = getenv("TICTACTOE_LATENCY");
+    if (setting == NULL || setting[0] == '\0' || strcmp(setting, "0") == 0)
+        return;
+    report_path = strcmp(setting, "1") == 0 ? NULL : setting;
+    latency_enabled = true;
+    atexit(write_report);
+#ifndef _WIN32
+    static sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_t thread;
+    if (pthread_sigmask(SIG_BLOCK, &signals, NULL) == 0 && pthread_create(&thread, NULL, signal_reporter, &signals) == 0)
+        pthread_detach(thread);
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "engine.h"
+
+// HDR-style latency histograms: exact below 64 ns, then 32 buckets per
+// power of two (about 3% resolution) up to 2^48 ns, with everything slower
+// counted in the last bucket
+#define LATENCY_LINEAR 64
+#define LATENCY_SUB_BUCKETS 32
+#define LATENCY_MAX_EXPONENT 47
+#define LATENCY_BUCKETS ((LATENCY_MAX_EXPONENT - 3) * LATENCY_SUB_BUCKETS)
+#define LATENCY_MAX_KINDS 16
+
+// Set by latency_init_from_env; while false nothing is timed
+extern bool latency_enabled;
+
+static inline int latency_bucket(uint64_t ns) {
+    if (ns < LATENCY_LINEAR)
+        return (int)ns;
+    int exponent = 63 - __builtin_clzll(ns);
+    if (exponent > LATENCY_MAX_EXPONENT)
+        return LATENCY_BUCKETS - 1;
+    int shift = exponent - 5;
+    return shift * LATENCY_SUB_BUCKETS + (int)(ns >> shift);
+}
+
+// Largest value that lands in bucket
+static inline uint64_t latency_bucket_value(int bucket) {
+    if (bucket < LATENCY_LINEAR)
+        return (uint64_t)bucket;
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t lowest = (uint64_t)(bucket - shift * LATENCY_SUB_BUCKETS) << shift;
+    return lowest + (1ULL << shift) - 1;
+}
+
+// Record one decision of a policy kind on a geometry (game_slot). Each thread writes
+// only its own histograms (no locks, no atomic read-modify-write); readers
+// merge every thread's on demand.
+void latency_record(int kind, int board_size, uint64_t ns);
+
+// Merged counts of one (kind, board size) over all threads; returns the total
+uint64_t latency_merge(int kind, int board_size, uint64_t counts[LATENCY_BUCKETS], uint64_t* max);
+
+// Value at or below which a fraction of total counts fall, at most max
+uint64_t latency_percentile(const uint64_t counts[LATENCY_BUCKETS], uint64_t total, uint64_t max, double fraction);
+
+// ns in the report's units: "850ns", "12.5us", "3.2ms" or "1.1s"
+void latency_format(char* text, size_t size, uint64_t ns);
+
+// Print p50/p90/p99/p99.9/max for everything recorded so far
+void latency_report(FILE* out);
+
+// Turn recording on if TICTACTOE_LATENCY is set. The report is printed at
+// exit and on SIGUSR1, to stderr when the variable is "1" and to the file it
+// names otherwise. Call before starting any threads.
+void latency_init_from_env(void);
+
+#endif
@@ -0,0 +1,132 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "engine.h"
+#include "live_qtable.h"
+#include "policy.h"
+#include "rng.h"
+#include "timer.h"
+
+#define MAX_READERS 32
+#define BENCH_POSITIONS 4096
+
+typedef struct {
+    LiveQTable* live;
+    const Game* game;
+    const Position* positions;
+    _Atomic int* stop;
+    int reader;
+    long moves;
+    long torn; // rows holding values from two different publishes
+    long versions_seen;
+} ReaderArgs;
+
+// Serve greedy moves from whatever snapshot is current, checking that every
+// row read is whole: the writer stamps one version number into all values
+static void* reader_main(void* arg) {
+    ReaderArgs* args = arg;
+    Policy policy;
+    policy_init_greedy(&policy, NULL);
+    float last_version = -1;
+    for (long i = 0; !atomic_load_explicit(args->stop, memory_order_relaxed); i++) {
+        Position pos = args->positions[i & (BENCH_POSITIONS - 1)];
+        policy.table = live_qtable_read_begin(args->live, args->reader);
+        int move = policy_choose_move(&policy, args->game, pos);
+        const float* row = qtable_row(policy.table, pos, position_side_to_move(pos));
+        for (int cell = 1; cell < args->game->num_cells; cell++)
+            args->torn += row[cell] != row[0];
+        if (row[0] != last_version) {
+            last_version = row[0];
+            args->versions_seen++;
+        }
+        live_qtable_read_end(args->live, args->reader);
+        args->moves += move >= 0;
+    }
+    return NULL;
+}
+
+// Benchmark the RCU Q-table: readers serve moves with no locks while one
+// writer keeps rewriting and publishing the table
+// Usage: live_bench [readers] [seconds] [size] [win_length]
+int main(int argc, char* argv[]) {
+    int num_readers = argc > 1 ? atoi(argv[1]) : 3;
+    double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+    int size = argc > 3 ? atoi(argv[3]) : 3;
+    int win_length = argc > 4 ? atoi(argv[4]) : size;
+    if (num_readers < 1 || num_readers > MAX_READERS) {
+        printf("Error: Use 1 to %d readers.\n", MAX_READERS);
+        return 1;
+    }
+
+    Game game;
+    if (game_init(&game, size, win_length) != 0) {
+        printf("Error: Unsupported board %dx%d with %d in a row.\n", size, size, win_length);
+        return 1;
+    }
+    QTable initial;
+    LiveQTable* live = aligned_alloc(64, sizeof(LiveQTable));
+    if (live == NULL || qtable_init_positional(&initial, &game) != 0 || live_qtable_init(live, &initial) != 0) {
+        printf("Error: Unable to allocate the Q-tables.\n");
+        return 1;
+    }
+    qtable_free(&initial);
+
+    // Non-terminal positions to serve moves for
+    Position positions[BENCH_POSITIONS];
+    Rng rng;
+    rng_seed(&rng, 1);
+    for (int i = 0; i < BENCH_POSITIONS; i++) {
+        Position pos = {0, 0};
+        int plies = (int)rng_below(&rng, (uint32_t)game.num_cells);
+        for (int ply = 0; ply < plies && game_outcome(&game, pos) == OUTCOME_ONGOING; ply++) {
+            uint64_t empty = position_empty(&game, pos);
+            position_make(&pos, position_side_to_move(pos), engine_select_cell(empty, (int)rng_below(&rng, (uint32_t)engine_popcount(empty))));
+        }
+        if (game_outcome(&game, pos) != OUTCOME_ONGOING)
+            pos = (Position){0, 0};
+        positions[i] = pos;
+    }
+
+    _Atomic int stop = 0;
+    pthread_t threads[MAX_READERS];
+    ReaderArgs args[MAX_READERS];
+    for (int r = 0; r < num_readers; r++) {
+        args[r] = (ReaderArgs){live, &game, positions, &stop, live_qtable_register_reader(live), 0, 0, 0};
+        if (pthread_create(&threads[r], NULL, reader_main, &args[r]) != 0) {
+            printf("Error: Unable to start reader %d.\n", r);
+            return 1;
+        }
+    }
+
+    // Writer: stamp a new version into every value, then publish it
+    double start = monotonic_seconds();
+    long deferred = 0;
+    float version = 0;
+    QTable* writer = live_qtable_writer(live);
+    while (monotonic_seconds() - start < seconds) {
+        version += 1;
+        for (size_t i = 0; i < qtable_num_values(writer); i++)
+            writer->values[i] = version;
+        deferred += live_qtable_publish(live);
+    }
+    atomic_store(&stop, 1);
+    double elapsed = monotonic_seconds() - start;
+
+    long moves = 0, torn = 0;
+    printf("%dx%d, %d readers, %.2fs\n", size, size, num_readers, elapsed);
+    printf("reader  moves/sec     versions seen  torn rows\n");
+    for (int r = 0; r < num_readers; r++) {
+        pthread_join(threads[r], NULL);
+        printf("%6d  %12.0f  %13ld  %9ld\n", r, args[r].moves / elapsed, args[r].versions_seen, args[r].torn);
+        moves += args[r].moves;
+        torn += args[r].torn;
+    }
+    printf("total   %12.0f moves/sec\n", moves / elapsed);
+    printf("publishes %llu (%ld deferred), snapshots reclaimed %llu, allocated %d\n", (unsigned long long)live->publishes,
+           deferred, (unsigned long long)live->reclaimed, live->num_snapshots);
+    printf("%s\n", torn == 0 ? "No torn reads." : "TORN READS SEEN.");
+    live_qtable_free(live);
+    free(live);
+    return torn == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include "live_qtable.h"
+
+static size_t table_bytes(const QTable* table) {
+    return qtable_num_values(table) * sizeof(float);
+}
+
+// Function to allocate a table shaped like shape, holding a copy of its values
+static int copy_table(QTable* table, const QTable* shape) {
+    if (shape->sparse != NULL || shape->mlp != NULL)
+        return -1; // sparse rows move as the table grows, and a network's rows are computed
+    *table = *shape;
+    table->dirty = NULL;
+    table->values = malloc(table_bytes(shape));
+    if (table->values == NULL)
+        return -1;
+    memcpy(table->values, shape->values, table_bytes(shape));
+    return 0;
+}
+
+int live_qtable_init(LiveQTable* live, const QTable* initial) {
+    memset(live, 0, sizeof(*live));
+    if (copy_table(&live->writer, initial) != 0)
+        return -1;
+    if (copy_table(&live->snapshots[0].table, initial) != 0) {
+        qtable_free(&live->writer);
+        return -1;
+    }
+    live->num_snapshots = 1;
+    atomic_store(&live->current, &live->snapshots[0]);
+    atomic_store(&live->epoch, 1); // 0 marks an idle reader
+    return 0;
+}
+
+void live_qtable_free(LiveQTable* live) {
+    for (int i = 0; i < live->num_snapshots; i++)
+        qtable_free(&live->snapshots[i].table);
+    qtable_free(&live->writer);
+}
+
+int live_qtable_register_reader(LiveQTable* live) {
+    for (int r = 0; r < LIVE_MAX_READERS; r++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&live->readers[r].in_use, &expected, 1)) {
+            atomic_store(&live->readers[r].epoch, 0);
+            return r;
+        }
+    }
+    return -1;
+}
+
+void live_qtable_unregister_reader(LiveQTable* live, int reader) {
+    atomic_store(&live->readers[reader].epoch, 0);
+    atomic_store(&live->readers[reader].in_use, 0);
+}
+
+// Function to turn retired snapshots back into spares once no reader can
+// still hold them. A reader announcing epoch e may hold any snapshot
+// retired at epoch e or later.
+static void reclaim(LiveQTable* live) {
+    uint64_t oldest = UINT64_MAX;
+    for (int r = 0; r < LIVE_MAX_READERS; r++) {
+        uint64_t epoch = atomic_load(&live->readers[r].epoch);
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+    for (int i = 0; i < live->num_snapshots; i++) {
+        LiveSnapshot* snapshot = &live->snapshots[i];
+        if (snapshot->retired_epoch != 0 && snapshot->retired_epoch < oldest) {
+            snapshot->retired_epoch = 0;
+            live->reclaimed++;
+        }
+    }
+}
+
+int live_qtable_publish(LiveQTable* live) {
+    reclaim(live);
+    LiveSnapshot* current = atomic_load(&live->current);
+    LiveSnapshot* next = NULL;
+    for (int i = 0; i < live->num_snapshots && next == NULL; i++) {
+        if (&live->snapshots[i] != current && live->snapshots[i].retired_epoch == 0)
+            next = &live->snapshots[i];
+    }
+    if (next == NULL) {
+        // Readers still hold every older snapshot: add one, if there is room
+        if (live->num_snapshots == LIVE_MAX_SNAPSHOTS || copy_table(&live->snapshots[live->num_snapshots].table, &live->writer) != 0)
+            return 1;
+        next = &live->snapshots[live->num_snapshots++];
+    } else {
+        memcpy(next->table.values, live->writer.values, table_bytes(&live->writer));
+    }
+
+    // Readers that announced an epoch up to the one the old snapshot retires
+    // at may still be using it
+    next->retired_epoch = 0;
+    LiveSnapshot* old = atomic_exchange(&live->current, next);
+    old->retired_epoch = atomic_fetch_add(&live->epoch, 1);
+    live->publishes++;
+    reclaim(live);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef LIVE_QTABLE_H
+#define LIVE_QTABLE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "qtable.h"
+
+#define LIVE_MAX_READERS 64
+#define LIVE_MAX_SNAPSHOTS 8 // published, retired and spare snapshots together
+
+// An immutable copy of the writer's table, as readers see it
+typedef struct {
+    QTable table;
+    uint64_t retired_epoch; // global epoch when it was replaced, 0 while current or spare
+} LiveSnapshot;
+
+// One reader's announcement, on its own cache line. epoch is 0 while the
+// reader holds no snapshot.
+typedef struct {
+    _Atomic uint64_t epoch;
+    _Atomic int in_use;
+} __attribute__((aligned(64))) LiveReader;
+
+// A Q-table that keeps learning while it serves moves (RCU style).
+//
+// Updates go into a table only the writer touches. live_qtable_publish
+// copies it into a fresh snapshot and swaps the readers' pointer to it.
+// Readers announce the global epoch, load the pointer, and clear the
+// announcement when done: an atomic store and a load, never a lock or a
+// wait. A replaced snapshot is reused once every reader that was active
+// at the swap has finished.
+//
+// There is one writer thread; any number of threads (up to
+// LIVE_MAX_READERS) may read.
+typedef struct {
+    _Atomic(LiveSnapshot*) current;
+    _Atomic uint64_t epoch;
+    LiveReader readers[LIVE_MAX_READERS];
+    QTable writer;
+    LiveSnapshot snapshots[LIVE_MAX_SNAPSHOTS];
+    int num_snapshots;
+    uint64_t publishes;
+    uint64_t reclaimed;
+} LiveQTable;
+
+// Start from a copy of initial (positional or state-indexed; the index is shared)
+int live_qtable_init(LiveQTable* live, const QTable* initial);
+void live_qtable_free(LiveQTable* live);
+
+// Reader slot for one thread, -1 if they are all taken
+int live_qtable_register_reader(LiveQTable* live);
+void live_qtable_unregister_reader(LiveQTable* live, int reader);
+
+// The table the writer updates; readers never see it directly
+static inline QTable* live_qtable_writer(LiveQTable* live) {
+    return &live->writer;
+}
+
+// Publish the writer's table to readers. Returns 0, or 1 if every snapshot
+// is still held by a reader and the publish has to wait for a later call.
+int live_qtable_publish(LiveQTable* live);
+
+// Pin the current snapshot. The table stays valid and unchanged until
+// live_qtable_read_end; readers must not keep it across that call.
+static inline const QTable* live_qtable_read_begin(LiveQTable* live, int reader) {
+    // The announcement must be visible before the pointer is read, or the
+    // writer could recycle a snapshot this reader is about to use
+    atomic_store(&live->readers[reader].epoch, atomic_load(&live->epoch));
+    return &atomic_load(&live->current)->table;
+}
+
+static inline void live_qtable_read_end(LiveQTable* live, int reader) {
+    atomic_store_explicit(&live->readers[reader].epoch, 0, memory_order_release);
+}
+
+#endif
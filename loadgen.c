@@ -0,0 +1,693 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include "engine.h"
+#include "latency.h"
+#include "mcts.h"
+#include "metrics.h"
+#include "model.h"
+#include "net.h"
+#include "policy.h"
+#include "qtable.h"
+#include "rng.h"
+#include "search.h"
+#include "state_index.h"
+#include "tablebase.h"
+#include "timer.h"
+
+#define LOADGEN_MAX_WORKERS 256
+#define LOADGEN_START_DELAY_NS 20000000 // lets every worker start before the first arrival
+
+// A game's worth of a scripted client's moves, one line of the script file
+typedef struct {
+    uint8_t cells[ENGINE_MAX_CELLS];
+    int length;
+} Script;
+
+// Everything the AI and the clients are built from
+typedef struct {
+    const Game* game;
+    PolicyKind kind;
+    const QTable* table;
+    const Tablebase* tablebase;
+    pthread_mutex_t* network_lock; // a network's scratch is not shared between threads
+    float epsilon;
+    long playouts;
+    uint64_t budget_ns;
+    int max_depth;
+    int table_mb;
+    uint64_t seed;
+    int num_clients;
+    int num_workers;
+    double rate;    // moves per second asked of the AI by all clients together
+    double seconds;
+    const Script* scripts; // NULL for random clients
+    int num_scripts;
+    const char* connect;   // server address, NULL to play in-process
+} LoadConfig;
+
+// One AI player with what it owns: a server connection's or an in-process worker's
+typedef struct {
+    Policy policy;
+    MctsTree tree;
+    bool has_tree;
+    SearchTable search_table;
+    bool has_search_table;
+    pthread_mutex_t* lock;
+} Ai;
+
+// Over the socket: a hello with the board, answered with 0 if the server
+// plays that board, then one position per request, answered with a cell
+// (-1 for none). Both ends are on this machine, so fields are native-endian.
+typedef struct {
+    int32_t size;
+    int32_t win_length;
+    int32_t layers;
+} Hello;
+
+typedef struct {
+    uint64_t due;       // monotonic ns its next request is scheduled for
+    Position board;
+    int side;           // the client's side, alternating game by game
+    int script;         // its script this game
+    Policy player;
+} Client;
+
+typedef struct {
+    const LoadConfig* config;
+    int index;
+    Client* clients;
+    int* heap;          // client numbers, the earliest due first
+    int num_clients;
+    Ai ai;
+    int fd;             // server connection, -1 in-process
+    Rng rng;            // gaps between a client's requests
+    uint64_t start;
+    uint64_t end;
+    // Results
+    uint64_t latency[LATENCY_BUCKETS]; // from the scheduled arrival to the answer
+    uint64_t service[LATENCY_BUCKETS]; // from sending the request to the answer
+    uint64_t latency_max;
+    uint64_t service_max;
+    uint64_t finished;  // monotonic ns of the last answer
+    long requests;
+    long errors;
+    long outcomes[3];   // AI wins, client wins, draws
+} Worker;
+
+static void usage(void) {
+    printf("Usage: loadgen <ai-player> [--clients N] [--rate R] [--seconds S] [--workers W] [--script file]\n");
+    printf("               [--connect address] [board and player options]\n");
+    printf("       loadgen serve <ai-player> <address> [board and player options]\n");
+    printf("Board and player options: [--size N] [--win-length K] [--layers L] [--model file] [--tablebase file]\n");
+    printf("                          [--epsilon E] [--playouts N] [--budget-us T] [--depth D] [--table-mb M] [--seed S]\n");
+    printf("An address is a port, host:port or unix:/path. R is moves per second from all clients together.\n");
+}
+
+// Function to set up an AI player of the configured kind
+static int ai_init(Ai* ai, const LoadConfig* config, uint64_t seed) {
+    memset(ai, 0, sizeof(*ai));
+    switch (config->kind) {
+    case POLICY_RANDOM:
+        policy_init_random(&ai->policy, seed);
+        return 0;
+    case POLICY_GREEDY:
+        policy_init_greedy(&ai->policy, config->table);
+        ai->lock = config->network_lock;
+        return 0;
+    case POLICY_EPSILON:
+        policy_init_qtable(&ai->policy, config->table, config->epsilon, seed);
+        ai->lock = config->network_lock;
+        return 0;
+    case POLICY_SCRIPTED:
+        policy_init_scripted(&ai->policy, NULL, 0);
+        return 0;
+    case POLICY_TABLEBASE:
+        policy_init_tablebase(&ai->policy, config->tablebase, seed);
+        return 0;
+    case POLICY_MCTS:
+        if (mcts_init(&ai->tree, config->game, 1u << 20, seed) != 0) {
+            printf("Error: Unable to allocate the MCTS arena.\n");
+            return -1;
+        }
+        ai->has_tree = true;
+        policy_init_mcts(&ai->policy, &ai->tree, config->playouts);
+        return 0;
+    case POLICY_SEARCH:
+        policy_init_search(&ai->policy, config->budget_ns, config->max_depth);
+        if (config->table_mb > 0) {
+            if (search_table_init(&ai->search_table, (size_t)config->table_mb << 20) != 0) {
+                printf("Error: Unable to allocate the transposition table.\n");
+                return -1;
+            }
+            ai->has_search_table = true;
+            ai->policy.limits.table = &ai->search_table;
+        }
+        return 0;
+    default:
+        printf("Error: The load generator plays the AI, not a human.\n");
+        return -1;
+    }
+}
+
+static void ai_free(Ai* ai) {
+    if (ai->has_tree)
+        mcts_free(&ai->tree);
+    if (ai->has_search_table)
+        search_table_free(&ai->search_table);
+}
+
+static int ai_move(Ai* ai, const Game* game, Position pos) {
+    if (ai->lock != NULL)
+        pthread_mutex_lock(ai->lock);
+    int cell = policy_choose_move(&ai->policy, game, pos);
+    if (ai->lock != NULL)
+        pthread_mutex_unlock(ai->lock);
+    return cell;
+}
+
+// Function to place side's stone and return the outcome, treating an
+// occupied or missing cell as the end of the game (OUTCOME_ONGOING is never
+// returned for it)
+static int play(const Game* game, Position* board, int side, int cell) {
+    if (cell < 0 || !(position_empty(game, *board) >> cell & 1))
+        return OUTCOME_DRAW;
+    position_make(board, side, cell);
+    if (game_move_wins(game, position_stones(*board, side), cell))
+        return side == 0 ? OUTCOME_X_WINS : OUTCOME_O_WINS;
+    return position_empty(game, *board) == 0 ? OUTCOME_DRAW : OUTCOME_ONGOING;
+}
+
+static void new_game(const LoadConfig* config, Client* client) {
+    client->board = (Position){0, 0};
+    client->side ^= 1;
+    if (config->scripts != NULL) {
+        client->script = (client->script + 1) % config->num_scripts;
+        policy_init_scripted(&client->player, config->scripts[client->script].cells, config->scripts[client->script].length);
+    }
+}
+
+static void finish_game(Worker* worker, Client* client, int outcome) {
+    if (outcome == OUTCOME_DRAW)
+        worker->outcomes[2]++;
+    else
+        worker->outcomes[(outcome == OUTCOME_X_WINS ? 0 : 1) == client->side]++;
+    if (metrics_enabled)
+        metrics_add_outcome(outcome, position_num_stones(client->board));
+    new_game(worker->config, client);
+}
+
+static void record(uint64_t counts[LATENCY_BUCKETS], uint64_t* max, uint64_t ns) {
+    counts[latency_bucket(ns)]++;
+    if (ns > *max)
+        *max = ns;
+}
+
+// Function to ask the AI for its move, in-process or over the connection.
+// Returns the cell, -1 for none, or -2 if the connection is lost.
+static int ask(Worker* worker, Position board) {
+    if (worker->fd < 0)
+        return ai_move(&worker->ai, worker->config->game, board);
+    int32_t cell;
+    if (net_send_all(worker->fd, &board, sizeof(board)) != 0 || net_receive_all(worker->fd, &cell, sizeof(cell)) != 0)
+        return -2;
+    return cell;
+}
+
+// Function to play one turn of a client: its own move (which takes no time)
+// when it has one, then exactly one request to the AI. Returns -1 if the
+// connection is lost.
+static int client_turn(Worker* worker, Client* client) {
+    const Game* game = worker->config->game;
+    for (;;) {
+        int side = position_side_to_move(client->board);
+        if (side == client->side) {
+            int outcome = play(game, &client->board, side, policy_dispatch_move(&client->player, game, client->board));
+            if (outcome != OUTCOME_ONGOING)
+                finish_game(worker, client, outcome);
+            continue;
+        }
+
+        uint64_t sent = monotonic_ns();
+        int cell = ask(worker, client->board);
+        uint64_t answered = monotonic_ns();
+        if (cell == -2)
+            return -1;
+        worker->requests++;
+        worker->finished = answered;
+        record(worker->latency, &worker->latency_max, answered - client->due);
+        record(worker->service, &worker->service_max, answered - sent);
+        if (cell < 0 || !(position_empty(game, client->board) >> cell & 1)) {
+            worker->errors++; // an illegal answer abandons the game
+            new_game(worker->config, client);
+            return 0;
+        }
+        int outcome = play(game, &client->board, side, cell);
+        if (outcome != OUTCOME_ONGOING)
+            finish_game(worker, client, outcome);
+        return 0;
+    }
+}
+
+// Function to draw the gap to a client's next request: exponential, so the
+// requests of all clients together arrive as a Poisson process
+static uint64_t next_gap(Worker* worker) {
+    double mean_ns = worker->config->num_clients / worker->config->rate * 1e9;
+    return (uint64_t)(-log(1.0 - rng_uniform(&worker->rng)) * mean_ns) + 1;
+}
+
+static void sift_down(Worker* worker, int i) {
+    int* heap = worker->heap;
+    for (;;) {
+        int smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < worker->num_clients && worker->clients[heap[left]].due < worker->clients[heap[smallest]].due)
+            smallest = left;
+        if (right < worker->num_clients && worker->clients[heap[right]].due < worker->clients[heap[smallest]].due)
+            smallest = right;
+        if (smallest == i)
+            return;
+        int swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+static void sleep_until(uint64_t ns) {
+    uint64_t now = monotonic_ns();
+    if (ns <= now)
+        return;
+    struct timespec delay = {(time_t)((ns - now) / 1000000000ULL), (long)((ns - now) % 1000000000ULL)};
+    nanosleep(&delay, NULL);
+}
+
+// Function to run one worker's clients: the earliest due request goes next,
+// as soon as its time comes. Arrivals are open-loop: a request's time is
+// fixed when it is scheduled, so when the AI falls behind its latency counts
+// the wait as well as the answer.
+static void* run_worker(void* arg) {
+    Worker* worker = arg;
+#ifdef __linux__
+    prctl(PR_SET_TIMERSLACK, 1UL); // wake on time rather than up to 50us late
+#endif
+    for (int i = 0; i < worker->num_clients; i++) {
+        worker->clients[i].due = worker->start + next_gap(worker);
+        worker->heap[i] = i;
+    }
+    for (int i = worker->num_clients / 2 - 1; i >= 0; i--)
+        sift_down(worker, i);
+
+    while (worker->num_clients > 0) {
+        Client* client = &worker->clients[worker->heap[0]];
+        if (client->due >= worker->end)
+            break;
+        sleep_until(client->due);
+        if (client_turn(worker, client) != 0) {
+            printf("Error: Lost the connection to %s.\n", worker->config->connect);
+            break;
+        }
+        client->due += next_gap(worker);
+        sift_down(worker, 0);
+    }
+    return NULL;
+}
+
+// Function to load a script file: one game per line, the client's cells
+// separated by spaces or commas
+static Script* load_scripts(const char* filename, const Game* game, int* count) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("Error: Unable to open %s.\n", filename);
+        return NULL;
+    }
+    Script* scripts = NULL;
+    int capacity = 0;
+    *count = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        Script script = {.length = 0};
+        for (char* token = strtok(line, " ,\t\r\n"); token != NULL && script.length < game->num_cells; token = strtok(NULL, " ,\t\r\n")) {
+            int cell = atoi(token);
+            if (cell < 0 || cell >= game->num_cells) {
+                printf("Error: Cell %d in %s is not on the board.\n", cell, filename);
+                free(scripts);
+                fclose(file);
+                return NULL;
+            }
+            script.cells[script.length++] = (uint8_t)cell;
+        }
+        if (script.length == 0)
+            continue;
+        if (*count == capacity) {
+            capacity = capacity > 0 ? 2 * capacity : 64;
+            Script* grown = realloc(scripts, (size_t)capacity * sizeof(Script));
+            if (grown == NULL) {
+                free(scripts);
+                fclose(file);
+                return NULL;
+            }
+            scripts = grown;
+        }
+        scripts[(*count)++] = script;
+    }
+    fclose(file);
+    if (*count == 0) {
+        printf("Error: %s holds no moves.\n", filename);
+        free(scripts);
+        return NULL;
+    }
+    return scripts;
+}
+
+// Function to print the percentiles of merged histograms
+static void print_percentiles(const char* name, const uint64_t counts[LATENCY_BUCKETS], uint64_t total, uint64_t max) {
+    static const double fractions[4] = {0.5, 0.9, 0.99, 0.999};
+    char text[5][16];
+    for (int p = 0; p < 4; p++)
+        latency_format(text[p], sizeof(text[p]), latency_percentile(counts, total, max, fractions[p]));
+    latency_format(text[4], sizeof(text[4]), max);
+    printf("%-8s %9s %9s %9s %9s %9s\n", name, text[0], text[1], text[2], text[3], text[4]);
+}
+
+// Function to run the clients against the AI and report what they saw
+static int generate_load(const LoadConfig* config) {
+    Worker* workers = calloc((size_t)config->num_workers, sizeof(Worker));
+    Client* clients = calloc((size_t)config->num_clients, sizeof(Client));
+    int* heap = malloc((size_t)config->num_clients * sizeof(int));
+    if (workers == NULL || clients == NULL || heap == NULL) {
+        printf("Error: Unable to allocate the clients.\n");
+        return 1;
+    }
+
+    // Clients are dealt out to the workers in turn; each client starts on
+    // its own script, and half of them play X first
+    uint64_t start = monotonic_ns() + LOADGEN_START_DELAY_NS;
+    int status = 0, first = 0;
+    for (int w = 0; w < config->num_workers && status == 0; w++) {
+        Worker* worker = &workers[w];
+        worker->config = config;
+        worker->index = w;
+        worker->clients = clients + first;
+        worker->heap = heap + first;
+        worker->num_clients = config->num_clients / config->num_workers + (w < config->num_clients % config->num_workers);
+        worker->fd = -1;
+        worker->start = start;
+        worker->end = start + (uint64_t)(config->seconds * 1e9);
+        rng_seed(&worker->rng, rng_mix(config->seed + (uint64_t)w));
+        for (int i = 0; i < worker->num_clients; i++) {
+            Client* client = &worker->clients[i];
+            client->side = (first + i) & 1;
+            client->script = (first + i) % (config->scripts != NULL ? config->num_scripts : 1) - 1;
+            policy_init_random(&client->player, rng_mix(config->seed + 1000003 * (uint64_t)(first + i + 1)));
+            new_game(config, client);
+        }
+        first += worker->num_clients;
+
+        if (config->connect == NULL) {
+            status = ai_init(&worker->ai, config, config->seed + (uint64_t)w + 1);
+            continue;
+        }
+        Hello hello = {config->game->size, config->game->win_length, config->game->layers};
+        int32_t accepted = -1;
+        if ((worker->fd = net_connect(config->connect)) < 0 || net_send_all(worker->fd, &hello, sizeof(hello)) != 0 ||
+            net_receive_all(worker->fd, &accepted, sizeof(accepted)) != 0 || accepted != 0) {
+            printf("Error: %s is not serving this board.\n", config->connect);
+            status = 1;
+        }
+    }
+
+    pthread_t threads[LOADGEN_MAX_WORKERS];
+    bool started[LOADGEN_MAX_WORKERS] = {false};
+    if (status == 0) {
+        for (int w = 1; w < config->num_workers; w++)
+            started[w] = pthread_create(&threads[w], NULL, run_worker, &workers[w]) == 0;
+        run_worker(&workers[0]);
+    }
+    for (int w = 1; w < config->num_workers; w++) {
+        if (started[w])
+            pthread_join(threads[w], NULL);
+    }
+
+    if (status == 0) {
+        uint64_t latency[LATENCY_BUCKETS] = {0}, service[LATENCY_BUCKETS] = {0};
+        uint64_t latency_max = 0, service_max = 0, finished = start;
+        long requests = 0, errors = 0, outcomes[3] = {0, 0, 0};
+        for (int w = 0; w < config->num_workers; w++) {
+            const Worker* worker = &workers[w];
+            for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                latency[b] += worker->latency[b];
+                service[b] += worker->service[b];
+            }
+            latency_max = worker->latency_max > latency_max ? worker->latency_max : latency_max;
+            service_max = worker->service_max > service_max ? worker->service_max : service_max;
+            finished = worker->finished > finished ? worker->finished : finished;
+            requests += worker->requests;
+            errors += worker->errors;
+            for (int i = 0; i < 3; i++)
+                outcomes[i] += worker->outcomes[i];
+        }
+        long games = outcomes[0] + outcomes[1] + outcomes[2];
+        double seconds = (finished - start) * 1e-9;
+        printf("%s AI vs %d %s clients on %dx%d, %d in a row, %s with %d worker%s\n", policy_kind_name(config->kind),
+               config->num_clients, config->scripts != NULL ? "scripted" : "random", config->game->size, config->game->size,
+               config->game->win_length, config->connect != NULL ? config->connect : "in-process", config->num_workers,
+               config->num_workers == 1 ? "" : "s");
+        printf("offered %.0f moves/sec for %.1f sec, achieved %.0f moves/sec (%ld moves, %ld errors)\n", config->rate,
+               config->seconds, seconds > 0 ? requests / seconds : 0.0, requests, errors);
+        if (requests > 0) {
+            printf("%-8s %9s %9s %9s %9s %9s\n", "", "p50", "p90", "p99", "p99.9", "max");
+            print_percentiles("latency", latency, (uint64_t)requests, latency_max);
+            print_percentiles("service", service, (uint64_t)requests, service_max);
+        }
+        if (games > 0)
+            printf("%ld games: AI wins %.3f  clients win %.3f  draws %.3f\n", games, (double)outcomes[0] / games,
+                   (double)outcomes[1] / games, (double)outcomes[2] / games);
+    }
+
+    for (int w = 0; w < config->num_workers; w++) {
+        if (workers[w].fd >= 0)
+            net_close(workers[w].fd);
+        ai_free(&workers[w].ai);
+    }
+    free(workers);
+    free(clients);
+    free(heap);
+    return status;
+}
+
+typedef struct {
+    const LoadConfig* config;
+    int fd;
+    uint64_t seed;
+} Connection;
+
+// Function to play the AI for one connection until the client hangs up
+static void* serve_connection(void* arg) {
+    Connection* connection = arg;
+    const Game* game = connection->config->game;
+    Hello hello;
+    int32_t accepted = -1;
+    Ai ai;
+    if (net_receive_all(connection->fd, &hello, sizeof(hello)) == 0 && hello.size == game->size &&
+        hello.win_length == game->win_length && hello.layers == game->layers && ai_init(&ai, connection->config, connection->seed) == 0) {
+        accepted = 0;
+        if (net_send_all(connection->fd, &accepted, sizeof(accepted)) == 0) {
+            Position board;
+            while (net_receive_all(connection->fd, &board, sizeof(board)) == 0) {
+                int32_t cell = -1;
+                int lead = engine_popcount(board.x) - engine_popcount(board.o);
+                if ((board.x & board.o) == 0 && ((board.x | board.o) & ~game->full_mask) == 0 && (lead == 0 || lead == 1) &&
+                    game_outcome(game, board) == OUTCOME_ONGOING)
+                    cell = ai_move(&ai, game, board);
+                if (net_send_all(connection->fd, &cell, sizeof(cell)) != 0)
+                    break;
+            }
+        }
+        ai_free(&ai);
+    } else {
+        net_send_all(connection->fd, &accepted, sizeof(accepted));
+    }
+    net_close(connection->fd);
+    free(connection);
+    return NULL;
+}
+
+// Function to serve the AI on address, a thread per connection, until killed
+static int serve(const LoadConfig* config, const char* address) {
+    int listener = net_listen(address, 128);
+    if (listener < 0) {
+        printf("Error: Unable to listen on %s.\n", address);
+        return 1;
+    }
+    printf("Serving the %s AI on %dx%d, %d in a row, at %s\n", policy_kind_name(config->kind), config->game->size,
+           config->game->size, config->game->win_length, address);
+    fflush(stdout);
+    for (uint64_t n = 0;; n++) {
+        int fd = net_accept(listener);
+        if (fd < 0) {
+            printf("Error: Unable to accept connections on %s.\n", address);
+            net_close(listener);
+            return 1;
+        }
+        Connection* connection = malloc(sizeof(Connection));
+        pthread_t thread;
+        if (connection == NULL) {
+            net_close(fd);
+            continue;
+        }
+        *connection = (Connection){config, fd, config->seed + n + 1};
+        if (pthread_create(&thread, NULL, serve_connection, connection) != 0) {
+            net_close(fd);
+            free(connection);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return 0;
+}
+
+// Drive the AI non-interactively with many simulated clients, each playing
+// random or scripted games and asking for the AI's reply at Poisson arrival
+// times, in-process or against a "loadgen serve" over a socket
+int main(int argc, char* argv[]) {
+    const char* model = "q_values.dat";
+    const char* tablebase_file = NULL;
+    const char* script_file = NULL;
+    const char* address = NULL;
+    const char* name = NULL;
+    bool serving = false;
+    int size = 3, win_length = 0, layers = 1;
+    LoadConfig config = {.epsilon = 0.1f, .playouts = 2000, .budget_ns = 5000000, .table_mb = SEARCH_TABLE_DEFAULT_MB,
+                         .seed = 1, .num_clients = 1000, .num_workers = 1, .rate = 1000, .seconds = 5};
+    latency_init_from_env();
+    metrics_init_from_env();
+    int i = 1;
+    if (argc > 1 && strcmp(argv[1], "serve") == 0) {
+        serving = true;
+        i = 2;
+    }
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--layers") == 0 && i + 1 < argc)
+            layers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--win-length") == 0 && i + 1 < argc)
+            win_length = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+            model = argv[++i];
+        else if (strcmp(argv[i], "--tablebase") == 0 && i + 1 < argc)
+            tablebase_file = argv[++i];
+        else if (strcmp(argv[i], "--epsilon") == 0 && i + 1 < argc)
+            config.epsilon = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--playouts") == 0 && i + 1 < argc)
+            config.playouts = atol(argv[++i]);
+        else if (strcmp(argv[i], "--budget-us") == 0 && i + 1 < argc)
+            config.budget_ns = (uint64_t)(atof(argv[++i]) * 1e3);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            config.max_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--table-mb") == 0 && i + 1 < argc)
+            config.table_mb = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            config.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+            config.num_clients = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            config.rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            config.seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            config.num_workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+            script_file = argv[++i];
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc)
+            config.connect = argv[++i];
+        else if (name == NULL && argv[i][0] != '-')
+            name = argv[i];
+        else if (serving && address == NULL && argv[i][0] != '-')
+            address = argv[i];
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (name == NULL || (serving && address == NULL) || config.num_clients < 1 || config.rate <= 0 ||
+        config.num_workers < 1 || config.num_workers > LOADGEN_MAX_WORKERS) {
+        usage();
+        return 1;
+    }
+    int kind = policy_kind_from_name(name);
+    if (kind < 0) {
+        printf("Error: Unknown player \"%s\".\n", name);
+        usage();
+        return 1;
+    }
+    config.kind = (PolicyKind)kind;
+    if (config.num_workers > config.num_clients)
+        config.num_workers = config.num_clients;
+
+    Game game;
+    if (game_init_variant(&game, size, win_length > 0 ? win_length : size, layers) != 0) {
+        printf("Error: Unsupported board %dx%d (%d layers) with %d in a row.\n", size, size, layers, win_length > 0 ? win_length : size);
+        return 1;
+    }
+    config.game = &game;
+
+    // The AI's shared, read-only resources are loaded once; a client needs
+    // none of them when the AI is across a socket
+    QTable table;
+    StateIndex index;
+    bool has_table = false, has_index = false;
+    Tablebase tablebase;
+    bool has_tablebase = false;
+    pthread_mutex_t network_lock = PTHREAD_MUTEX_INITIALIZER;
+    Script* scripts = NULL;
+    int status = 0;
+    if (config.connect == NULL && (config.kind == POLICY_GREEDY || config.kind == POLICY_EPSILON)) {
+        if (model_open_qtable(model, &game, &table, &index, &has_index) != 0)
+            status = 1;
+        has_table = status == 0;
+        config.table = &table;
+        if (has_table && table.mlp != NULL)
+            config.network_lock = &network_lock;
+    }
+    if (status == 0 && config.connect == NULL && config.kind == POLICY_TABLEBASE) {
+        char default_tablebase[64];
+        if (tablebase_file == NULL) {
+            snprintf(default_tablebase, sizeof(default_tablebase), "tablebase_%dx%d_%d.tb", game.size, game.size, game.win_length);
+            tablebase_file = default_tablebase;
+        }
+        if (tablebase_open(&tablebase, tablebase_file) != 0) {
+            status = 1;
+        } else {
+            has_tablebase = true;
+            config.tablebase = &tablebase;
+            if (tablebase.game.size != game.size || tablebase.game.win_length != game.win_length || tablebase.game.layers != game.layers) {
+                printf("Error: %s is not a tablebase for this board.\n", tablebase_file);
+                status = 1;
+            }
+        }
+    }
+    if (status == 0 && script_file != NULL) {
+        config.scripts = scripts = load_scripts(script_file, &game, &config.num_scripts);
+        if (scripts == NULL)
+            status = 1;
+    }
+
+    if (status == 0)
+        status = serving ? serve(&config, address) : generate_load(&config);
+
+    free(scripts);
+    if (has_tablebase)
+        tablebase_close(&tablebase);
+    if (has_table)
+        qtable_free(&table);
+    if (has_index)
+        state_index_free(&index);
+    return status;
+}
@@ -0,0 +1,75 @@
+#include "match.h"
+#include "latency.h"
+#include "metrics.h"
+#include "timer.h"
+
+typedef int (*MatchLoop)(const Game* game, Policy* x, Policy* o, Position* board, Trajectory* trajectory);
+
+// One game loop per (X kind, O kind), plus a copy that times every decision
+// for the latency histograms; timed is a constant, so the plain loops carry
+// no trace of it. The win test is incremental: only the lines through the
+// cell just played can have been completed.
+#define MATCH_LOOP_BODY(function, x_name, o_name, timed)                                                     \
+    static int function(const Game* game, Policy* x, Policy* o, Position* board, Trajectory* trajectory) {    \
+        Position pos = *board;                                                                               \
+        int outcome = game_outcome(game, pos);                                                               \
+        while (outcome == OUTCOME_ONGOING) {                                                                 \
+            int side = position_side_to_move(pos);                                                           \
+            uint64_t start = timed ? monotonic_ns() : 0;                                                     \
+            int cell = side == 0 ? policy_##x_name##_move(x, game, pos) : policy_##o_name##_move(o, game, pos); \
+            if (timed && (side == 0 ? x : o)->kind != POLICY_HUMAN)                                          \
+                latency_record((side == 0 ? x : o)->kind, game_slot(game), monotonic_ns() - start);              \
+            if (cell < 0)                                                                                    \
+                break;                                                                                       \
+            if (trajectory != NULL)                                                                          \
+                trajectory_record(trajectory, pos, side, cell);                                              \
+            position_make(&pos, side, cell);                                                                 \
+            if (game_move_wins(game, position_stones(pos, side), cell))                                      \
+                outcome = side == 0 ? OUTCOME_X_WINS : OUTCOME_O_WINS;                                       \
+            else if (position_empty(game, pos) == 0)                                                         \
+                outcome = OUTCOME_DRAW;                                                                      \
+        }                                                                                                    \
+        *board = pos;                                                                                        \
+        if (trajectory != NULL)                                                                              \
+            trajectory->outcome = outcome;                                                                   \
+        return outcome;                                                                                      \
+    }
+#define MATCH_LOOP(x_name, o_name)                                          \
+    MATCH_LOOP_BODY(match_##x_name##_##o_name, x_name, o_name, 0)          \
+    MATCH_LOOP_BODY(match_##x_name##_##o_name##_timed, x_name, o_name, 1)
+
+// POLICY_KINDS cannot expand inside itself, so the inner loop over O's kind
+// is spelled out once more, in the same order
+#define MATCH_FOR_EACH_O(M, x_name) \
+    M(x_name, human)                \
+    M(x_name, random)               \
+    M(x_name, greedy)               \
+    M(x_name, epsilon)              \
+    M(x_name, scripted)             \
+    M(x_name, tablebase)            \
+    M(x_name, mcts)                 \
+    M(x_name, search)
+
+#define MATCH_COUNT(x_name, o_name) +1
+_Static_assert(0 MATCH_FOR_EACH_O(MATCH_COUNT, human) == POLICY_NUM_KINDS, "MATCH_FOR_EACH_O is out of step with POLICY_KINDS");
+
+#define MATCH_LOOPS_FOR_X(KIND, x_name) MATCH_FOR_EACH_O(MATCH_LOOP, x_name)
+POLICY_KINDS(MATCH_LOOPS_FOR_X)
+
+#define MATCH_ENTRY(x_name, o_name) match_##x_name##_##o_name,
+#define MATCH_ROW(KIND, x_name) {MATCH_FOR_EACH_O(MATCH_ENTRY, x_name)},
+static const MatchLoop match_loops[POLICY_NUM_KINDS][POLICY_NUM_KINDS] = {POLICY_KINDS(MATCH_ROW)};
+
+#define MATCH_TIMED_ENTRY(x_name, o_name) match_##x_name##_##o_name##_timed,
+#define MATCH_TIMED_ROW(KIND, x_name) {MATCH_FOR_EACH_O(MATCH_TIMED_ENTRY, x_name)},
+static const MatchLoop match_timed_loops[POLICY_NUM_KINDS][POLICY_NUM_KINDS] = {POLICY_KINDS(MATCH_TIMED_ROW)};
+
+int match_play(const Game* game, Policy* x, Policy* o, Position* board, Trajectory* trajectory) {
+    int stones = __builtin_popcountll(board->x | board->o);
+    int outcome = latency_enabled ? match_timed_loops[x->kind][o->kind](game, x, o, board, trajectory)
+                                  : match_loops[x->kind][o->kind](game, x, o, board, trajectory);
+    // Counted once per game, from the stones the game added
+    if (metrics_enabled && outcome != OUTCOME_ONGOING)
+        metrics_add_outcome(outcome, __builtin_popcountll(board->x | board->o) - stones);
+    return outcome;
+}
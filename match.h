@@ -0,0 +1,16 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "engine.h"
+#include "policy.h"
+#include "trajectory.h"
+
+// Play from *board to the end of the game, x moving for X and o for O (they
+// may be the same policy). The loop is picked once per game from the pair of
+// kinds, and each loop calls its two policies directly, so nothing is
+// dispatched per ply. Moves go into trajectory unless it is NULL. Returns the
+// outcome, or OUTCOME_ONGOING if a player gave up; *board is left at the
+// final position.
+int match_play(const Game* game, Policy* x, Policy* o, Position* board, Trajectory* trajectory);
+
+#endif
@@ -0,0 +1,286 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mcts.h"
+#include "rng.h"
+#include "timer.h"
+
+// Playouts between two looks at the clock
+#define MCTS_CLOCK_INTERVAL 64
+
+typedef struct {
+    MctsTree* tree;
+    const MctsLimits* limits;
+    _Atomic long* playouts;
+    _Atomic int* stop;
+    double deadline;
+    uint64_t seed;
+} MctsWorker;
+
+static void init_node(MctsNode* node, int move) {
+    atomic_store_explicit(&node->visits, 0, memory_order_relaxed);
+    atomic_store_explicit(&node->score, 0, memory_order_relaxed);
+    atomic_store_explicit(&node->children, 0, memory_order_relaxed);
+    atomic_store_explicit(&node->state, MCTS_LEAF, memory_order_relaxed);
+    node->num_children = 0;
+    node->move = (uint8_t)move;
+}
+
+int mcts_init(MctsTree* tree, const Game* game, uint32_t capacity, uint64_t seed) {
+    tree->game = game;
+    tree->capacity = capacity;
+    tree->exploration = 1.4f;
+    tree->seed = seed;
+    tree->nodes = malloc((size_t)capacity * sizeof(MctsNode));
+    if (tree->nodes == NULL)
+        return -1;
+    Position empty = {0, 0};
+    mcts_reset(tree, empty);
+    return 0;
+}
+
+void mcts_free(MctsTree* tree) {
+    free(tree->nodes);
+    tree->nodes = NULL;
+}
+
+// Function to drop the whole tree and start again from pos
+void mcts_reset(MctsTree* tree, Position pos) {
+    atomic_store(&tree->used, 1);
+    tree->root = 0;
+    tree->root_pos = pos;
+    init_node(&tree->nodes[0], 0);
+}
+
+// Find the child of node reached by playing cell, or 0
+static uint32_t find_child(const MctsTree* tree, uint32_t node, int cell) {
+    const MctsNode* parent = &tree->nodes[node];
+    if (atomic_load(&parent->state) != MCTS_EXPANDED)
+        return 0;
+    uint32_t first = atomic_load(&parent->children);
+    for (int i = 0; i < parent->num_children; i++) {
+        if (tree->nodes[first + i].move == cell)
+            return first + i;
+    }
+    return 0;
+}
+
+// Move the root to pos, keeping the subtree already searched below it when pos
+// follows from the current root. Falls back to a fresh tree otherwise.
+void mcts_set_position(MctsTree* tree, Position pos) {
+    Position current = tree->root_pos;
+    uint32_t node = tree->root;
+    while (current.x != pos.x || current.o != pos.o) {
+        int side = position_side_to_move(current);
+        uint64_t added = position_stones(pos, side) & ~position_stones(current, side);
+        if ((current.x & ~pos.x) || (current.o & ~pos.o) || added == 0) {
+            mcts_reset(tree, pos);
+            return;
+        }
+        int cell = engine_lowest_cell(added);
+        node = find_child(tree, node, cell);
+        if (node == 0) {
+            mcts_reset(tree, pos);
+            return;
+        }
+        position_make(&current, side, cell);
+    }
+    tree->root = node;
+    tree->root_pos = pos;
+
+    // Reset instead of running out of nodes half way through a search
+    if (atomic_load(&tree->used) > tree->capacity / 2)
+        mcts_reset(tree, pos);
+}
+
+// Lock-free expansion: the thread that wins the CAS allocates and fills the
+// children, everyone else keeps playing out from the leaf until it is published.
+// Slots are only reserved when they fit, so a thread that finds the arena full
+// leaves nothing behind for the next reset to account for.
+static bool try_expand(MctsTree* tree, MctsNode* node, uint64_t empty) {
+    uint32_t count = (uint32_t)engine_popcount(empty);
+    uint32_t first = atomic_load_explicit(&tree->used, memory_order_relaxed);
+    if (first + count > tree->capacity)
+        return false;
+    uint8_t expected = MCTS_LEAF;
+    if (!atomic_compare_exchange_strong(&node->state, &expected, MCTS_EXPANDING))
+        return false;
+    do {
+        if (first + count > tree->capacity) {
+            atomic_store(&node->state, MCTS_LEAF);
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&tree->used, &first, first + count));
+    int i = 0;
+    for (uint64_t bits = empty; bits; bits &= bits - 1)
+        init_node(&tree->nodes[first + i++], engine_lowest_cell(bits));
+    node->num_children = (uint8_t)count;
+    atomic_store_explicit(&node->children, first, memory_order_relaxed);
+    atomic_store_explicit(&node->state, MCTS_EXPANDED, memory_order_release);
+    return true;
+}
+
+// UCT: best mean score plus exploration bonus, unvisited children first
+static uint32_t select_child(const MctsTree* tree, const MctsNode* node, Rng* rng) {
+    uint32_t first = atomic_load_explicit(&node->children, memory_order_relaxed);
+    float log_parent = logf((float)atomic_load_explicit(&node->visits, memory_order_relaxed) + 1.0f);
+    float best = -INFINITY;
+    uint32_t best_child = first;
+    int offset = (int)rng_below(rng, node->num_children);
+    for (int k = 0; k < node->num_children; k++) {
+        uint32_t child = first + (uint32_t)((k + offset) % node->num_children);
+        uint32_t visits = atomic_load_explicit(&tree->nodes[child].visits, memory_order_relaxed);
+        if (visits == 0)
+            return child;
+        float mean = (float)atomic_load_explicit(&tree->nodes[child].score, memory_order_relaxed) / (2.0f * visits);
+        float value = mean + tree->exploration * sqrtf(log_parent / visits);
+        if (value > best) {
+            best = value;
+            best_child = child;
+        }
+    }
+    return best_child;
+}
+
+// Random playout on bitboards; returns 0 if X wins, 1 if O wins, 2 for a draw
+static int rollout(const Game* game, Position pos, Rng* rng) {
+    int side = position_side_to_move(pos);
+    uint64_t empty = position_empty(game, pos);
+    while (empty) {
+        int cell = engine_select_cell(empty, (int)rng_below(rng, (uint32_t)engine_popcount(empty)));
+        position_make(&pos, side, cell);
+        empty &= ~(1ULL << cell);
+        if (game_move_wins(game, position_stones(pos, side), cell))
+            return side;
+        side ^= 1;
+    }
+    return 2;
+}
+
+// One selection / expansion / playout / backup pass
+static void run_playout(MctsTree* tree, Rng* rng) {
+    const Game* game = tree->game;
+    uint32_t path[ENGINE_MAX_CELLS + 1];
+    int depth = 0;
+    Position pos = tree->root_pos;
+    int root_side = position_side_to_move(pos);
+    int side = root_side;
+    int result = -1;
+
+    uint32_t node = tree->root;
+    path[depth++] = node;
+    atomic_fetch_add_explicit(&tree->nodes[node].visits, 1, memory_order_relaxed);
+    int outcome = game_outcome(game, pos);
+    if (outcome != OUTCOME_ONGOING)
+        result = outcome == OUTCOME_DRAW ? 2 : outcome - 1;
+
+    while (result < 0) {
+        MctsNode* current = &tree->nodes[node];
+        uint64_t empty = position_empty(game, pos);
+        if (atomic_load_explicit(&current->state, memory_order_acquire) != MCTS_EXPANDED) {
+            bool expand = depth == 1 || atomic_load_explicit(&current->visits, memory_order_relaxed) > 1;
+            if (!expand || !try_expand(tree, current, empty)) {
+                result = rollout(game, pos, rng);
+                break;
+            }
+        }
+
+        // Virtual loss: the visit is counted now, the score only at backup
+        node = select_child(tree, current, rng);
+        atomic_fetch_add_explicit(&tree->nodes[node].visits, 1, memory_order_relaxed);
+        path[depth++] = node;
+        int cell = tree->nodes[node].move;
+        position_make(&pos, side, cell);
+        if (game_move_wins(game, position_stones(pos, side), cell))
+            result = side;
+        else if (position_empty(game, pos) == 0)
+            result = 2;
+        side ^= 1;
+    }
+
+    for (int i = 1; i < depth; i++) {
+        int mover = root_side ^ ((i - 1) & 1);
+        uint32_t points = result == 2 ? 1 : (result == mover ? 2 : 0);
+        atomic_fetch_add_explicit(&tree->nodes[path[i]].score, points, memory_order_relaxed);
+    }
+}
+
+static void* search_worker(void* arg) {
+    MctsWorker* worker = arg;
+    Rng rng;
+    rng_seed(&rng, worker->seed);
+    long limit = worker->limits->playouts;
+    for (long n = 0; !atomic_load_explicit(worker->stop, memory_order_relaxed); n++) {
+        if (limit > 0 && atomic_fetch_add_explicit(worker->playouts, 1, memory_order_relaxed) >= limit) {
+            atomic_store(worker->stop, 1);
+            break;
+        }
+        run_playout(worker->tree, &rng);
+        if (limit <= 0)
+            atomic_fetch_add_explicit(worker->playouts, 1, memory_order_relaxed);
+        if (worker->deadline > 0 && n % MCTS_CLOCK_INTERVAL == 0 && monotonic_seconds() >= worker->deadline)
+            atomic_store(worker->stop, 1);
+    }
+    return NULL;
+}
+
+// Function to search from the root and return the most visited move
+int mcts_search(MctsTree* tree, const MctsLimits* limits, MctsStats* stats) {
+    int num_threads = limits->num_threads < 1 ? 1 : limits->num_threads;
+    if (num_threads > MCTS_MAX_THREADS)
+        num_threads = MCTS_MAX_THREADS;
+    if (stats != NULL)
+        *stats = (MctsStats){0, 0, 0, 0, -1};
+    if (limits->playouts <= 0 && limits->seconds <= 0)
+        return -1;
+
+    _Atomic long playouts = 0;
+    _Atomic int stop = 0;
+    double start = monotonic_seconds();
+    pthread_t threads[MCTS_MAX_THREADS];
+    MctsWorker workers[MCTS_MAX_THREADS];
+    bool started[MCTS_MAX_THREADS];
+    int failed = 0;
+    for (int t = 0; t < num_threads; t++) {
+        workers[t] = (MctsWorker){tree, limits, &playouts, &stop, limits->seconds > 0 ? start + limits->seconds : 0, rng_mix(tree->seed + (uint64_t)t)};
+        started[t] = t > 0 && pthread_create(&threads[t], NULL, search_worker, &workers[t]) == 0;
+        failed += t > 0 && !started[t];
+    }
+    // Workers share the budget, so the caller's own worker plays the missing
+    // threads' playouts; the search is only slower, not shorter
+    if (failed > 0)
+        printf("Error: Unable to start %d of %d search threads.\n", failed, num_threads - 1);
+    search_worker(&workers[0]);
+    for (int t = 1; t < num_threads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+    tree->seed = rng_mix(tree->seed);
+
+    int best_move = -1;
+    uint32_t best_visits = 0;
+    const MctsNode* root = &tree->nodes[tree->root];
+    if (atomic_load(&root->state) == MCTS_EXPANDED) {
+        uint32_t first = atomic_load(&root->children);
+        for (int i = 0; i < root->num_children; i++) {
+            uint32_t visits = atomic_load(&tree->nodes[first + i].visits);
+            if (best_move < 0 || visits > best_visits) {
+                best_visits = visits;
+                best_move = tree->nodes[first + i].move;
+            }
+        }
+    }
+
+    if (stats != NULL) {
+        long total = atomic_load(&playouts);
+        if (limits->playouts > 0 && total > limits->playouts)
+            total = limits->playouts;
+        stats->playouts = total;
+        stats->seconds = monotonic_seconds() - start;
+        stats->playouts_per_second = stats->seconds > 0 ? total / stats->seconds : 0;
+        stats->nodes_used = atomic_load(&tree->used);
+        stats->best_move = best_move;
+    }
+    return best_move;
+}
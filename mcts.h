@@ -0,0 +1,57 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "engine.h"
+
+#define MCTS_MAX_THREADS 64
+
+// A tree node. visits counts playouts in flight too (virtual loss), score is
+// in half points (win 2, draw 1, loss 0) for the player who moved into the node.
+typedef struct {
+    _Atomic uint32_t visits;
+    _Atomic uint32_t score;
+    _Atomic uint32_t children;  // arena index of the first child
+    _Atomic uint8_t state;      // MCTS_LEAF, MCTS_EXPANDING or MCTS_EXPANDED
+    uint8_t num_children;
+    uint8_t move;               // cell played to reach this node
+} MctsNode;
+
+enum { MCTS_LEAF, MCTS_EXPANDING, MCTS_EXPANDED };
+
+// Nodes come from one preallocated arena. The subtree under the played move
+// is kept between moves; the arena is only reset when it runs low.
+typedef struct {
+    const Game* game;
+    MctsNode* nodes;
+    uint32_t capacity;
+    _Atomic uint32_t used;
+    uint32_t root;
+    Position root_pos;
+    float exploration;
+    uint64_t seed;
+} MctsTree;
+
+// Search budget: stop at whichever limit is hit first (0 = no limit)
+typedef struct {
+    long playouts;
+    double seconds;
+    int num_threads;
+} MctsLimits;
+
+typedef struct {
+    long playouts;
+    double seconds;
+    double playouts_per_second;
+    uint32_t nodes_used;
+    int best_move;
+} MctsStats;
+
+int mcts_init(MctsTree* tree, const Game* game, uint32_t capacity, uint64_t seed);
+void mcts_free(MctsTree* tree);
+void mcts_reset(MctsTree* tree, Position pos);
+void mcts_set_position(MctsTree* tree, Position pos);
+int mcts_search(MctsTree* tree, const MctsLimits* limits, MctsStats* stats);
+
+#endif
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "engine.h"
+#include "mcts.h"
+
+// Benchmark the MCTS engine: playouts/sec from the empty board for 1, 2, 4, ... threads
+// Usage: mcts_bench [size] [win_length] [max_threads] [seconds]
+int main(int argc, char* argv[]) {
+    int size = argc > 1 ? atoi(argv[1]) : 5;
+    int win_length = argc > 2 ? atoi(argv[2]) : 4;
+    int max_threads = argc > 3 ? atoi(argv[3]) : 4;
+    double seconds = argc > 4 ? atof(argv[4]) : 1.0;
+
+    Game game;
+    if (game_init(&game, size, win_length) != 0) {
+        printf("Error: Unsupported board %dx%d with %d in a row.\n", size, size, win_length);
+        return 1;
+    }
+    MctsTree tree;
+    if (mcts_init(&tree, &game, 1u << 22, 1) != 0) {
+        printf("Error: Unable to allocate the MCTS arena.\n");
+        return 1;
+    }
+
+    printf("%dx%d, %d in a row, %.2fs per run\n", size, size, win_length, seconds);
+    printf("threads  playouts   playouts/sec  speedup  nodes     best move\n");
+    double single = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        Position empty = {0, 0};
+        mcts_reset(&tree, empty);
+        MctsLimits limits = {0, seconds, threads};
+        MctsStats stats;
+        mcts_search(&tree, &limits, &stats);
+        if (threads == 1)
+            single = stats.playouts_per_second;
+        printf("%7d  %9ld  %13.0f  %7.2f  %8u  (%d, %d)\n", threads, stats.playouts, stats.playouts_per_second,
+               single > 0 ? stats.playouts_per_second / single : 0, stats.nodes_used,
+               stats.best_move / size, stats.best_move % size);
+    }
+
+    mcts_free(&tree);
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "metrics.h"
+#include "net.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#define METRICS_REQUEST_SIZE 1024
+
+bool metrics_enabled = false;
+__thread MetricsShard* metrics_local;
+// Threads push their shard here and never remove it, so the counts of
+// threads that have finished still add up
+static _Atomic(MetricsShard*) shards;
+static _Atomic uint64_t gauges[METRICS_NUM_GAUGES]; // doubles, as bits
+static uint64_t start_ns;
+
+#define METRICS_COUNTER_INFO(id, name, help) {name, help},
+static const struct {
+    const char* name;
+    const char* help;
+} counter_info[METRICS_NUM_COUNTERS] = {METRICS_COUNTERS(METRICS_COUNTER_INFO)},
+  gauge_info[METRICS_NUM_GAUGES] = {METRICS_GAUGES(METRICS_COUNTER_INFO)};
+#undef METRICS_COUNTER_INFO
+
+#define METRICS_PHASE_NAME(id, name) name,
+static const char* const phase_names[METRICS_NUM_PHASES] = {METRICS_PHASES(METRICS_PHASE_NAME)};
+#undef METRICS_PHASE_NAME
+
+MetricsShard* metrics_register_thread(void) {
+    MetricsShard* shard = calloc(1, sizeof(MetricsShard));
+    if (shard == NULL)
+        return NULL;
+    shard->next = atomic_load(&shards);
+    while (!atomic_compare_exchange_weak(&shards, &shard->next, shard))
+        ;
+    metrics_local = shard;
+    return shard;
+}
+
+void metrics_set(MetricGauge gauge, double value) {
+    if (!metrics_enabled)
+        return;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    atomic_store_explicit(&gauges[gauge], bits, memory_order_relaxed);
+}
+
+void metrics_add_outcome(int outcome, int plies) {
+    if (!metrics_enabled)
+        return;
+    metrics_add_slot(METRIC_EPISODES, 1);
+    metrics_add_slot(METRIC_PLIES, (uint64_t)plies);
+    metrics_add_slot(outcome == OUTCOME_X_WINS ? METRIC_X_WINS : outcome == OUTCOME_O_WINS ? METRIC_O_WINS : METRIC_DRAWS, 1);
+}
+
+// Function to add up one counter over every thread
+static uint64_t merge(int slot) {
+    uint64_t total = 0;
+    for (MetricsShard* shard = atomic_load(&shards); shard != NULL; shard = shard->next)
+        total += atomic_load_explicit(&shard->counters[slot], memory_order_relaxed);
+    return total;
+}
+
+// Function to read the resident set size, 0 where it is not available
+static uint64_t resident_bytes(void) {
+#ifdef __linux__
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file != NULL) {
+        unsigned long long pages, resident;
+        int found = fscanf(file, "%llu %llu", &pages, &resident);
+        fclose(file);
+        if (found == 2)
+            return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+void metrics_write(FILE* out) {
+    // Rates are averaged since the previous scrape (or the start, for the first)
+    static uint64_t last_ns, last_episodes, last_plies;
+    uint64_t now = monotonic_ns();
+    uint64_t totals[METRICS_NUM_COUNTERS];
+    for (int c = 0; c < METRICS_NUM_COUNTERS; c++) {
+        totals[c] = merge(c);
+        fprintf(out, "# HELP tictactoe_%s %s.\n# TYPE tictactoe_%s counter\ntictactoe_%s %llu\n", counter_info[c].name,
+                counter_info[c].help, counter_info[c].name, counter_info[c].name, (unsigned long long)totals[c]);
+    }
+
+    if (last_ns == 0)
+        last_ns = start_ns;
+    double seconds = now > last_ns ? (now - last_ns) / 1e9 : 0;
+    fprintf(out, "# HELP tictactoe_episodes_per_second Games finished per second since the last scrape.\n"
+                 "# TYPE tictactoe_episodes_per_second gauge\ntictactoe_episodes_per_second %.3f\n",
+            seconds > 0 ? (totals[METRIC_EPISODES] - last_episodes) / seconds : 0.0);
+    fprintf(out, "# HELP tictactoe_plies_per_second Moves played per second since the last scrape.\n"
+                 "# TYPE tictactoe_plies_per_second gauge\ntictactoe_plies_per_second %.3f\n",
+            seconds > 0 ? (totals[METRIC_PLIES] - last_plies) / seconds : 0.0);
+    last_ns = now;
+    last_episodes = totals[METRIC_EPISODES];
+    last_plies = totals[METRIC_PLIES];
+
+    uint64_t finished = totals[METRIC_EPISODES] > 0 ? totals[METRIC_EPISODES] : 1;
+    fprintf(out, "# HELP tictactoe_outcome_ratio Share of all games finished with each outcome.\n"
+                 "# TYPE tictactoe_outcome_ratio gauge\n");
+    fprintf(out, "tictactoe_outcome_ratio{outcome=\"x_win\"} %.6f\n", (double)totals[METRIC_X_WINS] / finished);
+    fprintf(out, "tictactoe_outcome_ratio{outcome=\"o_win\"} %.6f\n", (double)totals[METRIC_O_WINS] / finished);
+    fprintf(out, "tictactoe_outcome_ratio{outcome=\"draw\"} %.6f\n", (double)totals[METRIC_DRAWS] / finished);
+
+    fprintf(out, "# HELP tictactoe_phase_seconds_total Time spent in each phase of the run.\n"
+                 "# TYPE tictactoe_phase_seconds_total counter\n");
+    for (int p = 0; p < METRICS_NUM_PHASES; p++)
+        fprintf(out, "tictactoe_phase_seconds_total{phase=\"%s\"} %.6f\n", phase_names[p],
+                merge(METRICS_NUM_COUNTERS + p) / 1e9);
+
+    for (int g = 0; g < METRICS_NUM_GAUGES; g++) {
+        uint64_t bits = atomic_load_explicit(&gauges[g], memory_order_relaxed);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        fprintf(out, "# HELP tictactoe_%s %s.\n# TYPE tictactoe_%s gauge\ntictactoe_%s %g\n", gauge_info[g].name,
+                gauge_info[g].help, gauge_info[g].name, gauge_info[g].name, value);
+    }
+
+    fprintf(out, "# HELP process_resident_memory_bytes Resident memory size in bytes.\n"
+                 "# TYPE process_resident_memory_bytes gauge\nprocess_resident_memory_bytes %llu\n",
+            (unsigned long long)resident_bytes());
+    fprintf(out, "# HELP process_uptime_seconds Time since metrics were enabled.\n"
+                 "# TYPE process_uptime_seconds gauge\nprocess_uptime_seconds %.3f\n",
+            (now - start_ns) / 1e9);
+}
+
+#ifndef _WIN32
+
+// Function to answer one HTTP request: GET /metrics, anything else is a 404
+static void serve_client(int fd) {
+    struct timeval timeout = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char request[METRICS_REQUEST_SIZE];
+    size_t length = 0;
+    // The request line and headers end with an empty line
+    while (length < sizeof(request) - 1) {
+        ssize_t got = recv(fd, request + length, sizeof(request) - 1 - length, 0);
+        if (got <= 0)
+            break;
+        length += (size_t)got;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL)
+            break;
+    }
+    request[length] = '\0';
+
+    char* body = NULL;
+    size_t body_size = 0;
+    bool found = strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET /metrics?", 13) == 0;
+    if (found) {
+        FILE* out = open_memstream(&body, &body_size);
+        if (out == NULL)
+            return;
+        metrics_write(out);
+        fclose(out);
+    }
+    char header[256];
+    int header_size = found ? snprintf(header, sizeof(header),
+                                       "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                       "Content-Length: %zu\r\nConnection: close\r\n\r\n", body_size)
+                            : snprintf(header, sizeof(header),
+                                       "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n"
+                                       "Content-Length: 10\r\nConnection: close\r\n\r\nNot found\n");
+    if (net_send_all(fd, header, (size_t)header_size) == 0 && body != NULL)
+        net_send_all(fd, body, body_size);
+    free(body);
+}
+
+// Scrapes are rare, so one thread takes them one at a time; the trainers
+// never wait on it. The thread stops if the listener breaks.
+static void* serve(void* arg) {
+    int listener = (int)(intptr_t)arg;
+    for (;;) {
+        int fd = net_accept(listener);
+        if (fd < 0)
+            break;
+        serve_client(fd);
+        close(fd);
+    }
+    fprintf(stderr, "Error: The metrics server stopped accepting connections.\n");
+    close(listener);
+    return NULL;
+}
+
+void metrics_init_from_env(void) {
+    const char* setting = getenv("TICTACTOE_METRICS");
+    if (setting == NULL || setting[0] == '\0' || strcmp(setting, "0") == 0)
+        return;
+    int listener = net_listen(setting, 8);
+    if (listener < 0) {
+        fprintf(stderr, "Error: Unable to serve metrics on %s.\n", setting);
+        return;
+    }
+    start_ns = monotonic_ns();
+    metrics_enabled = true;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, serve, (void*)(intptr_t)listener) != 0) {
+        fprintf(stderr, "Error: Unable to start the metrics server.\n");
+        metrics_enabled = false;
+        close(listener);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+#else
+
+void metrics_init_from_env(void) {
+    const char* setting = getenv("TICTACTOE_METRICS");
+    if (setting != NULL && setting[0] != '\0' && strcmp(setting, "0") != 0)
+        fprintf(stderr, "Error: The metrics server is not supported on this platform.\n");
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "timer.h"
+
+// Counters: name (after "tictactoe_"), help text
+#define METRICS_COUNTERS(X)                                   \
+    X(EPISODES, "episodes_total", "Games played to the end")  \
+    X(PLIES, "plies_total", "Moves played")                   \
+    X(X_WINS, "x_wins_total", "Games won by X")               \
+    X(O_WINS, "o_wins_total", "Games won by O")               \
+    X(DRAWS, "draws_total", "Games drawn")
+
+// Time spent per phase of a run, exported as one labelled counter
+#define METRICS_PHASES(X) \
+    X(PLAY, "play")       \
+    X(LEARN, "learn")     \
+    X(EVALUATE, "evaluate") \
+    X(CHECKPOINT, "checkpoint")
+
+// Gauges: the latest value set by any thread
+#define METRICS_GAUGES(X)                                                                      \
+    X(EPSILON, "epsilon", "Exploration rate of the learners")                                  \
+    X(Q_DELTA, "q_delta", "Norm of the last generation's Q-value changes")                      \
+    X(EVAL_WIN_RATE, "eval_win_rate", "Win rate of the last evaluation against random play")    \
+    X(EVAL_DRAW_RATE, "eval_draw_rate", "Draw rate of the last evaluation against random play") \
+    X(EVAL_LOSS_RATE, "eval_loss_rate", "Loss rate of the last evaluation against random play") \
+    X(TABLE_BYTES, "table_bytes", "Memory held by the sparse Q-tables")                      \
+    X(TABLE_EVICTED, "table_evicted", "Rows the sparse Q-tables have evicted to stay under their cap")
+
+#define METRICS_ENUM(id, ...) METRIC_##id,
+typedef enum { METRICS_COUNTERS(METRICS_ENUM) METRICS_NUM_COUNTERS } MetricCounter;
+typedef enum { METRICS_PHASES(METRICS_ENUM) METRICS_NUM_PHASES } MetricPhase;
+typedef enum { METRICS_GAUGES(METRICS_ENUM) METRICS_NUM_GAUGES } MetricGauge;
+#undef METRICS_ENUM
+
+// One thread's counters (phase times in ns after the plain counters). Only
+// that thread writes them; a scrape adds up every thread's.
+typedef struct MetricsShard {
+    struct MetricsShard* next;
+    _Atomic uint64_t counters[METRICS_NUM_COUNTERS + METRICS_NUM_PHASES];
+} MetricsShard;
+
+// Set by metrics_init_from_env; while false every call below returns at once
+extern bool metrics_enabled;
+extern __thread MetricsShard* metrics_local;
+
+MetricsShard* metrics_register_thread(void);
+void metrics_set(MetricGauge gauge, double value);
+
+static inline void metrics_add_slot(int slot, uint64_t amount) {
+    MetricsShard* shard = metrics_local != NULL ? metrics_local : metrics_register_thread();
+    if (shard == NULL)
+        return;
+    // The owning thread is the only writer, so no read-modify-write is needed
+    _Atomic uint64_t* counter = &shard->counters[slot];
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+static inline void metrics_add(MetricCounter counter, uint64_t amount) {
+    if (metrics_enabled)
+        metrics_add_slot(counter, amount);
+}
+
+// Count a finished game by its outcome (OUTCOME_X_WINS, OUTCOME_O_WINS or OUTCOME_DRAW)
+void metrics_add_outcome(int outcome, int plies);
+
+// Time a phase: start = metrics_phase_begin(); ...; metrics_phase_end(phase, start)
+static inline uint64_t metrics_phase_begin(void) {
+    return metrics_enabled ? monotonic_ns() : 0;
+}
+
+static inline void metrics_phase_end(MetricPhase phase, uint64_t start) {
+    if (metrics_enabled)
+        metrics_add_slot(METRICS_NUM_COUNTERS + phase, monotonic_ns() - start);
+}
+
+// Write every metric in the Prometheus text format
+void metrics_write(FILE* out);
+
+// Serve the metrics if TICTACTOE_METRICS is set: a port ("9100"), a host
+// and port ("0.0.0.0:9100", the default host is 127.0.0.1) or
+// "unix:/path/to/socket". GET /metrics answers with metrics_write.
+void metrics_init_from_env(void);
+
+#endif
@@ -0,0 +1,306 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mlp.h"
+#include "rng.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MLP_X86 1
+#include <immintrin.h>
+#endif
+
+// The vector work of a pass. Hidden-sized vectors are a multiple of
+// MLP_LANES long; axpy takes any length.
+typedef struct {
+    const char* name;
+    void (*add)(float* y, const float* x, int n);                                      // y += x
+    void (*relu)(float* x, int n);                                                     // x = max(x, 0)
+    float (*dot)(const float* x, const float* y, int n);
+    void (*relu_gradient)(float* out, float scale, const float* w, const float* h, int n); // out = h > 0 ? scale * w : 0
+    void (*axpy)(float* y, float a, const float* x, size_t n);                         // y += a * x
+} MlpKernels;
+
+static void add_scalar(float* y, const float* x, int n) {
+    for (int i = 0; i < n; i++)
+        y[i] += x[i];
+}
+
+static void relu_scalar(float* x, int n) {
+    for (int i = 0; i < n; i++)
+        x[i] = x[i] > 0 ? x[i] : 0;
+}
+
+static float dot_scalar(const float* x, const float* y, int n) {
+    float sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += x[i] * y[i];
+    return sum;
+}
+
+static void relu_gradient_scalar(float* out, float scale, const float* w, const float* h, int n) {
+    for (int i = 0; i < n; i++)
+        out[i] = h[i] > 0 ? scale * w[i] : 0;
+}
+
+static void axpy_scalar(float* y, float a, const float* x, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        y[i] += a * x[i];
+}
+
+static const MlpKernels scalar_kernels = {"scalar", add_scalar, relu_scalar, dot_scalar, relu_gradient_scalar, axpy_scalar};
+
+#ifdef MLP_X86
+
+#define AVX2 __attribute__((target("avx2,fma")))
+
+AVX2 static void add_avx2(float* y, const float* x, int n) {
+    for (int i = 0; i < n; i += 8)
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(x + i)));
+}
+
+AVX2 static void relu_avx2(float* x, int n) {
+    const __m256 zero = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 8)
+        _mm256_storeu_ps(x + i, _mm256_max_ps(_mm256_loadu_ps(x + i), zero));
+}
+
+AVX2 static float dot_avx2(const float* x, const float* y, int n) {
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), sum1);
+    }
+    __m256 sum = _mm256_add_ps(sum0, sum1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+
+AVX2 static void relu_gradient_avx2(float* out, float scale, const float* w, const float* h, int n) {
+    const __m256 zero = _mm256_setzero_ps(), factor = _mm256_set1_ps(scale);
+    for (int i = 0; i < n; i += 8) {
+        __m256 active = _mm256_cmp_ps(_mm256_loadu_ps(h + i), zero, _CMP_GT_OQ);
+        _mm256_storeu_ps(out + i, _mm256_and_ps(active, _mm256_mul_ps(factor, _mm256_loadu_ps(w + i))));
+    }
+}
+
+AVX2 static void axpy_avx2(float* y, float a, const float* x, size_t n) {
+    const __m256 factor = _mm256_set1_ps(a);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(factor, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    for (; i < n; i++)
+        y[i] += a * x[i];
+}
+
+static const MlpKernels avx2_kernels = {"avx2", add_avx2, relu_avx2, dot_avx2, relu_gradient_avx2, axpy_avx2};
+
+#define AVX512 __attribute__((target("avx512f")))
+
+AVX512 static void add_avx512(float* y, const float* x, int n) {
+    for (int i = 0; i < n; i += 16)
+        _mm512_storeu_ps(y + i, _mm512_add_ps(_mm512_loadu_ps(y + i), _mm512_loadu_ps(x + i)));
+}
+
+AVX512 static void relu_avx512(float* x, int n) {
+    const __m512 zero = _mm512_setzero_ps();
+    for (int i = 0; i < n; i += 16)
+        _mm512_storeu_ps(x + i, _mm512_max_ps(_mm512_loadu_ps(x + i), zero));
+}
+
+AVX512 static float dot_avx512(const float* x, const float* y, int n) {
+    __m512 sum = _mm512_setzero_ps();
+    for (int i = 0; i < n; i += 16)
+        sum = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), sum);
+    return _mm512_reduce_add_ps(sum);
+}
+
+AVX512 static void relu_gradient_avx512(float* out, float scale, const float* w, const float* h, int n) {
+    const __m512 zero = _mm512_setzero_ps(), factor = _mm512_set1_ps(scale);
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 active = _mm512_cmp_ps_mask(_mm512_loadu_ps(h + i), zero, _CMP_GT_OQ);
+        _mm512_storeu_ps(out + i, _mm512_maskz_mul_ps(active, factor, _mm512_loadu_ps(w + i)));
+    }
+}
+
+AVX512 static void axpy_avx512(float* y, float a, const float* x, size_t n) {
+    const __m512 factor = _mm512_set1_ps(a);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(factor, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+    if (i < n) {
+        __mmask16 tail = (__mmask16)((1u << (n - i)) - 1);
+        __m512 updated = _mm512_fmadd_ps(factor, _mm512_maskz_loadu_ps(tail, x + i), _mm512_maskz_loadu_ps(tail, y + i));
+        _mm512_mask_storeu_ps(y + i, tail, updated);
+    }
+}
+
+static const MlpKernels avx512_kernels = {"avx512", add_avx512, relu_avx512, dot_avx512, relu_gradient_avx512, axpy_avx512};
+
+#endif
+
+static const MlpKernels* kernels = &scalar_kernels;
+static pthread_once_t kernels_picked = PTHREAD_ONCE_INIT;
+
+static bool kernels_supported(const MlpKernels* candidate) {
+#ifdef MLP_X86
+    __builtin_cpu_init();
+    if (candidate == &avx2_kernels)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (candidate == &avx512_kernels)
+        return __builtin_cpu_supports("avx512f");
+#endif
+    return candidate == &scalar_kernels;
+}
+
+// Function to pick the widest kernels the CPU runs
+static void pick_kernels(void) {
+#ifdef MLP_X86
+    if (kernels_supported(&avx512_kernels))
+        kernels = &avx512_kernels;
+    else if (kernels_supported(&avx2_kernels))
+        kernels = &avx2_kernels;
+#endif
+}
+
+const char* mlp_kernels_name(void) {
+    pthread_once(&kernels_picked, pick_kernels);
+    return kernels->name;
+}
+
+int mlp_use_kernels(const char* name) {
+    static const MlpKernels* const all[] = {
+        &scalar_kernels,
+#ifdef MLP_X86
+        &avx2_kernels,
+        &avx512_kernels,
+#endif
+    };
+    pthread_once(&kernels_picked, pick_kernels);
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (strcmp(all[i]->name, name) == 0 && kernels_supported(all[i])) {
+            kernels = all[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static size_t num_weights(int num_cells, int hidden) {
+    return (size_t)hidden * (3 * (size_t)num_cells + 1) + (size_t)num_cells;
+}
+
+int mlp_hidden_units(uint64_t weights, int num_cells) {
+    if (num_cells < 1 || weights <= (uint64_t)num_cells || (weights - num_cells) % (3 * (uint64_t)num_cells + 1) != 0)
+        return 0;
+    uint64_t hidden = (weights - num_cells) / (3 * (uint64_t)num_cells + 1);
+    return hidden % MLP_LANES == 0 && hidden <= 1 << 16 ? (int)hidden : 0;
+}
+
+int mlp_init(Mlp* mlp, int num_cells, int hidden, uint64_t seed) {
+    pthread_once(&kernels_picked, pick_kernels);
+    memset(mlp, 0, sizeof(*mlp));
+    if (hidden < 1)
+        hidden = MLP_DEFAULT_HIDDEN;
+    hidden = (hidden + MLP_LANES - 1) / MLP_LANES * MLP_LANES;
+    mlp->num_cells = num_cells;
+    mlp->hidden = hidden;
+    mlp->num_weights = num_weights(num_cells, hidden);
+    mlp->weights = malloc(mlp->num_weights * sizeof(float));
+    mlp->gradients = calloc(mlp->num_weights, sizeof(float));
+    mlp->activations = malloc((size_t)MLP_MAX_BATCH * hidden * sizeof(float));
+    mlp->outputs = malloc((size_t)MLP_MAX_BATCH * num_cells * sizeof(float));
+    mlp->hidden_gradient = malloc((size_t)hidden * sizeof(float));
+    if (mlp->weights == NULL || mlp->gradients == NULL || mlp->activations == NULL || mlp->outputs == NULL ||
+        mlp->hidden_gradient == NULL) {
+        mlp_free(mlp);
+        return -1;
+    }
+    mlp->input_weights = mlp->weights;
+    mlp->hidden_bias = mlp->input_weights + (size_t)2 * num_cells * hidden;
+    mlp->output_weights = mlp->hidden_bias + hidden;
+    mlp->output_bias = mlp->output_weights + (size_t)num_cells * hidden;
+
+    // Uniform weights scaled to the fan-in; the output layer starts ten times
+    // smaller so that untrained Q-values stay close to zero
+    Rng rng;
+    rng_seed(&rng, seed);
+    float input_scale = sqrtf(3.0f / num_cells), output_scale = 0.1f * sqrtf(3.0f / hidden);
+    for (size_t i = 0; i < (size_t)2 * num_cells * hidden; i++)
+        mlp->input_weights[i] = input_scale * (2 * rng_uniform(&rng) - 1);
+    for (int i = 0; i < hidden; i++)
+        mlp->hidden_bias[i] = 0.01f;
+    for (size_t i = 0; i < (size_t)num_cells * hidden; i++)
+        mlp->output_weights[i] = output_scale * (2 * rng_uniform(&rng) - 1);
+    for (int i = 0; i < num_cells; i++)
+        mlp->output_bias[i] = 0;
+    return 0;
+}
+
+void mlp_free(Mlp* mlp) {
+    free(mlp->weights);
+    free(mlp->gradients);
+    free(mlp->activations);
+    free(mlp->outputs);
+    free(mlp->hidden_gradient);
+    memset(mlp, 0, sizeof(*mlp));
+}
+
+const float* mlp_forward(Mlp* mlp, const Position* positions, const uint8_t* sides, int count) {
+    const MlpKernels* k = kernels;
+    int hidden = mlp->hidden, num_cells = mlp->num_cells;
+    for (int b = 0; b < count; b++) {
+        int side = sides != NULL ? sides[b] : position_side_to_move(positions[b]);
+        float* h = mlp->activations + (size_t)b * hidden;
+        memcpy(h, mlp->hidden_bias, (size_t)hidden * sizeof(float));
+        for (uint64_t bits = position_stones(positions[b], side); bits; bits &= bits - 1)
+            k->add(h, mlp->input_weights + (size_t)engine_lowest_cell(bits) * hidden, hidden);
+        for (uint64_t bits = position_stones(positions[b], side ^ 1); bits; bits &= bits - 1)
+            k->add(h, mlp->input_weights + (size_t)(num_cells + engine_lowest_cell(bits)) * hidden, hidden);
+        k->relu(h, hidden);
+        float* q = mlp->outputs + (size_t)b * num_cells;
+        for (int cell = 0; cell < num_cells; cell++)
+            q[cell] = mlp->output_bias[cell] + k->dot(mlp->output_weights + (size_t)cell * hidden, h, hidden);
+    }
+    return mlp->outputs;
+}
+
+float mlp_train(Mlp* mlp, const Position* positions, const uint8_t* sides, const uint8_t* moves, const float* targets,
+                int count, float learning_rate) {
+    const MlpKernels* k = kernels;
+    int hidden = mlp->hidden, num_cells = mlp->num_cells;
+    // The gradients mirror the weights' layout
+    float* input_gradients = mlp->gradients;
+    float* hidden_bias_gradient = input_gradients + (mlp->hidden_bias - mlp->weights);
+    float* output_gradients = input_gradients + (mlp->output_weights - mlp->weights);
+    float* output_bias_gradient = input_gradients + (mlp->output_bias - mlp->weights);
+    float change = 0;
+    for (int first = 0; first < count; first += MLP_MAX_BATCH) {
+        int batch = count - first < MLP_MAX_BATCH ? count - first : MLP_MAX_BATCH;
+        const float* q = mlp_forward(mlp, positions + first, sides != NULL ? sides + first : NULL, batch);
+        for (int b = 0; b < batch; b++) {
+            Position pos = positions[first + b];
+            int side = sides != NULL ? sides[first + b] : position_side_to_move(pos);
+            int move = moves[first + b];
+            float error = q[(size_t)b * num_cells + move] - targets[first + b];
+            change += learning_rate * error * learning_rate * error;
+
+            // Only the chosen move's output has a gradient
+            const float* h = mlp->activations + (size_t)b * hidden;
+            k->axpy(output_gradients + (size_t)move * hidden, error, h, hidden);
+            output_bias_gradient[move] += error;
+            k->relu_gradient(mlp->hidden_gradient, error, mlp->output_weights + (size_t)move * hidden, h, hidden);
+            k->add(hidden_bias_gradient, mlp->hidden_gradient, hidden);
+            for (uint64_t bits = position_stones(pos, side); bits; bits &= bits - 1)
+                k->add(input_gradients + (size_t)engine_lowest_cell(bits) * hidden, mlp->hidden_gradient, hidden);
+            for (uint64_t bits = position_stones(pos, side ^ 1); bits; bits &= bits - 1)
+                k->add(input_gradients + (size_t)(num_cells + engine_lowest_cell(bits)) * hidden, mlp->hidden_gradient, hidden);
+        }
+        k->axpy(mlp->weights, -learning_rate, mlp->gradients, mlp->num_weights);
+        memset(mlp->gradients, 0, mlp->num_weights * sizeof(float));
+    }
+    return change;
+}
@@ -0,0 +1,62 @@
+#ifndef MLP_H
+#define MLP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+// A small network in place of a Q-table: two planes of inputs (the stones
+// of the side to move, then the opponent's), one ReLU hidden layer and a
+// linear Q-value per cell. The input weights are stored one hidden-sized
+// row per input, so the first layer is a sum of the rows of the occupied
+// cells rather than a matrix product over mostly empty planes.
+#define MLP_LANES 16        // hidden units come in multiples of this, one AVX-512 register
+#define MLP_MAX_BATCH 128   // positions per forward or training pass
+#define MLP_DEFAULT_HIDDEN 64
+
+typedef struct {
+    int num_cells;
+    int hidden;
+    size_t num_weights;
+    // One block, in the model file's order: input rows [2 * num_cells][hidden],
+    // hidden bias [hidden], output rows [num_cells][hidden], output bias [num_cells]
+    float* weights;
+    float* input_weights;
+    float* hidden_bias;
+    float* output_weights;
+    float* output_bias;
+    // Scratch, allocated once: training never allocates
+    float* gradients;       // num_weights, zero between passes
+    float* activations;     // [MLP_MAX_BATCH][hidden]
+    float* outputs;         // [MLP_MAX_BATCH][num_cells]
+    float* hidden_gradient; // [hidden]
+} Mlp;
+
+// hidden is rounded up to a multiple of MLP_LANES; the weights start small
+// and random, so every Q-value starts near zero
+int mlp_init(Mlp* mlp, int num_cells, int hidden, uint64_t seed);
+void mlp_free(Mlp* mlp);
+
+// Hidden units of a network with num_weights weights on num_cells cells, 0
+// if no network has that many
+int mlp_hidden_units(uint64_t num_weights, int num_cells);
+
+// Q-values of count positions (at most MLP_MAX_BATCH) for the given sides to
+// move (NULL for each position's own), as count rows in mlp->outputs. The
+// rows last until the next call.
+const float* mlp_forward(Mlp* mlp, const Position* positions, const uint8_t* sides, int count);
+
+// One step of gradient descent on (Q(position, move) - target)^2 / 2 over
+// count samples, the gradients summed over each batch of MLP_MAX_BATCH.
+// Returns the sum of the squared changes a table with the same learning
+// rate would have made, (learning_rate * (target - Q))^2.
+float mlp_train(Mlp* mlp, const Position* positions, const uint8_t* sides, const uint8_t* moves, const float* targets,
+                int count, float learning_rate);
+
+// The kernels in use: "scalar", "avx2" or "avx512", picked from what the CPU
+// supports at the first mlp_init. mlp_use_kernels switches to a set by name
+// (to compare them) and returns -1 if it is not available here.
+const char* mlp_kernels_name(void);
+int mlp_use_kernels(const char* name);
+
+#endif
@@ -0,0 +1,100 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "engine.h"
+#include "mlp.h"
+#include "rng.h"
+#include "timer.h"
+
+#define BENCH_POSITIONS 4096
+
+// Function to fill positions with random mid-game boards
+static void random_positions(const Game* game, Position* positions, int count, uint64_t seed) {
+    Rng rng;
+    rng_seed(&rng, seed);
+    for (int i = 0; i < count; i++) {
+        Position pos = {0, 0};
+        int plies = (int)rng_below(&rng, (uint32_t)game->num_cells);
+        for (int ply = 0; ply < plies; ply++) {
+            uint64_t empty = position_empty(game, pos);
+            position_make(&pos, position_side_to_move(pos), engine_select_cell(empty, (int)rng_below(&rng, (uint32_t)engine_popcount(empty))));
+        }
+        positions[i] = pos;
+    }
+}
+
+// Benchmark the network kernels: forward and training cost per position for
+// each kernel set the CPU supports, with the outputs checked against scalar
+// Usage: mlp_bench [size] [hidden] [seconds]
+int main(int argc, char* argv[]) {
+    int size = argc > 1 ? atoi(argv[1]) : 5;
+    int hidden = argc > 2 ? atoi(argv[2]) : MLP_DEFAULT_HIDDEN;
+    double seconds = argc > 3 ? atof(argv[3]) : 0.5;
+    static const char* const names[] = {"scalar", "avx2", "avx512"};
+
+    Game game;
+    if (game_init(&game, size, size < 4 ? size : 4) != 0) {
+        printf("Error: Unsupported board %dx%d.\n", size, size);
+        return 1;
+    }
+    Mlp mlp;
+    Position* positions = malloc(BENCH_POSITIONS * sizeof(Position));
+    uint8_t* moves = malloc(BENCH_POSITIONS);
+    float* targets = malloc(BENCH_POSITIONS * sizeof(float));
+    float* reference = malloc((size_t)MLP_MAX_BATCH * game.num_cells * sizeof(float));
+    if (positions == NULL || moves == NULL || targets == NULL || reference == NULL || mlp_init(&mlp, game.num_cells, hidden, 1) != 0) {
+        printf("Error: Unable to allocate the network.\n");
+        return 1;
+    }
+    random_positions(&game, positions, BENCH_POSITIONS, 2);
+    Rng rng;
+    rng_seed(&rng, 3);
+    for (int i = 0; i < BENCH_POSITIONS; i++) {
+        moves[i] = (uint8_t)rng_below(&rng, (uint32_t)game.num_cells);
+        targets[i] = 2 * rng_uniform(&rng) - 1;
+    }
+    mlp_use_kernels("scalar");
+    const float* outputs = mlp_forward(&mlp, positions, NULL, MLP_MAX_BATCH);
+    for (int i = 0; i < MLP_MAX_BATCH * game.num_cells; i++)
+        reference[i] = outputs[i];
+
+    printf("%dx%d board, %d hidden units, %zu weights\n", size, size, mlp.hidden, mlp.num_weights);
+    printf("kernels  forward ns/pos  train ns/pos  max diff\n");
+    for (int k = 0; k < 3; k++) {
+        if (mlp_use_kernels(names[k]) != 0)
+            continue;
+        outputs = mlp_forward(&mlp, positions, NULL, MLP_MAX_BATCH);
+        float diff = 0;
+        for (int i = 0; i < MLP_MAX_BATCH * game.num_cells; i++)
+            diff = fmaxf(diff, fabsf(outputs[i] - reference[i]));
+
+        long evaluated = 0;
+        double start = monotonic_seconds(), elapsed;
+        do {
+            for (int i = 0; i < BENCH_POSITIONS; i += MLP_MAX_BATCH)
+                mlp_forward(&mlp, positions + i, NULL, MLP_MAX_BATCH);
+            evaluated += BENCH_POSITIONS;
+        } while ((elapsed = monotonic_seconds() - start) < seconds);
+        double forward = elapsed * 1e9 / evaluated;
+
+        // Training moves the weights, so each kernel set trains its own copy
+        Mlp copy;
+        if (mlp_init(&copy, game.num_cells, hidden, 1) != 0)
+            return 1;
+        long trained = 0;
+        start = monotonic_seconds();
+        do {
+            mlp_train(&copy, positions, NULL, moves, targets, BENCH_POSITIONS, 1e-4f);
+            trained += BENCH_POSITIONS;
+        } while ((elapsed = monotonic_seconds() - start) < seconds);
+        mlp_free(&copy);
+        printf("%-7s  %14.1f  %12.1f  %8.2g\n", names[k], forward, elapsed * 1e9 / trained, diff);
+    }
+
+    mlp_free(&mlp);
+    free(positions);
+    free(moves);
+    free(targets);
+    free(reference);
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "model.h"
+
+static uint32_t table_kind(const QTable* table) {
+    if (table->sparse != NULL)
+        return MODEL_SPARSE;
+    if (table->mlp != NULL)
+        return MODEL_MLP;
+    return table->index != NULL ? MODEL_STATE_INDEXED : MODEL_POSITIONAL;
+}
+
+// Function to read the header of a model file. A legacy raw file gets a
+// version 0 header describing a positional 3x3 table.
+static int read_header(FILE* file, ModelHeader* header) {
+    memset(header, 0, sizeof(*header));
+    if (fread(header, sizeof(*header), 1, file) == 1 && memcmp(header->magic, MODEL_MAGIC, 4) == 0)
+        return 0;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    if (size != (long)(2 * 9 * sizeof(float)))
+        return -1;
+    memset(header, 0, sizeof(*header));
+    header->kind = MODEL_POSITIONAL;
+    header->board_size = 3;
+    header->win_length = 3;
+    header->num_cells = 9;
+    header->num_values = 2 * 9;
+    fseek(file, 0, SEEK_SET);
+    return 0;
+}
+
+int model_read_header(const char* filename, ModelHeader* header) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Error: Unable to open file for reading.\n");
+        return -1;
+    }
+    int status = read_header(file, header);
+    fclose(file);
+    if (status != 0)
+        printf("Error: %s is not a model file.\n", filename);
+    return status;
+}
+
+typedef struct {
+    FILE* file;
+    int num_cells;
+    int status;
+} RecordWriter;
+
+// Function to write one record of a sparse table
+static void write_record(void* context, Position pos, const float* row) {
+    RecordWriter* writer = context;
+    uint64_t key[2] = {pos.x, pos.o};
+    if (writer->status == 0 && (fwrite(key, sizeof(key), 1, writer->file) != 1 ||
+                                fwrite(row, sizeof(float), writer->num_cells, writer->file) != (size_t)writer->num_cells))
+        writer->status = -1;
+}
+
+// Function to write a Q-table with a header describing its layout and board
+static int write_model(const char* filename, const Game* game, const QTable* table) {
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("Error: Unable to open file for writing.\n");
+        return -1;
+    }
+    ModelHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_MAGIC, 4);
+    header.version = MODEL_VERSION;
+    header.kind = table_kind(table);
+    header.board_size = game->size;
+    header.win_length = game->win_length;
+    header.num_cells = table->num_cells;
+    header.num_values = qtable_num_values(table);
+    size_t count = qtable_num_values(table);
+    int status = fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+    if (status == 0 && table->sparse != NULL) {
+        RecordWriter writer = {file, table->num_cells, 0};
+        sparse_qtable_visit(table->sparse, write_record, &writer);
+        status = writer.status;
+    } else if (status == 0 && fwrite(table->values, sizeof(float), count, file) != count) {
+        status = -1;
+    }
+    if (fclose(file) != 0)
+        status = -1;
+    if (status != 0)
+        printf("Error: Unable to write %s.\n", filename);
+    return status;
+}
+
+// Function to save a Q-table: it is written next to filename and renamed
+// into place, so a failed or interrupted save leaves the old model and its
+// deltas as they were. Once the new file is complete the old deltas would no
+// longer apply, so they go before the rename.
+int model_save_qtable(const char* filename, const Game* game, const QTable* table) {
+    char temp[CHECKPOINT_MAX_PATH + 16];
+    if (snprintf(temp, sizeof(temp), "%s.tmp", filename) >= (int)sizeof(temp)) {
+        printf("Error: The path %s is too long.\n", filename);
+        return -1;
+    }
+    if (write_model(temp, game, table) != 0) {
+        remove(temp);
+        return -1;
+    }
+    checkpoint_remove_deltas(filename);
+    if (rename(temp, filename) != 0) {
+        printf("Error: Unable to replace %s.\n", filename);
+        remove(temp);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to add the records of a sparse model to a sparse table
+static int read_records(FILE* file, QTable* table, uint64_t count) {
+    for (uint64_t r = 0; r < count; r++) {
+        uint64_t key[2];
+        if (fread(key, sizeof(key), 1, file) != 1)
+            return -1;
+        float* row = sparse_qtable_insert(table->sparse, (Position){key[0], key[1]});
+        if (row == NULL || fread(row, sizeof(float), table->num_cells, file) != (size_t)table->num_cells)
+            return -1;
+    }
+    return 0;
+}
+
+// Function to load a Q-table into an already initialized table; the file must
+// match its layout and the board geometry. Checkpoint deltas saved after it
+// are applied on top.
+int model_load_qtable(const char* filename, const Game* game, QTable* table) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Error: Unable to open file for reading.\n");
+        return -1;
+    }
+    ModelHeader header;
+    int status = read_header(file, &header);
+    if (status != 0) {
+        printf("Error: %s is not a model file.\n", filename);
+    } else if (header.kind != table_kind(table) || (int)header.board_size != game->size ||
+               (int)header.win_length != game->win_length || header.num_cells != (uint32_t)table->num_cells ||
+               (table->sparse == NULL && header.num_values != qtable_num_values(table))) {
+        printf("Error: %s holds a different model (kind %u, %ux%u, %u in a row).\n", filename, header.kind,
+               header.board_size, header.board_size, header.win_length);
+        status = -1;
+    } else if (table->sparse != NULL) {
+        status = read_records(file, table, header.num_values / table->num_cells);
+        if (status != 0)
+            printf("Error: %s is truncated.\n", filename);
+    } else if (fread(table->values, sizeof(float), header.num_values, file) != header.num_values) {
+        printf("Error: %s is truncated.\n", filename);
+        status = -1;
+    }
+    fclose(file);
+    if (status == 0 && checkpoint_apply_deltas(filename, game, table) < 0)
+        status = -1;
+    return status;
+}
+
+int model_open_qtable(const char* filename, const Game* game, QTable* table, StateIndex* index, bool* has_index) {
+    ModelHeader header;
+    *has_index = false;
+    if (model_read_header(filename, &header) != 0)
+        return -1;
+    if (header.kind == MODEL_STATE_INDEXED) {
+        if (state_index_build(index, game) != 0)
+            return -1;
+        if (qtable_init_state_indexed(table, index) != 0) {
+            printf("Error: Unable to allocate a state-indexed Q-table.\n");
+            state_index_free(index);
+            return -1;
+        }
+        *has_index = true;
+    } else if (header.kind == MODEL_MLP) {
+        if (qtable_init_mlp(table, game, mlp_hidden_units(header.num_values, (int)header.num_cells), 0) != 0) {
+            printf("Error: Unable to allocate the network.\n");
+            return -1;
+        }
+    } else if (header.kind == MODEL_SPARSE) {
+        if (qtable_init_sparse(table, game, (size_t)SPARSE_QTABLE_DEFAULT_MB << 20) != 0) {
+            printf("Error: Unable to allocate a sparse Q-table.\n");
+            return -1;
+        }
+    } else if (qtable_init_positional(table, game) != 0) {
+        printf("Error: Unable to allocate the Q-table.\n");
+        return -1;
+    }
+    if (model_load_qtable(filename, game, table) != 0) {
+        qtable_free(table);
+        if (*has_index)
+            state_index_free(index);
+        *has_index = false;
+        return -1;
+    }
+    return 0;
+}
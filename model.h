@@ -0,0 +1,41 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+#include "qtable.h"
+
+#define MODEL_MAGIC "TTTM"
+#define MODEL_VERSION 1
+
+typedef enum {
+    MODEL_POSITIONAL = 0,     // QTable with index == NULL
+    MODEL_STATE_INDEXED = 1,  // QTable with one row per StateIndex rank
+    MODEL_MLP = 2,            // QTable with an Mlp: its weights, in the order of Mlp.weights
+    MODEL_SPARSE = 3          // QTable with a SparseQTable: records of x, o (uint64_t) and the row
+} ModelKind;
+
+// Fixed 32-byte header in front of the values, little-endian on every
+// platform we build for. Files without it are the old raw dumps of
+// q_values[2][3][3] (72 bytes), which still load as version 0.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t board_size;
+    uint32_t win_length;
+    uint32_t num_cells;
+    uint64_t num_values;
+} ModelHeader;
+
+int model_read_header(const char* filename, ModelHeader* header);
+int model_save_qtable(const char* filename, const Game* game, const QTable* table);
+int model_load_qtable(const char* filename, const Game* game, QTable* table);
+
+// Allocate table in the layout of the model in filename and load it. A
+// state-indexed model is ranked by the game's StateIndex, built into index
+// (and *has_index set) when it is one. Nothing is left allocated on error.
+int model_open_qtable(const char* filename, const Game* game, QTable* table, StateIndex* index, bool* has_index);
+
+#endif
@@ -0,0 +1,152 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "net.h"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NET_ACCEPT_BACKOFF_NS 10000000 // pause before retrying when out of descriptors or memory
+
+// Function to fill in the socket address an address string describes,
+// returning its size or 0 if it is malformed
+static socklen_t parse_address(const char* address, struct sockaddr_storage* storage) {
+    memset(storage, 0, sizeof(*storage));
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un* local = (struct sockaddr_un*)storage;
+        if (strlen(address + 5) >= sizeof(local->sun_path))
+            return 0;
+        local->sun_family = AF_UNIX;
+        strcpy(local->sun_path, address + 5);
+        return sizeof(*local);
+    }
+
+    char host[64] = "127.0.0.1";
+    const char* port = strrchr(address, ':');
+    if (port != NULL) {
+        size_t length = (size_t)(port - address);
+        if (length >= sizeof(host))
+            return 0;
+        memcpy(host, address, length);
+        host[length] = '\0';
+        port++;
+    } else {
+        port = address;
+    }
+    struct sockaddr_in* inet = (struct sockaddr_in*)storage;
+    inet->sin_family = AF_INET;
+    inet->sin_port = htons((uint16_t)atoi(port));
+    if (atoi(port) <= 0 || atoi(port) > 65535 || inet_pton(AF_INET, host, &inet->sin_addr) != 1)
+        return 0;
+    return sizeof(*inet);
+}
+
+int net_listen(const char* address, int backlog) {
+    struct sockaddr_storage storage;
+    socklen_t size = parse_address(address, &storage);
+    int fd;
+    if (size == 0 || (fd = socket(storage.ss_family, SOCK_STREAM, 0)) < 0)
+        return -1;
+    if (storage.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un*)&storage)->sun_path); // a stale socket from an earlier run
+    } else {
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+    if (bind(fd, (struct sockaddr*)&storage, size) != 0 || listen(fd, backlog) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to wait for the next connection. A client that hung up first or
+// a signal is retried at once; anything else but a broken listener (out of
+// descriptors or memory, a network error passed on by accept) is retried
+// after a pause, since retrying at once would only spin on the same error.
+int net_accept(int listener) {
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd >= 0)
+            return fd;
+        if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK || errno == EFAULT)
+            return -1;
+        if (errno != EINTR && errno != ECONNABORTED) {
+            struct timespec delay = {0, NET_ACCEPT_BACKOFF_NS};
+            nanosleep(&delay, NULL);
+        }
+    }
+}
+
+int net_connect(const char* address) {
+    struct sockaddr_storage storage;
+    socklen_t size = parse_address(address, &storage);
+    int fd;
+    if (size == 0 || (fd = socket(storage.ss_family, SOCK_STREAM, 0)) < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr*)&storage, size) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int net_send_all(int fd, const void* data, size_t size) {
+    const char* bytes = data;
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return -1;
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return 0;
+}
+
+int net_receive_all(int fd, void* data, size_t size) {
+    char* bytes = data;
+    while (size > 0) {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (received <= 0)
+            return -1;
+        bytes += received;
+        size -= (size_t)received;
+    }
+    return 0;
+}
+
+void net_close(int fd) {
+    close(fd);
+}
+
+#else
+
+int net_listen(const char* address, int backlog) {
+    return -1;
+}
+
+int net_accept(int listener) {
+    return -1;
+}
+
+int net_connect(const char* address) {
+    return -1;
+}
+
+int net_send_all(int fd, const void* data, size_t size) {
+    return -1;
+}
+
+int net_receive_all(int fd, void* data, size_t size) {
+    return -1;
+}
+
+void net_close(int fd) {
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stddef.h>
+
+// Stream sockets for the local servers. An address is "port" (on
+// 127.0.0.1), "host:port" (IPv4) or "unix:/path". Not available on
+// Windows, where every call fails.
+
+// Listening socket on address, -1 on error. A stale Unix socket file from an
+// earlier run is replaced.
+int net_listen(const char* address, int backlog);
+
+// Next connection on a listening socket. Passing errors are retried, with a
+// short pause where they would repeat; -1 only if the listener is unusable.
+int net_accept(int listener);
+
+// Connected socket to address, -1 on error
+int net_connect(const char* address);
+
+// Send or receive exactly size bytes; -1 on error or at the end of the stream
+int net_send_all(int fd, const void* data, size_t size);
+int net_receive_all(int fd, void* data, size_t size);
+
+void net_close(int fd);
+
+#endif
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+#include "policy.h"
+#include "timer.h"
+
+// Function to read "row col" ("layer row col" on the cube) until it names an empty cell
+int policy_human_move(Policy* policy, const Game* game, Position pos) {
+    uint64_t empty = position_empty(game, pos);
+    for (;;) {
+        int layer = 0, row, col;
+        printf(policy->prompt, side_symbol(position_side_to_move(pos)));
+        fflush(stdout);
+        int read = game->layers > 1 ? scanf("%d %d %d", &layer, &row, &col) - 1 : scanf("%d %d", &row, &col);
+        if (read == EOF || read == EOF - 1)
+            return -1;
+        if (read != 2) {
+            scanf("%*[^\n]"); // Skip the rest of the line
+            printf("Invalid move. Try again.\n");
+            continue;
+        }
+        int cell = (layer * game->size + row) * game->size + col;
+        if (layer < 0 || layer >= game->layers || row < 0 || row >= game->size || col < 0 || col >= game->size ||
+            !(empty >> cell & 1)) {
+            printf("Invalid move. Try again.\n");
+            continue;
+        }
+        return cell;
+    }
+}
+
+// Perfect play where the tablebase covers the position, random elsewhere
+int policy_tablebase_move(Policy* policy, const Game* game, Position pos) {
+    int move = tablebase_best_move(policy->tablebase, pos);
+    return move >= 0 ? move : policy_random_move(policy, game, pos);
+}
+
+int policy_mcts_move(Policy* policy, const Game* game, Position pos) {
+    MctsLimits limits = {policy->playouts, 0, 1};
+    mcts_set_position(policy->tree, pos);
+    return mcts_search(policy->tree, &limits, NULL);
+}
+
+int policy_search_move(Policy* policy, const Game* game, Position pos) {
+    SearchResult result;
+    return search_best_move(game, pos, &policy->limits, &result);
+}
+
+int policy_choose_move_timed(Policy* policy, const Game* game, Position pos) {
+    uint64_t start = monotonic_ns();
+    int move = policy_dispatch_move(policy, game, pos);
+    latency_record(policy->kind, game_slot(game), monotonic_ns() - start);
+    return move;
+}
+
+static const char* const kind_names[POLICY_NUM_KINDS] = {
+#define POLICY_NAME(KIND, name) #name,
+    POLICY_KINDS(POLICY_NAME)
+#undef POLICY_NAME
+};
+
+int policy_kind_from_name(const char* name) {
+    for (int kind = 0; kind < POLICY_NUM_KINDS; kind++) {
+        if (strcmp(name, kind_names[kind]) == 0)
+            return kind;
+    }
+    return -1;
+}
+
+const char* policy_kind_name(PolicyKind kind) {
+    return kind < POLICY_NUM_KINDS ? kind_names[kind] : "unknown";
+}
+
+void policy_init_human(Policy* policy, const char* prompt) {
+    memset(policy, 0, sizeof(*policy));
+    policy->kind = POLICY_HUMAN;
+    policy->prompt = prompt;
+}
+
+void policy_init_random(Policy* policy, uint64_t seed) {
+    memset(policy, 0, sizeof(*policy));
+    policy->kind = POLICY_RANDOM;
+    rng_seed(&policy->rng, seed);
+}
+
+void policy_init_greedy(Policy* policy, const QTable* table) {
+    memset(policy, 0, sizeof(*policy));
+    policy->kind = POLICY_GREEDY;
+    policy->table = table;
+}
+
+void policy_init_qtable(Policy* policy, const QTable* table, float epsilon, uint64_t seed) {
+    memset(policy, 0, sizeof(*policy));
+    policy->kind = POLICY_EPSILON;
+    policy->table = table;
+    policy->epsilon = epsilon;
+    rng_seed(&policy->rng, seed);
+}
+
+void policy_init_scripted(Policy* policy, const uint8_t* script, int script_length) {
+    memset(policy, 0, sizeof(*policy));
+    policy->kind = POLICY_SCRIPTED;
+    policy->script = script;
+    policy->script_length = script_length;
+}
+
+void policy_init_tablebase(Policy* policy, const Tablebase* tablebase, uint64_t seed) {
+    memset(policy, 0, sizeof(*policy));
+    policy->kind = POLICY_TABLEBASE;
+    policy->tablebase = tablebase;
+    rng_seed(&policy->rng, seed);
+}
+
+void policy_init_mcts(Policy* policy, MctsTree* tree, long playouts) {
+    memset(policy, 0, sizeof(*policy));
+    policy->kind = POLICY_MCTS;
+    policy->tree = tree;
+    policy->playouts = playouts;
+}
+
+void policy_init_search(Policy* policy, uint64_t budget_ns, int max_depth) {
+    memset(policy, 0, sizeof(*policy));
+    policy->kind = POLICY_SEARCH;
+    policy->limits.budget_ns = budget_ns;
+    policy->limits.max_depth = max_depth;
+}
@@ -0,0 +1,131 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stdint.h>
+#include "engine.h"
+#include "latency.h"
+#include "mcts.h"
+#include "qtable.h"
+#include "rng.h"
+#include "search.h"
+#include "tablebase.h"
+
+// Every kind of player, as (KIND, name). Adding one means a line here, a
+// policy_<name>_move function below and an init function; match.c builds a
+// game loop for every pairing from this list.
+#define POLICY_KINDS(X)     \
+    X(HUMAN, human)         \
+    X(RANDOM, random)       \
+    X(GREEDY, greedy)       \
+    X(EPSILON, epsilon)     \
+    X(SCRIPTED, scripted)   \
+    X(TABLEBASE, tablebase) \
+    X(MCTS, mcts)           \
+    X(SEARCH, search)
+
+typedef enum {
+#define POLICY_ENUM(KIND, name) POLICY_##KIND,
+    POLICY_KINDS(POLICY_ENUM)
+#undef POLICY_ENUM
+    POLICY_NUM_KINDS
+} PolicyKind;
+
+// Anything that picks moves: a human at the keyboard, a Q-table (greedy or
+// epsilon-greedy), a fixed script, a solved tablebase, MCTS, a deadline-bound
+// alpha-beta search or a uniformly random player. Moves are dispatched on
+// kind with a switch, never through a function pointer, so the cheap
+// policies inline into the game loop. A move is a cell, or -1 to give up
+// (end of input).
+typedef struct {
+    PolicyKind kind;
+    const char* prompt;         // human: printf format with %c for the player's symbol
+    const QTable* table;        // Q-table policies
+    float epsilon;
+    Rng rng;
+    const uint8_t* script;      // scripted: the player's n-th move is script[n]
+    int script_length;
+    MctsTree* tree;             // MCTS policies
+    long playouts;
+    const Tablebase* tablebase; // perfect play from a solved tablebase
+    SearchLimits limits;        // alpha-beta: time budget and depth per move
+} Policy;
+
+void policy_init_human(Policy* policy, const char* prompt);
+void policy_init_random(Policy* policy, uint64_t seed);
+void policy_init_greedy(Policy* policy, const QTable* table);
+void policy_init_qtable(Policy* policy, const QTable* table, float epsilon, uint64_t seed);
+void policy_init_scripted(Policy* policy, const uint8_t* script, int script_length);
+void policy_init_tablebase(Policy* policy, const Tablebase* tablebase, uint64_t seed);
+void policy_init_mcts(Policy* policy, MctsTree* tree, long playouts);
+void policy_init_search(Policy* policy, uint64_t budget_ns, int max_depth);
+
+// Kind from its name ("random", "greedy", ...), -1 if there is none
+int policy_kind_from_name(const char* name);
+const char* policy_kind_name(PolicyKind kind);
+
+// The expensive policies live in policy.c
+int policy_human_move(Policy* policy, const Game* game, Position pos);
+int policy_tablebase_move(Policy* policy, const Game* game, Position pos);
+int policy_mcts_move(Policy* policy, const Game* game, Position pos);
+int policy_search_move(Policy* policy, const Game* game, Position pos);
+
+static inline int policy_random_move(Policy* policy, const Game* game, Position pos) {
+    uint64_t empty = position_empty(game, pos);
+    if (empty == 0)
+        return -1;
+    return engine_select_cell(empty, (int)rng_below(&policy->rng, (uint32_t)engine_popcount(empty)));
+}
+
+// Highest Q-value for the side to move; random on positions the table lacks
+static inline int policy_greedy_move(Policy* policy, const Game* game, Position pos) {
+    uint64_t empty = position_empty(game, pos);
+    if (empty == 0)
+        return -1;
+    const float* q = qtable_row(policy->table, pos, position_side_to_move(pos));
+    if (q == NULL)
+        return policy_random_move(policy, game, pos);
+    return qtable_greedy_cell(q, empty, game->num_cells);
+}
+
+// Greedy, except a random move with probability epsilon (none when epsilon <= 0)
+static inline int policy_epsilon_move(Policy* policy, const Game* game, Position pos) {
+    if (policy->epsilon > 0 && rng_uniform(&policy->rng) < policy->epsilon)
+        return policy_random_move(policy, game, pos);
+    return policy_greedy_move(policy, game, pos);
+}
+
+// The next move of the script, or the lowest empty cell once it runs out or
+// names an occupied cell
+static inline int policy_scripted_move(Policy* policy, const Game* game, Position pos) {
+    uint64_t empty = position_empty(game, pos);
+    if (empty == 0)
+        return -1;
+    int n = position_num_stones(pos) / 2;
+    if (n < policy->script_length && (empty >> policy->script[n] & 1))
+        return policy->script[n];
+    return engine_lowest_cell(empty);
+}
+
+static inline int policy_dispatch_move(Policy* policy, const Game* game, Position pos) {
+    switch (policy->kind) {
+#define POLICY_CASE(KIND, name) \
+    case POLICY_##KIND:         \
+        return policy_##name##_move(policy, game, pos);
+        POLICY_KINDS(POLICY_CASE)
+#undef POLICY_CASE
+    default:
+        return -1;
+    }
+}
+
+// policy_dispatch_move, timed into the latency histograms
+int policy_choose_move_timed(Policy* policy, const Game* game, Position pos);
+
+// A move, timed when latency recording is on (a human's thinking time is not)
+static inline int policy_choose_move(Policy* policy, const Game* game, Position pos) {
+    if (__builtin_expect(latency_enabled, 0) && policy->kind != POLICY_HUMAN)
+        return policy_choose_move_timed(policy, game, pos);
+    return policy_dispatch_move(policy, game, pos);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <string.h>
+#include "population.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
+static size_t round_up(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Function to get zeroed, 64-byte aligned memory, from huge pages if possible
+static int arena_alloc(Population* population, size_t bytes) {
+    population->huge_pages = false;
+    population->mapped = false;
+#if defined(__linux__)
+    if (bytes >= POPULATION_HUGE_PAGE) {
+        size_t huge_bytes = round_up(bytes, POPULATION_HUGE_PAGE);
+        void* base;
+#ifdef MAP_HUGETLB
+        base = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) {
+            population->base = base;
+            population->bytes = huge_bytes;
+            population->huge_pages = true;
+            population->mapped = true;
+            return 0;
+        }
+#endif
+        // No reserved huge pages: ask for transparent ones instead
+        base = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+            return -1;
+#ifdef MADV_HUGEPAGE
+        madvise(base, huge_bytes, MADV_HUGEPAGE);
+#endif
+        population->base = base;
+        population->bytes = huge_bytes;
+        population->mapped = true;
+        return 0;
+    }
+#endif
+    bytes = round_up(bytes, POPULATION_ALIGNMENT);
+#if defined(_WIN32)
+    population->base = _aligned_malloc(bytes, POPULATION_ALIGNMENT);
+#else
+    population->base = aligned_alloc(POPULATION_ALIGNMENT, bytes);
+#endif
+    if (population->base == NULL)
+        return -1;
+    memset(population->base, 0, bytes);
+    population->bytes = bytes;
+    return 0;
+}
+
+// Function to allocate count zeroed instances for a board geometry.
+// scratch_per_instance is what the caller keeps per instance of a tile, so
+// the tile size leaves room for it in cache.
+int population_init(Population* population, const Game* game, long count, size_t scratch_per_instance) {
+    memset(population, 0, sizeof(*population));
+    if (count < 1)
+        return -1;
+    population->count = count;
+    population->num_cells = game->num_cells;
+    population->stride = round_up(sizeof(PopulationRecord) + 2 * game->num_cells * sizeof(float), POPULATION_ALIGNMENT);
+    if ((size_t)count > SIZE_MAX / population->stride)
+        return -1;
+
+    long tile = (long)(POPULATION_TILE_BYTES / (population->stride + scratch_per_instance));
+    if (tile < 1)
+        tile = 1;
+    population->tile_size = (int)(tile < count ? tile : count);
+    return arena_alloc(population, (size_t)count * population->stride);
+}
+
+void population_free(Population* population) {
+    if (population->base == NULL)
+        return;
+#if defined(__linux__)
+    if (population->mapped)
+        munmap(population->base, population->bytes);
+    else
+        free(population->base);
+#elif defined(_WIN32)
+    _aligned_free(population->base);
+#else
+    free(population->base);
+#endif
+    population->base = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+#include "qtable.h"
+
+#define POPULATION_ALIGNMENT 64
+#define POPULATION_HUGE_PAGE (2u << 20)
+#define POPULATION_TILE_BYTES (256u << 10) // about one L2 cache
+
+// Everything one learner touches during a game, packed into one run of cache
+// lines: its board, its score and its positional Q-table.
+typedef struct {
+    Position board;
+    uint32_t wins;
+    uint32_t reserved;
+    float q_values[]; // [2][num_cells]
+} PopulationRecord;
+
+// A population of learners stored back to back in one arena. Records are
+// stride bytes apart (a multiple of 64, so none straddles a cache line it
+// does not need) and the arena is backed by huge pages when the system has
+// them. Work goes tile by tile, tile_size records at a time, so a tile's
+// records and its per-instance scratch stay in cache.
+typedef struct {
+    unsigned char* base;
+    size_t bytes;
+    size_t stride;
+    long count;
+    int num_cells;
+    int tile_size;
+    bool huge_pages;  // explicitly mapped huge pages (otherwise at most transparent ones)
+    bool mapped;      // from mmap rather than the aligned allocator
+} Population;
+
+int population_init(Population* population, const Game* game, long count, size_t scratch_per_instance);
+void population_free(Population* population);
+
+static inline PopulationRecord* population_record(const Population* population, long instance) {
+    return (PopulationRecord*)(population->base + (size_t)instance * population->stride);
+}
+
+// The instance's Q-values as a positional QTable the engine can use
+static inline QTable population_table(const Population* population, long instance) {
+    QTable table = {.values = population_record(population, instance)->q_values, .num_cells = population->num_cells};
+    return table;
+}
+
+#endif
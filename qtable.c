@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <string.h>
+#include "qtable.h"
+
+// Function to allocate a zeroed positional table (2 rows of num_cells)
+int qtable_init_positional(QTable* table, const Game* game) {
+    table->index = NULL;
+    table->num_cells = game->num_cells;
+    table->dirty = NULL;
+    table->sparse = NULL;
+    table->mlp = NULL;
+    table->values = calloc(qtable_num_values(table), sizeof(float));
+    return table->values != NULL ? 0 : -1;
+}
+
+// Function to allocate a zeroed table with one row per reachable position
+int qtable_init_state_indexed(QTable* table, const StateIndex* index) {
+    table->index = index;
+    table->num_cells = index->game->num_cells;
+    table->dirty = NULL;
+    table->sparse = NULL;
+    table->mlp = NULL;
+    table->values = calloc(qtable_num_values(table), sizeof(float));
+    return table->values != NULL ? 0 : -1;
+}
+
+// Function to create an empty sparse table holding at most max_bytes of rows
+int qtable_init_sparse(QTable* table, const Game* game, size_t max_bytes) {
+    table->values = NULL;
+    table->index = NULL;
+    table->num_cells = game->num_cells;
+    table->dirty = NULL;
+    table->mlp = NULL;
+    table->sparse = malloc(sizeof(SparseQTable));
+    if (table->sparse == NULL)
+        return -1;
+    if (sparse_qtable_init(table->sparse, game->num_cells, max_bytes) != 0) {
+        free(table->sparse);
+        table->sparse = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Function to create a network of hidden units (rounded up to MLP_LANES)
+// with small random weights from seed
+int qtable_init_mlp(QTable* table, const Game* game, int hidden, uint64_t seed) {
+    table->index = NULL;
+    table->num_cells = game->num_cells;
+    table->dirty = NULL;
+    table->sparse = NULL;
+    table->values = NULL;
+    table->mlp = malloc(sizeof(Mlp));
+    if (table->mlp == NULL)
+        return -1;
+    if (mlp_init(table->mlp, game->num_cells, hidden, seed) != 0) {
+        free(table->mlp);
+        table->mlp = NULL;
+        return -1;
+    }
+    table->values = table->mlp->weights;
+    return 0;
+}
+
+void qtable_free(QTable* table) {
+    if (table->mlp != NULL) {
+        mlp_free(table->mlp); // frees the values too
+        free(table->mlp);
+        table->values = NULL;
+    }
+    free(table->values);
+    free(table->dirty);
+    if (table->sparse != NULL) {
+        sparse_qtable_free(table->sparse);
+        free(table->sparse);
+    }
+    table->values = NULL;
+    table->dirty = NULL;
+    table->sparse = NULL;
+    table->mlp = NULL;
+}
+
+int qtable_track_dirty(QTable* table) {
+    if (table->sparse != NULL || table->mlp != NULL)
+        return 0;
+    size_t words = (qtable_num_blocks(table) + 63) / 64;
+    free(table->dirty);
+    table->dirty = malloc(words * sizeof(uint64_t));
+    if (table->dirty == NULL)
+        return -1;
+    memset(table->dirty, 0xff, words * sizeof(uint64_t));
+    return 0;
+}
@@ -0,0 +1,126 @@
+#ifndef QTABLE_H
+#define QTABLE_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+#include "mlp.h"
+#include "sparse_qtable.h"
+#include "state_index.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// A table of per-cell Q-values. The positional layout is the classic
+// q_values[2][BOARD_SIZE][BOARD_SIZE] (one row per side, whatever the
+// position); the state-indexed layout has one row per reachable position,
+// addressed through a StateIndex; the sparse layout has rows only for the
+// positions that have been updated, in a SparseQTable (values is NULL). An
+// MLP layout computes each row with a network whose weights are the values.
+typedef struct {
+    float* values;
+    const StateIndex* index; // NULL for the positional layout
+    int num_cells;
+    uint64_t* dirty;         // one bit per block written since the last checkpoint, NULL when not tracked
+    SparseQTable* sparse;    // NULL unless sparse
+    Mlp* mlp;                // NULL unless a network
+} QTable;
+
+#define QTABLE_DIRTY_BLOCK 1024 // values per dirty bit, one 4 KB page of floats
+
+int qtable_init_positional(QTable* table, const Game* game);
+int qtable_init_state_indexed(QTable* table, const StateIndex* index);
+int qtable_init_sparse(QTable* table, const Game* game, size_t max_bytes);
+int qtable_init_mlp(QTable* table, const Game* game, int hidden, uint64_t seed);
+void qtable_free(QTable* table);
+
+// Start recording which blocks are written, with every block marked dirty.
+// Sparse tables and networks are always checkpointed in full.
+int qtable_track_dirty(QTable* table);
+
+static inline size_t qtable_num_rows(const QTable* table) {
+    if (table->sparse != NULL)
+        return sparse_qtable_count(table->sparse);
+    return table->index != NULL ? table->index->num_states : 2;
+}
+
+static inline size_t qtable_num_values(const QTable* table) {
+    if (table->mlp != NULL)
+        return table->mlp->num_weights;
+    return qtable_num_rows(table) * (size_t)table->num_cells;
+}
+
+static inline size_t qtable_num_blocks(const QTable* table) {
+    return (qtable_num_values(table) + QTABLE_DIRTY_BLOCK - 1) / QTABLE_DIRTY_BLOCK;
+}
+
+// Note a write to one value, so the next checkpoint includes its block
+static inline void qtable_mark_dirty(const QTable* table, const float* value) {
+    if (table->dirty != NULL) {
+        size_t block = (size_t)(value - table->values) / QTABLE_DIRTY_BLOCK;
+        table->dirty[block >> 6] |= 1ULL << (block & 63);
+    }
+}
+
+// Row of Q-values for the side to move in pos, or NULL for an unindexed
+// position (or, in a sparse table, one never updated). A network's row is
+// computed into its scratch and lasts until the next call.
+static inline float* qtable_row(const QTable* table, Position pos, int side) {
+    if (table->mlp != NULL) {
+        uint8_t side_to_move = (uint8_t)side;
+        return (float*)mlp_forward(table->mlp, &pos, &side_to_move, 1);
+    }
+    if (table->sparse != NULL)
+        return sparse_qtable_find(table->sparse, pos);
+    if (table->index == NULL)
+        return table->values + (size_t)side * table->num_cells;
+    uint32_t rank = state_index_rank(table->index, pos);
+    if (rank == STATE_INDEX_NONE)
+        return NULL;
+    return table->values + (size_t)rank * table->num_cells;
+}
+
+// Row to write a position's Q-values into: a sparse table adds one the first
+// time. The row is only good until the next call. Writes to a network's row
+// change nothing; networks learn through mlp_train.
+static inline float* qtable_row_for_update(const QTable* table, Position pos, int side) {
+    if (table->sparse != NULL)
+        return sparse_qtable_insert(table->sparse, pos);
+    return qtable_row(table, pos, side);
+}
+
+// First legal cell holding the highest Q-value
+static inline int qtable_greedy_cell(const float* q, uint64_t legal, int num_cells) {
+    float best = -INFINITY;
+    int cell = 0;
+#ifdef __SSE2__
+    // Four cells at a time: illegal cells are blended to -inf before the max
+    static const int lane_bits[4] = {1, 2, 4, 8};
+    const __m128i lanes = _mm_loadu_si128((const __m128i*)lane_bits);
+    const __m128 minus_inf = _mm_set1_ps(-INFINITY);
+    __m128 best4 = minus_inf;
+    for (; cell + 4 <= num_cells; cell += 4) {
+        __m128i nibble = _mm_set1_epi32((int)(legal >> cell & 15));
+        __m128 mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(nibble, lanes), lanes));
+        __m128 values = _mm_loadu_ps(q + cell);
+        best4 = _mm_max_ps(best4, _mm_or_ps(_mm_and_ps(mask, values), _mm_andnot_ps(mask, minus_inf)));
+    }
+    best4 = _mm_max_ps(best4, _mm_shuffle_ps(best4, best4, _MM_SHUFFLE(2, 3, 0, 1)));
+    best4 = _mm_max_ps(best4, _mm_shuffle_ps(best4, best4, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm_cvtss_f32(best4);
+#endif
+    for (; cell < num_cells; cell++) {
+        if ((legal >> cell & 1) && q[cell] > best)
+            best = q[cell];
+    }
+    for (uint64_t bits = legal; bits; bits &= bits - 1) {
+        int c = engine_lowest_cell(bits);
+        if (q[c] >= best)
+            return c;
+    }
+    return engine_lowest_cell(legal);
+}
+
+#endif
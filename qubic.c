@@ -0,0 +1,54 @@
+#include "engine.h"
+#include "qubic.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+_Alignas(16) const uint64_t qubic_lines[QUBIC_NUM_LINES] = {
+    // straight lines: 16 rows, 16 columns and 16 pillars
+    0x000000000000000fULL, 0x00000000000000f0ULL, 0x0000000000000f00ULL, 0x0000000000001111ULL,
+    0x0000000000002222ULL, 0x0000000000004444ULL, 0x0000000000008888ULL, 0x000000000000f000ULL,
+    0x00000000000f0000ULL, 0x0000000000f00000ULL, 0x000000000f000000ULL, 0x0000000011110000ULL,
+    0x0000000022220000ULL, 0x0000000044440000ULL, 0x0000000088880000ULL, 0x00000000f0000000ULL,
+    0x0000000f00000000ULL, 0x000000f000000000ULL, 0x00000f0000000000ULL, 0x0000111100000000ULL,
+    0x0000222200000000ULL, 0x0000444400000000ULL, 0x0000888800000000ULL, 0x0000f00000000000ULL,
+    0x0001000100010001ULL, 0x0002000200020002ULL, 0x0004000400040004ULL, 0x0008000800080008ULL,
+    0x000f000000000000ULL, 0x0010001000100010ULL, 0x0020002000200020ULL, 0x0040004000400040ULL,
+    0x0080008000800080ULL, 0x00f0000000000000ULL, 0x0100010001000100ULL, 0x0200020002000200ULL,
+    0x0400040004000400ULL, 0x0800080008000800ULL, 0x0f00000000000000ULL, 0x1000100010001000ULL,
+    0x1111000000000000ULL, 0x2000200020002000ULL, 0x2222000000000000ULL, 0x4000400040004000ULL,
+    0x4444000000000000ULL, 0x8000800080008000ULL, 0x8888000000000000ULL, 0xf000000000000000ULL,
+    // both diagonals of each of the 12 axis-aligned planes (24)
+    0x0000000000001248ULL, 0x0000000000008421ULL, 0x0000000012480000ULL, 0x0000000084210000ULL,
+    0x0000124800000000ULL, 0x0000842100000000ULL, 0x0001000200040008ULL, 0x0001001001001000ULL,
+    0x0002002002002000ULL, 0x0004004004004000ULL, 0x0008000400020001ULL, 0x0008008008008000ULL,
+    0x0010002000400080ULL, 0x0080004000200010ULL, 0x0100020004000800ULL, 0x0800040002000100ULL,
+    0x1000010000100001ULL, 0x1000200040008000ULL, 0x1248000000000000ULL, 0x2000020000200002ULL,
+    0x4000040000400004ULL, 0x8000080000800008ULL, 0x8000400020001000ULL, 0x8421000000000000ULL,
+    // the 4 space diagonals
+    0x0001002004008000ULL, 0x0008004002001000ULL, 0x1000020000400008ULL, 0x8000040000200001ULL,
+};
+
+bool qubic_is_win(uint64_t stones) {
+    if (engine_popcount(stones) < QUBIC_SIZE)
+        return false;
+#ifdef __SSE2__
+    // SSE2 has no 64-bit compare, so a line is complete when both of its
+    // 32-bit halves compare equal
+    const __m128i all = _mm_set1_epi64x((long long)stones);
+    __m128i found = _mm_setzero_si128();
+    for (int i = 0; i < QUBIC_NUM_LINES; i += 2) {
+        __m128i lines = _mm_load_si128((const __m128i*)&qubic_lines[i]);
+        __m128i equal = _mm_cmpeq_epi32(_mm_and_si128(all, lines), lines);
+        found = _mm_or_si128(found, _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1))));
+    }
+    return _mm_movemask_epi8(found) != 0;
+#else
+    for (int i = 0; i < QUBIC_NUM_LINES; i++) {
+        if ((stones & qubic_lines[i]) == qubic_lines[i])
+            return true;
+    }
+    return false;
+#endif
+}
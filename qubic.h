@@ -0,0 +1,19 @@
+#ifndef QUBIC_H
+#define QUBIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Qubic: 4x4x4 tic-tac-toe, four in a row along any of 76 lines. Cell n is
+// layer n / 16, row n / 4 % 4, column n % 4, so a whole side fits in one
+// uint64_t and each layer is a flat 4x4 board.
+#define QUBIC_SIZE 4
+#define QUBIC_NUM_CELLS 64
+#define QUBIC_NUM_LINES 76
+
+extern const uint64_t qubic_lines[QUBIC_NUM_LINES];
+
+// Check every line at once: two lines per SSE2 compare, no early exit
+bool qubic_is_win(uint64_t stones);
+
+#endif
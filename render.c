@@ -0,0 +1,119 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "render.h"
+#include "timer.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
+int render_init(Renderer* renderer, int fd, RenderLevel level, long sample_every) {
+    memset(renderer, 0, sizeof(*renderer));
+    renderer->buffer = malloc(RENDER_BUFFER_SIZE);
+    if (renderer->buffer == NULL)
+        return -1;
+    renderer->capacity = RENDER_BUFFER_SIZE;
+    renderer->fd = fd;
+    renderer->level = level;
+    renderer->sample_every = sample_every > 0 ? sample_every : 1;
+    renderer->progress_interval = 1.0;
+    renderer->start = monotonic_seconds();
+    renderer->last_progress = renderer->start;
+    return 0;
+}
+
+void render_free(Renderer* renderer) {
+    render_flush(renderer);
+    free(renderer->buffer);
+    renderer->buffer = NULL;
+}
+
+static void write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        long written = write(fd, data, length);
+        if (written <= 0)
+            return;
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+// Function to hand the buffered text to the kernel in one write
+void render_flush(Renderer* renderer) {
+    if (renderer->length > 0)
+        write_all(renderer->fd, renderer->buffer, renderer->length);
+    renderer->length = 0;
+}
+
+void render_printf(Renderer* renderer, const char* format, ...) {
+    if (renderer->level == RENDER_SILENT)
+        return;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_list args;
+        va_start(args, format);
+        size_t space = renderer->capacity - renderer->length;
+        int needed = vsnprintf(renderer->buffer + renderer->length, space, format, args);
+        va_end(args);
+        if (needed < 0)
+            return;
+        if ((size_t)needed < space) {
+            renderer->length += (size_t)needed;
+            return;
+        }
+        render_flush(renderer);
+    }
+}
+
+// Function to format the board, same layout as print_board()
+void render_board(Renderer* renderer, const Game* game, Position pos) {
+    char text[ENGINE_BOARD_TEXT_SIZE];
+    game_format_board(game, pos, text, sizeof(text));
+    render_printf(renderer, "%s", text);
+}
+
+// Record a finished game and emit a progress line when one is due
+void render_game_finished(Renderer* renderer, int outcome) {
+    int kind = outcome == OUTCOME_X_WINS ? 0 : outcome == OUTCOME_O_WINS ? 1 : 2;
+    int slot = (int)(renderer->games % RENDER_ROLLING_GAMES);
+    if (renderer->games >= RENDER_ROLLING_GAMES)
+        renderer->recent_counts[renderer->recent[slot]]--;
+    renderer->recent[slot] = (unsigned char)kind;
+    renderer->recent_counts[kind]++;
+    renderer->games++;
+
+    if (renderer->level == RENDER_SILENT || renderer->progress_interval <= 0)
+        return;
+    // Looking at the clock every game would cost more than the game itself
+    if ((renderer->games & 255) != 0)
+        return;
+    double now = monotonic_seconds();
+    if (now - renderer->last_progress < renderer->progress_interval)
+        return;
+
+    long window = renderer->games < RENDER_ROLLING_GAMES ? renderer->games : RENDER_ROLLING_GAMES;
+    double rate = (renderer->games - renderer->last_progress_games) / (now - renderer->last_progress);
+    render_printf(renderer, "[%8.1fs] episodes %ld | %.0f episodes/s | last %ld: X %.1f%% O %.1f%% draw %.1f%%\n",
+                  now - renderer->start, renderer->games, rate, window,
+                  100.0 * renderer->recent_counts[0] / window, 100.0 * renderer->recent_counts[1] / window,
+                  100.0 * renderer->recent_counts[2] / window);
+    render_flush(renderer);
+    renderer->last_progress = now;
+    renderer->last_progress_games = renderer->games;
+}
+
+// Parse "silent", "summary", "sampled" or "all"
+int render_parse_level(const char* name, RenderLevel* level) {
+    static const char* names[] = {"silent", "summary", "sampled", "all"};
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *level = (RenderLevel)i;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,50 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "engine.h"
+
+#define RENDER_BUFFER_SIZE (1 << 20)
+#define RENDER_ROLLING_GAMES 1000
+
+typedef enum {
+    RENDER_SILENT,   // nothing at all
+    RENDER_SUMMARY,  // progress lines and final summaries only
+    RENDER_SAMPLED,  // plus every sample_every-th game in full
+    RENDER_ALL       // every game in full
+} RenderLevel;
+
+// Text goes to an in-memory buffer and reaches the file descriptor with a
+// single write() when the buffer fills up or on render_flush().
+typedef struct {
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    int fd;
+    RenderLevel level;
+    long sample_every;
+    double progress_interval;  // seconds between progress lines, 0 for none
+    double start;
+    double last_progress;
+    long games;
+    long last_progress_games;
+    unsigned char recent[RENDER_ROLLING_GAMES];  // outcome of the last games, as X/O/draw
+    int recent_counts[3];
+} Renderer;
+
+int render_init(Renderer* renderer, int fd, RenderLevel level, long sample_every);
+void render_free(Renderer* renderer);
+void render_flush(Renderer* renderer);
+void render_printf(Renderer* renderer, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void render_board(Renderer* renderer, const Game* game, Position pos);
+
+// Whether the game about to be played (numbered from 0) is shown in full
+static inline bool render_game_visible(const Renderer* renderer, long game) {
+    return renderer->level == RENDER_ALL || (renderer->level == RENDER_SAMPLED && game % renderer->sample_every == 0);
+}
+
+void render_game_finished(Renderer* renderer, int outcome);
+int render_parse_level(const char* name, RenderLevel* level);
+
+#endif
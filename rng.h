@@ -0,0 +1,36 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// splitmix64: small, seedable and cheap enough for the move path
+typedef struct {
+    uint64_t state;
+} Rng;
+
+static inline uint64_t rng_mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline void rng_seed(Rng* rng, uint64_t seed) {
+    rng->state = seed;
+}
+
+static inline uint64_t rng_next(Rng* rng) {
+    rng->state += 0x9e3779b97f4a7c15ULL;
+    return rng_mix(rng->state);
+}
+
+// Uniform float in [0, 1)
+static inline float rng_uniform(Rng* rng) {
+    return (float)(rng_next(rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+// Uniform integer in [0, n)
+static inline uint32_t rng_below(Rng* rng, uint32_t n) {
+    return (uint32_t)(((rng_next(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+#endif
@@ -0,0 +1,328 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "search.h"
+#include "timer.h"
+#include "zobrist.h"
+
+#define SEARCH_INFINITY (SEARCH_WIN + 1)
+#define SEARCH_MATE_BOUND (SEARCH_WIN - ENGINE_MAX_CELLS - 1) // scores beyond this are forced results
+
+// Bound types of a table entry; an empty entry (data 0) has none
+#define BOUND_UPPER 1
+#define BOUND_LOWER 2
+#define BOUND_EXACT 3
+#define NO_MOVE 0xff
+
+// Entry data: score in bits 0-31, depth 32-39, bound 40-47, move 48-55,
+// generation 56-63
+#define ENTRY_SCORE(data) ((int32_t)(uint32_t)(data))
+#define ENTRY_DEPTH(data) ((int)((data) >> 32 & 0xff))
+#define ENTRY_BOUND(data) ((int)((data) >> 40 & 0xff))
+#define ENTRY_MOVE(data) ((int)((data) >> 48 & 0xff))
+#define ENTRY_GENERATION(data) ((uint8_t)((data) >> 56))
+
+typedef struct {
+    const Game* game;
+    uint64_t deadline; // monotonic ns, 0 for none
+    uint64_t nodes;
+    bool stopped;
+    SearchTable* table;
+    uint8_t generation;
+    _Atomic bool* stop; // set when the main thread is done
+} Searcher;
+
+int search_table_init(SearchTable* table, size_t bytes) {
+    uint64_t buckets = 1;
+    while (buckets * 2 * sizeof(SearchBucket) <= bytes)
+        buckets *= 2;
+    table->buckets = aligned_alloc(64, buckets * sizeof(SearchBucket));
+    if (table->buckets == NULL)
+        return -1;
+    table->mask = buckets - 1;
+    search_table_clear(table);
+    return 0;
+}
+
+void search_table_clear(SearchTable* table) {
+    memset(table->buckets, 0, (table->mask + 1) * sizeof(SearchBucket));
+    atomic_store(&table->generation, 0);
+}
+
+void search_table_free(SearchTable* table) {
+    free(table->buckets);
+    table->buckets = NULL;
+}
+
+// Function to find a position's entry, returning its data or 0 for none.
+// Forced results are stored as distances from the position, not the root.
+static uint64_t table_probe(const Searcher* searcher, uint64_t key) {
+    SearchEntry* entries = searcher->table->buckets[key & searcher->table->mask].entries;
+    for (int i = 0; i < SEARCH_BUCKET_ENTRIES; i++) {
+        uint64_t data = atomic_load_explicit(&entries[i].data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&entries[i].check, memory_order_relaxed);
+        if (data != 0 && (check ^ data) == key)
+            return data;
+    }
+    return 0;
+}
+
+static void table_store(const Searcher* searcher, uint64_t key, int depth, int bound, int score, int move, int ply) {
+    SearchEntry* entries = searcher->table->buckets[key & searcher->table->mask].entries;
+    SearchEntry* victim = &entries[0];
+    int victim_worth = SEARCH_INFINITY;
+    for (int i = 0; i < SEARCH_BUCKET_ENTRIES; i++) {
+        uint64_t data = atomic_load_explicit(&entries[i].data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&entries[i].check, memory_order_relaxed);
+        int age = (uint8_t)(searcher->generation - ENTRY_GENERATION(data));
+        if (data != 0 && (check ^ data) == key) {
+            if (depth < ENTRY_DEPTH(data) && age == 0)
+                return;
+            victim = &entries[i];
+            break;
+        }
+        int worth = data == 0 ? -1 - SEARCH_INFINITY / 2 : ENTRY_DEPTH(data) - ENGINE_MAX_CELLS * age;
+        if (worth < victim_worth) {
+            victim_worth = worth;
+            victim = &entries[i];
+        }
+    }
+    if (score > SEARCH_MATE_BOUND)
+        score += ply;
+    else if (score < -SEARCH_MATE_BOUND)
+        score -= ply;
+    uint64_t data = (uint32_t)score | (uint64_t)depth << 32 | (uint64_t)bound << 40 | (uint64_t)(move < 0 ? NO_MOVE : move) << 48 |
+                    (uint64_t)searcher->generation << 56;
+    atomic_store_explicit(&victim->data, data, memory_order_relaxed);
+    atomic_store_explicit(&victim->check, key ^ data, memory_order_relaxed);
+}
+
+// Function to score a position for the side to move at the depth limit:
+// every line still open to only one side counts for that side, 4x more per
+// stone already on it
+static int evaluate(const Game* game, Position pos) {
+    int side = position_side_to_move(pos);
+    uint64_t mine = position_stones(pos, side), theirs = position_stones(pos, side ^ 1);
+    int score = 0;
+    for (int i = 0; i < game->num_lines; i++) {
+        uint64_t line = game->lines[i];
+        int m = engine_popcount(mine & line), t = engine_popcount(theirs & line);
+        if (t == 0 && m > 0)
+            score += 1 << (2 * (m - 1));
+        else if (m == 0 && t > 0)
+            score -= 1 << (2 * (t - 1));
+    }
+    return score;
+}
+
+// Cells where stones would complete a line
+static uint64_t winning_cells(const Game* game, uint64_t stones, uint64_t empty) {
+    uint64_t wins = 0;
+    for (uint64_t bits = empty; bits; bits &= bits - 1) {
+        int cell = engine_lowest_cell(bits);
+        if (game_move_wins(game, stones | (1ULL << cell), cell))
+            wins |= 1ULL << cell;
+    }
+    return wins;
+}
+
+static bool out_of_time(Searcher* searcher) {
+    if ((++searcher->nodes & (SEARCH_CHECK_INTERVAL - 1)) == 0 &&
+        ((searcher->deadline != 0 && monotonic_ns() >= searcher->deadline) ||
+         atomic_load_explicit(searcher->stop, memory_order_relaxed)))
+        searcher->stopped = true;
+    return searcher->stopped;
+}
+
+// Negamax with alpha-beta. The last move did not end the game. Only the
+// moves that matter are searched: a win on the spot ends the search, and a
+// threat by the opponent has to be blocked. With a table, a deep enough
+// entry can answer the position outright, and otherwise its move goes first.
+static int negamax(Searcher* searcher, Position pos, uint64_t hash, int depth, int ply, int alpha, int beta) {
+    if (out_of_time(searcher))
+        return 0;
+    const Game* game = searcher->game;
+    uint64_t empty = position_empty(game, pos);
+    if (empty == 0)
+        return 0;
+    int side = position_side_to_move(pos);
+    if (winning_cells(game, position_stones(pos, side), empty) != 0)
+        return SEARCH_WIN - (ply + 1);
+    if (depth == 0)
+        return evaluate(game, pos);
+
+    uint64_t moves = empty;
+    uint64_t threats = winning_cells(game, position_stones(pos, side ^ 1), empty);
+    if (engine_popcount(threats) > 1)
+        return -(SEARCH_WIN - (ply + 2)); // two threats cannot both be blocked
+    if (threats != 0)
+        moves = threats;
+
+    uint64_t first = 0;
+    if (searcher->table != NULL) {
+        uint64_t data = table_probe(searcher, hash);
+        if (data != 0) {
+            int score = ENTRY_SCORE(data), bound = ENTRY_BOUND(data);
+            if (score > SEARCH_MATE_BOUND)
+                score -= ply;
+            else if (score < -SEARCH_MATE_BOUND)
+                score += ply;
+            if (ENTRY_DEPTH(data) >= depth && (bound == BOUND_EXACT || (bound == BOUND_LOWER && score >= beta) ||
+                                               (bound == BOUND_UPPER && score <= alpha)))
+                return score;
+            if (ENTRY_MOVE(data) != NO_MOVE)
+                first = moves & (1ULL << ENTRY_MOVE(data));
+        }
+    }
+
+    int best = -SEARCH_INFINITY, best_move = -1, alpha_start = alpha;
+    while (moves) {
+        int cell = engine_lowest_cell(first & moves ? first : moves);
+        moves &= ~(1ULL << cell);
+        position_make(&pos, side, cell);
+        int score = -negamax(searcher, pos, zobrist_toggle(game, hash, side, cell), depth - 1, ply + 1, -beta, -alpha);
+        position_unmake(&pos, cell);
+        if (searcher->stopped)
+            return 0;
+        if (score > best) {
+            best = score;
+            best_move = cell;
+        }
+        if (score > alpha)
+            alpha = score;
+        if (alpha >= beta)
+            break;
+    }
+    if (searcher->table != NULL)
+        table_store(searcher, hash, depth, best >= beta ? BOUND_LOWER : best > alpha_start ? BOUND_EXACT : BOUND_UPPER, best,
+                    best_move, ply);
+    return best;
+}
+
+// The root, shared by every thread of a search
+typedef struct {
+    const Game* game;
+    Position pos;
+    uint64_t hash;
+    const SearchLimits* limits;
+    uint64_t start;
+    uint8_t moves[ENGINE_MAX_CELLS];
+    int num_moves;
+    int max_depth;
+    _Atomic bool stop;
+} SearchRoot;
+
+typedef struct {
+    SearchRoot* root;
+    int index; // 0 for the main thread
+    Searcher searcher;
+    SearchResult result;
+} SearchThread;
+
+// Function to deepen one thread's search until it runs out of depth or time,
+// or the main thread is done. Helpers take the root moves rotated by their
+// index and odd ones start a ply deeper, so they spread over the tree rather
+// than repeat the main thread's work.
+static void* deepen(void* arg) {
+    SearchThread* thread = arg;
+    SearchRoot* root = thread->root;
+    Searcher* searcher = &thread->searcher;
+    SearchResult* result = &thread->result;
+    const Game* game = root->game;
+    int side = position_side_to_move(root->pos), num_moves = root->num_moves;
+    uint8_t moves[ENGINE_MAX_CELLS];
+    for (int i = 0; i < num_moves; i++)
+        moves[i] = root->moves[(i + thread->index) % num_moves];
+
+    for (int depth = 1 + (thread->index & 1); depth <= root->max_depth; depth++) {
+        // An iteration takes several times longer than the one before, so
+        // there is no point starting one past half the budget
+        if (depth > 1 && searcher->deadline != 0 && monotonic_ns() - root->start > root->limits->budget_ns / 2)
+            break;
+
+        int best = -SEARCH_INFINITY, best_index = 0;
+        for (int i = 0; i < num_moves; i++) {
+            Position child = root->pos;
+            position_make(&child, side, moves[i]);
+            int score = -negamax(searcher, child, zobrist_toggle(game, root->hash, side, moves[i]), depth - 1, 1,
+                                 -SEARCH_INFINITY, -best);
+            if (searcher->stopped)
+                break;
+            if (score > best) {
+                best = score;
+                best_index = i;
+            }
+        }
+        if (searcher->stopped) {
+            result->timed_out = true;
+            break;
+        }
+
+        // Finished: keep its answer and try its best move first next time
+        uint8_t first = moves[best_index];
+        memmove(&moves[1], &moves[0], (size_t)best_index);
+        moves[0] = first;
+        result->best_move = first;
+        result->score = best;
+        result->depth = depth;
+        result->solved = best > SEARCH_MATE_BOUND || best < -SEARCH_MATE_BOUND || depth >= engine_popcount(position_empty(game, root->pos));
+        if (result->solved)
+            break;
+    }
+    return NULL;
+}
+
+int search_best_move(const Game* game, Position pos, const SearchLimits* limits, SearchResult* result) {
+    uint64_t start = monotonic_ns();
+    SearchRoot root = {.game = game, .pos = pos, .hash = zobrist_hash(game, pos), .limits = limits, .start = start};
+    atomic_init(&root.stop, false);
+    memset(result, 0, sizeof(*result));
+    result->best_move = -1;
+
+    uint64_t empty = position_empty(game, pos);
+    int side = position_side_to_move(pos);
+    uint64_t wins = winning_cells(game, position_stones(pos, side), empty);
+    uint64_t threats = winning_cells(game, position_stones(pos, side ^ 1), empty);
+    if (wins != 0) {
+        result->best_move = engine_lowest_cell(wins);
+        result->score = SEARCH_WIN - 1;
+        result->solved = true;
+    } else {
+        // With a threat to block, that is the only move worth searching
+        for (uint64_t bits = threats != 0 ? threats : empty; bits; bits &= bits - 1)
+            root.moves[root.num_moves++] = (uint8_t)engine_lowest_cell(bits);
+        if (root.num_moves > 0)
+            result->best_move = root.moves[0];
+    }
+    root.max_depth = limits->max_depth > 0 ? limits->max_depth : engine_popcount(empty);
+
+    if (root.num_moves > 0 && !result->solved) {
+        int num_threads = limits->num_threads < 1 ? 1 : limits->num_threads;
+        if (num_threads > SEARCH_MAX_THREADS)
+            num_threads = SEARCH_MAX_THREADS;
+        uint8_t generation = 0;
+        if (limits->table != NULL)
+            generation = (uint8_t)(atomic_fetch_add(&limits->table->generation, 1) + 1);
+        pthread_t handles[SEARCH_MAX_THREADS];
+        SearchThread threads[SEARCH_MAX_THREADS];
+        bool started[SEARCH_MAX_THREADS];
+        for (int t = 0; t < num_threads; t++) {
+            Searcher searcher = {game, limits->budget_ns != 0 ? start + limits->budget_ns : 0, 0, false, limits->table, generation, &root.stop};
+            threads[t] = (SearchThread){&root, t, searcher, *result};
+            started[t] = t > 0 && pthread_create(&handles[t], NULL, deepen, &threads[t]) == 0;
+        }
+        deepen(&threads[0]);
+        atomic_store(&root.stop, true);
+        uint64_t nodes = threads[0].searcher.nodes;
+        for (int t = 1; t < num_threads; t++) {
+            if (started[t]) {
+                pthread_join(handles[t], NULL);
+                nodes += threads[t].searcher.nodes;
+            }
+        }
+        *result = threads[0].result;
+        result->nodes = nodes;
+    }
+    result->seconds = (monotonic_ns() - start) * 1e-9;
+    return result->best_move;
+}
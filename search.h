@@ -0,0 +1,76 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+#define SEARCH_WIN 1000000000     // score of a win on the spot; each ply towards it costs 1
+#define SEARCH_CHECK_INTERVAL 64   // nodes between clock reads, a power of two
+#define SEARCH_MAX_THREADS 64
+#define SEARCH_TABLE_DEFAULT_MB 16
+#define SEARCH_BUCKET_ENTRIES 4    // entries per 64-byte bucket
+
+// A transposition table entry. data packs the score, depth, bound, best move
+// and generation; check is the position's hash XOR data. Two threads writing
+// one entry at once can leave the halves of different stores behind, which
+// fails the check and reads as a miss, so the table needs no locks.
+typedef struct {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+} SearchEntry;
+
+typedef struct {
+    _Alignas(64) SearchEntry entries[SEARCH_BUCKET_ENTRIES];
+} SearchBucket;
+
+// Transposition table shared by every thread of a search and kept from one
+// move to the next. A bucket keeps the deepest results: a new one replaces
+// the entry of the same position only if it is at least as deep, and
+// otherwise the shallowest entry, entries from earlier searches counting as
+// shallower the older they are. Separate searches may share a table too:
+// each takes its own generation with an atomic bump.
+typedef struct {
+    SearchBucket* buckets;
+    uint64_t mask;               // buckets - 1, a power of two
+    _Atomic uint8_t generation;  // bumped by every search
+} SearchTable;
+
+// Allocate a table of at most bytes (at least one bucket), all empty
+int search_table_init(SearchTable* table, size_t bytes);
+void search_table_clear(SearchTable* table);
+void search_table_free(SearchTable* table);
+
+typedef struct {
+    uint64_t budget_ns; // time allowed for the whole move, 0 for none
+    int max_depth;      // plies, 0 for as deep as the board allows
+    int num_threads;    // threads searching the root together, 0 or 1 for one
+    SearchTable* table; // transposition table, NULL for none
+} SearchLimits;
+
+typedef struct {
+    int best_move;  // -1 only if the board is full
+    int score;      // for the side to move, from the deepest finished iteration
+    int depth;      // deepest iteration that finished
+    bool solved;    // the score is exact: a forced win or loss, or a full-depth search
+    bool timed_out; // the deadline cut an iteration short
+    uint64_t nodes;
+    double seconds;
+} SearchResult;
+
+// Anytime search: iterative-deepening alpha-beta (negamax), each iteration
+// trying the previous one's best move first. The deadline is checked every
+// SEARCH_CHECK_INTERVAL nodes; when it passes, the iteration in progress is
+// thrown away and the best move of the last finished one is returned.
+//
+// With more than one thread the search is Lazy SMP: helper threads search the
+// same root in their own order, half of them a ply deeper, and pass what they
+// find to the main thread only through the transposition table. The main
+// thread's answer is returned and the helpers stop when it has one; nodes
+// counts the work of all of them. Without a table helpers only add load.
+// Returns the move, or -1 if there is none.
+int search_best_move(const Game* game, Position pos, const SearchLimits* limits, SearchResult* result);
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "engine.h"
+#include "rng.h"
+#include "search.h"
+#include "timer.h"
+
+#define BENCH_POSITIONS 8
+
+// Function to fill positions with short random openings, the first one empty
+static void random_openings(const Game* game, Position* positions, int count, uint64_t seed) {
+    Rng rng;
+    rng_seed(&rng, seed);
+    for (int i = 0; i < count; i++) {
+        Position pos = {0, 0};
+        for (int ply = 0; ply < (i == 0 ? 0 : 2 + i % 3); ply++) {
+            uint64_t empty = position_empty(game, pos);
+            position_make(&pos, position_side_to_move(pos), engine_select_cell(empty, (int)rng_below(&rng, (uint32_t)engine_popcount(empty))));
+        }
+        positions[i] = pos;
+    }
+}
+
+// Benchmark Lazy SMP: time to a fixed depth over a set of openings with 1,
+// 2, 4... threads sharing a fresh transposition table, as a speedup over one
+// thread, and how many answers agree with one thread's. A 0 MB table
+// searches without one.
+// Usage: search_bench [size] [win_length] [depth] [max_threads] [table_mb]
+int main(int argc, char* argv[]) {
+    int size = argc > 1 ? atoi(argv[1]) : 4;
+    int win_length = argc > 2 ? atoi(argv[2]) : size;
+    int depth = argc > 3 ? atoi(argv[3]) : 7;
+    int max_threads = argc > 4 ? atoi(argv[4]) : 4;
+    int table_mb = argc > 5 ? atoi(argv[5]) : SEARCH_TABLE_DEFAULT_MB;
+
+    Game game;
+    if (game_init(&game, size, win_length) != 0) {
+        printf("Error: Unsupported board %dx%d with %d in a row.\n", size, size, win_length);
+        return 1;
+    }
+    SearchTable table = {NULL, 0, 0};
+    if (table_mb > 0 && search_table_init(&table, (size_t)table_mb << 20) != 0) {
+        printf("Error: Unable to allocate the transposition table.\n");
+        return 1;
+    }
+    Position positions[BENCH_POSITIONS];
+    random_openings(&game, positions, BENCH_POSITIONS, 1);
+
+    printf("%dx%d board, %d in a row, depth %d, %d positions, %d MB table\n", size, size, game.win_length, depth, BENCH_POSITIONS, table_mb);
+    printf("threads   seconds   Mnodes  Mnodes/s  speedup  same move  same score\n");
+    int moves[BENCH_POSITIONS], scores[BENCH_POSITIONS];
+    double single = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        SearchLimits limits = {0, depth, threads, table_mb > 0 ? &table : NULL};
+        if (table_mb > 0)
+            search_table_clear(&table);
+        uint64_t nodes = 0;
+        int same_move = 0, same_score = 0;
+        double start = monotonic_seconds();
+        for (int i = 0; i < BENCH_POSITIONS; i++) {
+            SearchResult result;
+            int move = search_best_move(&game, positions[i], &limits, &result);
+            nodes += result.nodes;
+            if (threads == 1) {
+                moves[i] = move;
+                scores[i] = result.score;
+            }
+            same_move += move == moves[i];
+            same_score += result.score == scores[i];
+        }
+        double seconds = monotonic_seconds() - start;
+        if (threads == 1)
+            single = seconds;
+        printf("%7d  %8.3f  %7.2f  %8.2f  %7.2f  %9d  %10d\n", threads, seconds, nodes * 1e-6, nodes * 1e-6 / seconds,
+               single / seconds, same_move, same_score);
+    }
+    if (table_mb > 0)
+        search_table_free(&table);
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static uint64_t checksum(const void* data, uint64_t size) {
+    const unsigned char* bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint64_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+void snapshot_init(Snapshotter* snapshotter, const char* path) {
+    memset(snapshotter, 0, sizeof(*snapshotter));
+    snprintf(snapshotter->path, sizeof(snapshotter->path), "%s", path);
+}
+
+#ifndef _WIN32
+
+static int write_all(int fd, const void* data, uint64_t size) {
+    const char* bytes = data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written <= 0)
+            return -1;
+        bytes += written;
+        size -= (uint64_t)written;
+    }
+    return 0;
+}
+
+// Function to write the sections to path.tmp, flush them to disk and rename
+// the file over path. Runs in the forked child, so it sticks to system calls.
+static int write_snapshot(const char* path, const SnapshotSection* sections, int count) {
+    char temp[SNAPSHOT_MAX_PATH + 8];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+    header.version = SNAPSHOT_VERSION;
+    header.num_sections = (uint32_t)count;
+    int status = write_all(fd, &header, sizeof(header));
+    for (int i = 0; i < count && status == 0; i++) {
+        SnapshotEntry entry = {sections[i].id, 0, sections[i].size, checksum(sections[i].data, sections[i].size)};
+        status = write_all(fd, &entry, sizeof(entry)) == 0 && write_all(fd, sections[i].data, sections[i].size) == 0 ? 0 : -1;
+    }
+    if (status == 0 && fsync(fd) != 0)
+        status = -1;
+    if (close(fd) != 0)
+        status = -1;
+    if (status == 0 && rename(temp, path) != 0)
+        status = -1;
+    if (status != 0)
+        unlink(temp);
+    return status;
+}
+
+int snapshot_wait(Snapshotter* snapshotter) {
+    if (snapshotter->writer == 0)
+        return 0;
+    int result;
+    pid_t pid = waitpid((pid_t)snapshotter->writer, &result, 0);
+    snapshotter->writer = 0;
+    if (pid < 0 || !WIFEXITED(result) || WEXITSTATUS(result) != 0) {
+        snapshotter->failed++;
+        printf("Error: Unable to write the snapshot %s.\n", snapshotter->path);
+        return -1;
+    }
+    snapshotter->written++;
+    return 0;
+}
+
+int snapshot_save(Snapshotter* snapshotter, const SnapshotSection* sections, int count) {
+    if (count > SNAPSHOT_MAX_SECTIONS)
+        return -1;
+    if (snapshotter->writer != 0) {
+        int result;
+        pid_t pid = waitpid((pid_t)snapshotter->writer, &result, WNOHANG);
+        if (pid == 0) {
+            snapshotter->skipped++;
+            return 1;
+        }
+        snapshotter->writer = 0;
+        if (pid < 0 || !WIFEXITED(result) || WEXITSTATUS(result) != 0) {
+            snapshotter->failed++;
+            printf("Error: Unable to write the snapshot %s.\n", snapshotter->path);
+        } else {
+            snapshotter->written++;
+        }
+    }
+
+    fflush(stdout); // or the child's exit would print buffered output twice
+    pid_t pid = fork();
+    if (pid < 0) {
+        printf("Error: Unable to start the snapshot writer.\n");
+        return -1;
+    }
+    if (pid == 0)
+        _exit(write_snapshot(snapshotter->path, sections, count) == 0 ? 0 : 1);
+    snapshotter->writer = pid;
+    return 0;
+}
+
+#else
+
+// No fork here: write in place, still through a temporary file
+static int write_snapshot(const char* path, const SnapshotSection* sections, int count) {
+    char temp[SNAPSHOT_MAX_PATH + 8];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE* file = fopen(temp, "wb");
+    if (file == NULL)
+        return -1;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+    header.version = SNAPSHOT_VERSION;
+    header.num_sections = (uint32_t)count;
+    int status = fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+    for (int i = 0; i < count && status == 0; i++) {
+        SnapshotEntry entry = {sections[i].id, 0, sections[i].size, checksum(sections[i].data, sections[i].size)};
+        status = fwrite(&entry, sizeof(entry), 1, file) == 1 &&
+                 fwrite(sections[i].data, 1, sections[i].size, file) == sections[i].size ? 0 : -1;
+    }
+    if (fclose(file) != 0)
+        status = -1;
+    remove(path);
+    if (status == 0 && rename(temp, path) != 0)
+        status = -1;
+    return status;
+}
+
+int snapshot_wait(Snapshotter* snapshotter) {
+    return 0;
+}
+
+int snapshot_save(Snapshotter* snapshotter, const SnapshotSection* sections, int count) {
+    if (count > SNAPSHOT_MAX_SECTIONS || write_snapshot(snapshotter->path, sections, count) != 0) {
+        snapshotter->failed++;
+        printf("Error: Unable to write the snapshot %s.\n", snapshotter->path);
+        return -1;
+    }
+    snapshotter->written++;
+    return 0;
+}
+
+#endif
+
+int snapshot_load(const char* path, const SnapshotSection* sections, int count) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: Unable to open %s for reading.\n", path);
+        return -1;
+    }
+    SnapshotHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, SNAPSHOT_MAGIC, 4) != 0 ||
+        header.version != SNAPSHOT_VERSION) {
+        printf("Error: %s is not a version %d snapshot.\n", path, SNAPSHOT_VERSION);
+        fclose(file);
+        return -1;
+    }
+
+    bool found[SNAPSHOT_MAX_SECTIONS] = {false};
+    int status = 0;
+    for (uint32_t s = 0; s < header.num_sections && status == 0; s++) {
+        SnapshotEntry entry;
+        if (fread(&entry, sizeof(entry), 1, file) != 1) {
+            status = -1;
+            break;
+        }
+        int match = -1;
+        for (int i = 0; i < count && i < SNAPSHOT_MAX_SECTIONS; i++) {
+            if (sections[i].id == entry.id)
+                match = i;
+        }
+        if (match < 0) {
+            status = fseek(file, (long)entry.size, SEEK_CUR) == 0 ? 0 : -1;
+            continue;
+        }
+        if (entry.size != sections[match].size) {
+            printf("Error: Section %u of %s has %llu bytes, expected %llu.\n", entry.id, path,
+                   (unsigned long long)entry.size, (unsigned long long)sections[match].size);
+            fclose(file);
+            return -1;
+        }
+        if (fread(sections[match].data, 1, entry.size, file) != entry.size ||
+            checksum(sections[match].data, entry.size) != entry.checksum)
+            status = -1;
+        found[match] = true;
+    }
+    fclose(file);
+    for (int i = 0; i < count && status == 0; i++) {
+        if (!found[i])
+            status = -1;
+    }
+    if (status != 0)
+        printf("Error: %s is damaged or incomplete.\n", path);
+    return status;
+}
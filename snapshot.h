@@ -0,0 +1,69 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SNAPSHOT_MAGIC "TTTS"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_MAX_SECTIONS 16
+#define SNAPSHOT_MAX_PATH 256
+
+// Section ids shared by the trainers; a program only lists the ones it keeps
+enum {
+    SNAPSHOT_RUN = 1,         // the program's own counters (generation, epsilon, ...)
+    SNAPSHOT_POPULATION = 2,  // the Population arena, records back to back
+    SNAPSHOT_RNG = 3,
+    SNAPSHOT_CONVERGENCE = 4, // the ConvergenceTracker
+};
+
+// A snapshot file is a header followed by sections, each a SnapshotEntry
+// and then size bytes of data. Every section carries a checksum, and files
+// are only ever renamed into place once complete.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_sections;
+    uint32_t reserved;
+} SnapshotHeader;
+
+typedef struct {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t size;
+    uint64_t checksum; // FNV-1a of the data
+} SnapshotEntry;
+
+// A piece of memory to save or to restore into
+typedef struct {
+    uint32_t id;
+    void* data;
+    uint64_t size;
+} SnapshotSection;
+
+// Writes snapshots in the background. Each save forks a child that writes
+// its copy-on-write view of the sections, so training goes on while the
+// file is written; a save asked for while the last one is still running is
+// skipped rather than waited for.
+typedef struct {
+    char path[SNAPSHOT_MAX_PATH];
+    long writer;   // pid of the running writer, 0 for none
+    int written;
+    int skipped;
+    int failed;
+} Snapshotter;
+
+void snapshot_init(Snapshotter* snapshotter, const char* path);
+
+// Returns 0 when the write started (or, without fork, finished), 1 when it
+// was skipped and -1 on error
+int snapshot_save(Snapshotter* snapshotter, const SnapshotSection* sections, int count);
+
+// Wait for the writer in flight, if any; returns -1 if it failed
+int snapshot_wait(Snapshotter* snapshotter);
+
+// Fill every listed section from the file. Each must be present with the
+// same size; sections in the file that are not listed are skipped.
+int snapshot_load(const char* path, const SnapshotSection* sections, int count);
+
+#endif
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "model.h"
+#include "solver.h"
+#include "state_index.h"
+
+// Compute exact Q-values for every reachable position and save them as a
+// state-indexed model, loadable anywhere a trained q_values.dat is
+// Usage: solve [size] [win_length] [file] [--threads N] [--discount G]
+int main(int argc, char* argv[]) {
+    int positional[2] = {3, 0};
+    int num_positional = 0;
+    const char* filename = NULL;
+    SolverConfig config = {0.9f, 4};
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--discount") == 0 && i + 1 < argc) {
+            config.discount = (float)atof(argv[++i]);
+        } else if (num_positional < 2 && argv[i][0] >= '0' && argv[i][0] <= '9') {
+            positional[num_positional++] = atoi(argv[i]);
+        } else if (filename == NULL && argv[i][0] != '-') {
+            filename = argv[i];
+        } else {
+            printf("Usage: solve [size] [win_length] [file] [--threads N] [--discount G]\n");
+            return 1;
+        }
+    }
+    int size = positional[0];
+    int win_length = num_positional > 1 ? positional[1] : size;
+
+    Game game;
+    if (game_init(&game, size, win_length) != 0) {
+        printf("Error: Unsupported board %dx%d with %d in a row.\n", size, size, win_length);
+        return 1;
+    }
+    char default_name[64];
+    if (filename == NULL) {
+        snprintf(default_name, sizeof(default_name), "q_values_%dx%d_%d.dat", size, size, win_length);
+        filename = default_name;
+    }
+    StateIndex index;
+    QTable table;
+    if (state_index_build(&index, &game) != 0) {
+        printf("Error: Unable to index a %dx%d board (at most %d cells).\n", size, size, STATE_INDEX_MAX_CELLS);
+        return 1;
+    }
+    if (qtable_init_state_indexed(&table, &index) != 0) {
+        printf("Error: Unable to allocate the Q-table.\n");
+        return 1;
+    }
+
+    SolverStats stats;
+    if (solver_solve(&index, &config, &table, &stats) != 0) {
+        printf("Error: Unable to solve the board.\n");
+        return 1;
+    }
+    printf("%dx%d, %d in a row: %u positions (%u up to symmetry) solved in %.3fs on %d threads\n", size, size,
+           win_length, stats.num_states, stats.canonical_states, stats.seconds, config.num_threads);
+
+    // Value of the empty board for X: the best first move's Q-value
+    const float* root = qtable_row(&table, (Position){0, 0}, 0);
+    float best = root[0];
+    for (int cell = 1; cell < game.num_cells; cell++)
+        best = root[cell] > best ? root[cell] : best;
+    printf("Empty board: %s for X (Q = %.4f)\n", best > 0 ? "win" : best < 0 ? "loss" : "draw", best);
+
+    int status = model_save_qtable(filename, &game, &table) == 0 ? 0 : 1;
+    if (status == 0)
+        printf("Model written to %s\n", filename);
+    qtable_free(&table);
+    state_index_free(&index);
+    return status;
+}
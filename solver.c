@@ -0,0 +1,174 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "solver.h"
+#include "timer.h"
+
+#define SOLVER_CHUNK 1024 // positions per work item
+
+// One level being solved by a pool of threads. The first pass solves the
+// canonical positions and notes, for every other one, which canonical
+// position it is an image of; the second copies their rows across.
+typedef struct {
+    const StateIndex* index;
+    const Game* game;
+    float discount;
+    float* q;
+    float* values;          // best Q-value per position, for the level below
+    const uint8_t (*maps)[ENGINE_MAX_CELLS];
+    uint32_t begin;
+    uint32_t end;
+    uint32_t* source;       // per position of the level: its canonical image
+    uint8_t* symmetry;      // and the symmetry that maps it there
+    int pass;
+    _Atomic uint32_t next_chunk;
+    _Atomic uint32_t canonical;
+} LevelJob;
+
+static Position transform(Position pos, const uint8_t* map) {
+    Position image = {0, 0};
+    for (uint64_t bits = pos.x; bits; bits &= bits - 1)
+        image.x |= 1ULL << map[engine_lowest_cell(bits)];
+    for (uint64_t bits = pos.o; bits; bits &= bits - 1)
+        image.o |= 1ULL << map[engine_lowest_cell(bits)];
+    return image;
+}
+
+// Function to fill in the Q-values of one position from the solved level above
+static void solve_position(const LevelJob* job, Position pos, uint32_t rank) {
+    const Game* game = job->game;
+    float* row = job->q + (size_t)rank * game->num_cells;
+    memset(row, 0, game->num_cells * sizeof(float));
+    job->values[rank] = 0;
+    int side = position_side_to_move(pos);
+    if (game_is_win(game, position_stones(pos, side ^ 1)))
+        return;
+    uint64_t empty = position_empty(game, pos);
+    if (empty == 0)
+        return;
+
+    float best = -INFINITY;
+    for (uint64_t bits = empty; bits; bits &= bits - 1) {
+        int cell = engine_lowest_cell(bits);
+        Position child = pos;
+        position_make(&child, side, cell);
+        float q;
+        if (game_move_wins(game, position_stones(child, side), cell))
+            q = 1;
+        else if (position_empty(game, child) == 0)
+            q = 0;
+        else {
+            float reply = job->values[state_index_rank(job->index, child)];
+            q = reply == 0 ? 0 : -job->discount * reply; // a draw stays +0
+        }
+        row[cell] = q;
+        if (q > best)
+            best = q;
+    }
+    job->values[rank] = best;
+}
+
+static void* level_worker(void* arg) {
+    LevelJob* job = arg;
+    int num_cells = job->game->num_cells;
+    uint32_t canonical = 0;
+    for (;;) {
+        uint64_t first = job->begin + (uint64_t)atomic_fetch_add(&job->next_chunk, 1) * SOLVER_CHUNK;
+        if (first >= job->end)
+            break;
+        uint32_t last = first + SOLVER_CHUNK < job->end ? (uint32_t)first + SOLVER_CHUNK : job->end;
+        for (uint32_t rank = (uint32_t)first; rank < last; rank++) {
+            uint32_t slot = rank - job->begin;
+            if (job->pass == 1) {
+                if (job->source[slot] == rank)
+                    continue;
+                const float* from = job->q + (size_t)job->source[slot] * num_cells;
+                float* to = job->q + (size_t)rank * num_cells;
+                const uint8_t* map = job->maps[job->symmetry[slot]];
+                for (int cell = 0; cell < num_cells; cell++)
+                    to[cell] = from[map[cell]];
+                job->values[rank] = job->values[job->source[slot]];
+                continue;
+            }
+
+            // The image with the lowest rank stands for the whole class
+            Position pos = state_index_unrank(job->index, rank);
+            job->source[slot] = rank;
+            job->symmetry[slot] = 0;
+            for (int t = 1; t < ENGINE_NUM_SYMMETRIES; t++) {
+                uint32_t image = state_index_rank(job->index, transform(pos, job->maps[t]));
+                if (image < job->source[slot]) {
+                    job->source[slot] = image;
+                    job->symmetry[slot] = (uint8_t)t;
+                }
+            }
+            if (job->source[slot] == rank) {
+                solve_position(job, pos, rank);
+                canonical++;
+            }
+        }
+    }
+    atomic_fetch_add(&job->canonical, canonical);
+    return NULL;
+}
+
+static void run_pass(LevelJob* job, int pass, int num_threads) {
+    pthread_t threads[SOLVER_MAX_THREADS];
+    bool started[SOLVER_MAX_THREADS];
+    job->pass = pass;
+    atomic_store(&job->next_chunk, 0);
+    for (int t = 1; t < num_threads; t++)
+        started[t] = pthread_create(&threads[t], NULL, level_worker, job) == 0;
+    level_worker(job);
+    for (int t = 1; t < num_threads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+}
+
+int solver_solve(const StateIndex* index, const SolverConfig* config, QTable* table, SolverStats* stats) {
+    const Game* game = index->game;
+    double start = monotonic_seconds();
+    memset(stats, 0, sizeof(*stats));
+    if (table->index != index)
+        return -1;
+    int num_threads = config->num_threads < 1 ? 1 : config->num_threads > SOLVER_MAX_THREADS ? SOLVER_MAX_THREADS : config->num_threads;
+
+    uint32_t widest = 0;
+    for (int level = 0; level <= game->num_cells; level++) {
+        uint32_t begin, end;
+        state_index_level_range(index, level, &begin, &end);
+        if (end - begin > widest)
+            widest = end - begin;
+    }
+    uint8_t maps[ENGINE_NUM_SYMMETRIES][ENGINE_MAX_CELLS];
+    game_symmetries(game, maps);
+    float* values = malloc((size_t)index->num_states * sizeof(float));
+    uint32_t* source = malloc((size_t)widest * sizeof(uint32_t));
+    uint8_t* symmetry = malloc(widest);
+    int status = -1;
+    if (values == NULL || source == NULL || symmetry == NULL)
+        goto out;
+
+    LevelJob job = {.index = index, .game = game, .discount = config->discount, .q = table->values, .values = values,
+                    .maps = (const uint8_t (*)[ENGINE_MAX_CELLS])maps, .source = source, .symmetry = symmetry};
+    for (int level = game->num_cells; level >= 0; level--) {
+        state_index_level_range(index, level, &job.begin, &job.end);
+        if (job.begin == job.end)
+            continue;
+        run_pass(&job, 0, num_threads);
+        run_pass(&job, 1, num_threads);
+    }
+    stats->num_states = index->num_states;
+    stats->canonical_states = atomic_load(&job.canonical);
+    status = 0;
+
+out:
+    free(values);
+    free(source);
+    free(symmetry);
+    stats->seconds = monotonic_seconds() - start;
+    return status;
+}
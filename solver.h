@@ -0,0 +1,33 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdint.h>
+#include "engine.h"
+#include "qtable.h"
+#include "state_index.h"
+
+#define SOLVER_MAX_THREADS 64
+
+typedef struct {
+    float discount;  // a result n plies away is worth discount^(n-1) of it, so quicker wins score higher
+    int num_threads;
+} SolverConfig;
+
+typedef struct {
+    uint32_t num_states;
+    uint32_t canonical_states; // solved directly; the rest are copied from a symmetric image
+    double seconds;
+} SolverStats;
+
+// Exact minimax Q-values for every reachable position, in the state-indexed
+// layout the trainer writes: a move that wins scores 1, one that fills the
+// board without a winner 0, and any other move minus discount times the best
+// Q-value of the opponent's reply. Illegal cells and finished positions hold 0.
+//
+// Levels (stone counts) are solved from the full board back to the empty
+// one, each in parallel once the level above is complete. Within a level
+// only one position per symmetry class is searched; the others take its row
+// through the cell map.
+int solver_solve(const StateIndex* index, const SolverConfig* config, QTable* table, SolverStats* stats);
+
+#endif
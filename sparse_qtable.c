@@ -0,0 +1,191 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sparse_qtable.h"
+
+// Function to allocate an empty shard of capacity slots
+static int allocate_shard(const SparseQTable* table, SparseShard* shard, size_t capacity) {
+    uint8_t* control = malloc(capacity);
+    uint8_t* slots = malloc(capacity * table->stride);
+    if (control == NULL || slots == NULL) {
+        free(control);
+        free(slots);
+        return -1;
+    }
+    memset(control, SPARSE_QTABLE_EMPTY, capacity);
+    shard->control = control;
+    shard->slots = slots;
+    shard->capacity = capacity;
+    shard->count = 0;
+    return 0;
+}
+
+// Function to claim the first empty slot on pos's probe sequence; there is
+// always one, as shards never fill beyond 7/8
+static SparseSlot* place(const SparseQTable* table, SparseShard* shard, Position pos, uint64_t hash) {
+    size_t mask = shard->capacity / SPARSE_QTABLE_GROUP - 1;
+    size_t group = (hash >> 7) & mask;
+    for (size_t step = 1;; step++) {
+        uint8_t* control = shard->control + group * SPARSE_QTABLE_GROUP;
+        uint32_t empty = sparse_qtable_match(control, SPARSE_QTABLE_EMPTY);
+        if (empty != 0) {
+            size_t index = group * SPARSE_QTABLE_GROUP + __builtin_ctz(empty);
+            shard->control[index] = (uint8_t)(hash & 0x7f);
+            shard->count++;
+            SparseSlot* slot = sparse_qtable_slot(table, shard, index);
+            slot->key = pos;
+            return slot;
+        }
+        group = (group + step) & mask;
+    }
+}
+
+// Function to move a shard's slots into a fresh one of capacity slots. With
+// aging, every visit count is halved first and slots left at zero are dropped.
+static int rebuild(const SparseQTable* table, SparseShard* shard, size_t capacity, bool aging) {
+    SparseShard old = *shard;
+    if (allocate_shard(table, shard, capacity) != 0) {
+        *shard = old;
+        return -1;
+    }
+    size_t row_bytes = (size_t)table->num_cells * sizeof(float);
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.control[i] == SPARSE_QTABLE_EMPTY)
+            continue;
+        const SparseSlot* from = sparse_qtable_slot(table, &old, i);
+        uint32_t visits = aging ? from->visits >> 1 : from->visits;
+        if (visits == 0) {
+            shard->evicted++;
+            continue;
+        }
+        SparseSlot* to = place(table, shard, from->key, sparse_qtable_hash(from->key));
+        to->visits = visits;
+        memcpy(to->row, from->row, row_bytes);
+    }
+    free(old.control);
+    free(old.slots);
+    return 0;
+}
+
+// Function to make room for one more slot: grow while the cap allows, then
+// evict until the shard is at most half full
+static int make_room(const SparseQTable* table, SparseShard* shard) {
+    if ((shard->count + 1) * 8 <= shard->capacity * 7)
+        return 0;
+    if (shard->capacity * 2 <= shard->max_capacity)
+        return rebuild(table, shard, shard->capacity * 2, false);
+    do {
+        if (rebuild(table, shard, shard->capacity, true) != 0)
+            return -1;
+    } while (shard->count * 2 > shard->capacity);
+    return 0;
+}
+
+static SparseSlot* insert(SparseQTable* table, SparseShard* shard, Position pos, uint64_t hash) {
+    SparseSlot* slot = sparse_qtable_lookup(table, shard, pos, hash);
+    if (slot == NULL) {
+        if (make_room(table, shard) != 0)
+            return NULL;
+        slot = place(table, shard, pos, hash);
+        slot->visits = 0;
+        memset(slot->row, 0, (size_t)table->num_cells * sizeof(float));
+    }
+    if (slot->visits != UINT32_MAX)
+        slot->visits++;
+    return slot;
+}
+
+int sparse_qtable_init(SparseQTable* table, int num_cells, size_t max_bytes) {
+    memset(table, 0, sizeof(*table));
+    table->num_cells = num_cells;
+    table->stride = (offsetof(SparseSlot, row) + (size_t)num_cells * sizeof(float) + 7) & ~(size_t)7;
+    size_t share = max_bytes / SPARSE_QTABLE_SHARDS;
+    size_t max_capacity = SPARSE_QTABLE_GROUP;
+    while (max_capacity * 2 * (table->stride + 1) <= share)
+        max_capacity *= 2;
+    for (int s = 0; s < SPARSE_QTABLE_SHARDS; s++) {
+        SparseShard* shard = &table->shards[s];
+        shard->max_capacity = max_capacity;
+        if (pthread_mutex_init(&shard->lock, NULL) != 0 || allocate_shard(table, shard, SPARSE_QTABLE_GROUP) != 0) {
+            sparse_qtable_free(table);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void sparse_qtable_free(SparseQTable* table) {
+    for (int s = 0; s < SPARSE_QTABLE_SHARDS; s++) {
+        SparseShard* shard = &table->shards[s];
+        if (shard->max_capacity == 0)
+            continue;
+        pthread_mutex_destroy(&shard->lock);
+        free(shard->control);
+        free(shard->slots);
+        memset(shard, 0, sizeof(*shard));
+    }
+}
+
+float* sparse_qtable_insert(SparseQTable* table, Position pos) {
+    uint64_t hash = sparse_qtable_hash(pos);
+    SparseSlot* slot = insert(table, sparse_qtable_shard(table, hash), pos, hash);
+    return slot != NULL ? slot->row : NULL;
+}
+
+bool sparse_qtable_read(SparseQTable* table, Position pos, float* row) {
+    uint64_t hash = sparse_qtable_hash(pos);
+    SparseShard* shard = sparse_qtable_shard(table, hash);
+    size_t row_bytes = (size_t)table->num_cells * sizeof(float);
+    pthread_mutex_lock(&shard->lock);
+    const SparseSlot* slot = sparse_qtable_lookup(table, shard, pos, hash);
+    if (slot != NULL)
+        memcpy(row, slot->row, row_bytes);
+    else
+        memset(row, 0, row_bytes);
+    pthread_mutex_unlock(&shard->lock);
+    return slot != NULL;
+}
+
+int sparse_qtable_add(SparseQTable* table, Position pos, int cell, float amount) {
+    uint64_t hash = sparse_qtable_hash(pos);
+    SparseShard* shard = sparse_qtable_shard(table, hash);
+    pthread_mutex_lock(&shard->lock);
+    SparseSlot* slot = insert(table, shard, pos, hash);
+    if (slot != NULL)
+        slot->row[cell] += amount;
+    pthread_mutex_unlock(&shard->lock);
+    return slot != NULL ? 0 : -1;
+}
+
+size_t sparse_qtable_count(const SparseQTable* table) {
+    size_t count = 0;
+    for (int s = 0; s < SPARSE_QTABLE_SHARDS; s++)
+        count += table->shards[s].count;
+    return count;
+}
+
+size_t sparse_qtable_bytes(const SparseQTable* table) {
+    size_t bytes = 0;
+    for (int s = 0; s < SPARSE_QTABLE_SHARDS; s++)
+        bytes += table->shards[s].capacity * (table->stride + 1);
+    return bytes;
+}
+
+uint64_t sparse_qtable_evicted(const SparseQTable* table) {
+    uint64_t evicted = 0;
+    for (int s = 0; s < SPARSE_QTABLE_SHARDS; s++)
+        evicted += table->shards[s].evicted;
+    return evicted;
+}
+
+void sparse_qtable_visit(const SparseQTable* table, void (*visit)(void* context, Position pos, const float* row), void* context) {
+    for (int s = 0; s < SPARSE_QTABLE_SHARDS; s++) {
+        const SparseShard* shard = &table->shards[s];
+        for (size_t i = 0; i < shard->capacity; i++) {
+            if (shard->control[i] != SPARSE_QTABLE_EMPTY) {
+                const SparseSlot* slot = sparse_qtable_slot(table, shard, i);
+                visit(context, slot->key, slot->row);
+            }
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef SPARSE_QTABLE_H
+#define SPARSE_QTABLE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Q-rows for the positions training actually reaches, in a hash map keyed by
+// the position. SwissTable layout: a control byte per slot (empty, or 7 bits
+// of the hash) scanned 16 at a time, and slots holding the key, a visit
+// count and the row inline. The map is split into shards by the top bits of
+// the hash, each with its own lock, share of the memory cap and growth.
+#define SPARSE_QTABLE_SHARDS 64
+#define SPARSE_QTABLE_GROUP 16      // control bytes per probe
+#define SPARSE_QTABLE_EMPTY 0x80
+#define SPARSE_QTABLE_DEFAULT_MB 256
+
+typedef struct {
+    Position key;
+    uint32_t visits; // updates since the last eviction pass, halved by each
+    float row[];     // num_cells values
+} SparseSlot;
+
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    uint8_t* control;
+    uint8_t* slots;       // capacity slots of the table's stride
+    size_t capacity;      // a power of two, at least one group
+    size_t max_capacity;  // what this shard's share of the cap allows
+    size_t count;
+    uint64_t evicted;
+} SparseShard;
+
+typedef struct {
+    SparseShard shards[SPARSE_QTABLE_SHARDS];
+    int num_cells;
+    size_t stride;   // bytes per slot
+} SparseQTable;
+
+// max_bytes caps the control bytes and slots together. Once a shard reaches
+// its share it stops growing and evicts instead: every visit count is halved
+// and the slots that drop to zero go, until the shard is half empty, so
+// states touched once and never again are the first to leave. A shard being
+// rebuilt briefly holds both copies, 1/SPARSE_QTABLE_SHARDS of the cap.
+int sparse_qtable_init(SparseQTable* table, int num_cells, size_t max_bytes);
+void sparse_qtable_free(SparseQTable* table);
+
+static inline uint64_t sparse_qtable_hash(Position pos) {
+    uint64_t hash = pos.x * 0x9e3779b97f4a7c15ULL ^ (pos.o + 0x632be59bd9b4e019ULL) * 0xc2b2ae3d27d4eb4fULL;
+    hash ^= hash >> 32;
+    hash *= 0xd6e8feb86659fd93ULL;
+    return hash ^ hash >> 32;
+}
+
+static inline SparseShard* sparse_qtable_shard(const SparseQTable* table, uint64_t hash) {
+    return (SparseShard*)&table->shards[hash >> 58];
+}
+
+static inline SparseSlot* sparse_qtable_slot(const SparseQTable* table, const SparseShard* shard, size_t index) {
+    return (SparseSlot*)(shard->slots + index * table->stride);
+}
+
+// Bit i set for every control byte of the group equal to byte
+static inline uint32_t sparse_qtable_match(const uint8_t* group, uint8_t byte) {
+#ifdef __SSE2__
+    __m128i control = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < SPARSE_QTABLE_GROUP; i++)
+        mask |= (uint32_t)(group[i] == byte) << i;
+    return mask;
+#endif
+}
+
+// Function to look a position up in its shard; the caller holds the shard's
+// lock or owns the table. Groups are probed triangularly, which visits every
+// group of a power-of-two table, and a group with an empty slot ends the search.
+static inline SparseSlot* sparse_qtable_lookup(const SparseQTable* table, const SparseShard* shard, Position pos, uint64_t hash) {
+    size_t mask = shard->capacity / SPARSE_QTABLE_GROUP - 1;
+    size_t group = (hash >> 7) & mask;
+    uint8_t tag = (uint8_t)(hash & 0x7f);
+    for (size_t step = 1;; step++) {
+        const uint8_t* control = shard->control + group * SPARSE_QTABLE_GROUP;
+        for (uint32_t match = sparse_qtable_match(control, tag); match; match &= match - 1) {
+            SparseSlot* slot = sparse_qtable_slot(table, shard, group * SPARSE_QTABLE_GROUP + __builtin_ctz(match));
+            if (slot->key.x == pos.x && slot->key.o == pos.o)
+                return slot;
+        }
+        if (sparse_qtable_match(control, SPARSE_QTABLE_EMPTY) != 0)
+            return NULL;
+        group = (group + step) & mask;
+    }
+}
+
+// Row of pos, or NULL if it has none. Unlocked: for a table one thread owns,
+// and the row moves on that thread's next insert.
+static inline float* sparse_qtable_find(const SparseQTable* table, Position pos) {
+    uint64_t hash = sparse_qtable_hash(pos);
+    SparseSlot* slot = sparse_qtable_lookup(table, sparse_qtable_shard(table, hash), pos, hash);
+    return slot != NULL ? slot->row : NULL;
+}
+
+// Row of pos, added zeroed if it has none, with the visit counted. Unlocked,
+// like sparse_qtable_find; NULL only when memory runs out.
+float* sparse_qtable_insert(SparseQTable* table, Position pos);
+
+// The same for tables shared between threads, under the shard's lock. read
+// copies the row out (zeroes and false for a position without one), add
+// adds amount to one value.
+bool sparse_qtable_read(SparseQTable* table, Position pos, float* row);
+int sparse_qtable_add(SparseQTable* table, Position pos, int cell, float amount);
+
+// Totals over every shard
+size_t sparse_qtable_count(const SparseQTable* table);
+size_t sparse_qtable_bytes(const SparseQTable* table);
+uint64_t sparse_qtable_evicted(const SparseQTable* table);
+
+// Call visit for every stored position, shard by shard; not for use while
+// other threads write
+void sparse_qtable_visit(const SparseQTable* table, void (*visit)(void* context, Position pos, const float* row), void* context);
+
+#endif
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include "state_index.h"
+
+static uint64_t binomial[STATE_INDEX_MAX_CELLS + 1][STATE_INDEX_MAX_CELLS + 1];
+
+// Function to fill Pascal's triangle once
+static void init_binomial() {
+    if (binomial[0][0] == 1)
+        return;
+    for (int n = 0; n <= STATE_INDEX_MAX_CELLS; n++) {
+        binomial[n][0] = 1;
+        for (int k = 1; k <= n; k++)
+            binomial[n][k] = binomial[n - 1][k - 1] + (k <= n - 1 ? binomial[n - 1][k] : 0);
+    }
+}
+
+static inline uint64_t choose(int n, int k) {
+    return (k < 0 || k > n) ? 0 : binomial[n][k];
+}
+
+// Colexicographic rank of a k-subset given as a bitmask
+static uint64_t subset_rank(uint64_t bits) {
+    uint64_t rank = 0;
+    for (int k = 1; bits; bits &= bits - 1, k++)
+        rank += choose(engine_lowest_cell(bits), k);
+    return rank;
+}
+
+// Inverse of subset_rank for a k-subset of {0, ..., n-1}
+static uint64_t subset_unrank(uint64_t rank, int n, int k) {
+    uint64_t bits = 0;
+    for (int c = n - 1; k > 0; c--) {
+        if (choose(c, k) <= rank) {
+            rank -= choose(c, k);
+            bits |= 1ULL << c;
+            k--;
+        }
+    }
+    return bits;
+}
+
+uint64_t state_index_combinatorial_rank(const StateIndex* index, Position pos) {
+    int num_cells = index->game->num_cells;
+    int nx = engine_popcount(pos.x);
+    int no = engine_popcount(pos.o);
+
+    // O's stones are ranked among the cells X left free
+    uint64_t o_compact = 0;
+    int free_cell = 0;
+    for (int cell = 0; cell < num_cells; cell++) {
+        if (pos.x >> cell & 1)
+            continue;
+        if (pos.o >> cell & 1)
+            o_compact |= 1ULL << free_cell;
+        free_cell++;
+    }
+    return index->level_offset[nx + no] + subset_rank(pos.x) * choose(num_cells - nx, no) + subset_rank(o_compact);
+}
+
+Position state_index_combinatorial_unrank(const StateIndex* index, uint64_t rank) {
+    int num_cells = index->game->num_cells;
+    int level = 0;
+    while (index->level_offset[level + 1] <= rank)
+        level++;
+    int nx = (level + 1) / 2;
+    int no = level / 2;
+    rank -= index->level_offset[level];
+
+    uint64_t o_slots = choose(num_cells - nx, no);
+    Position pos;
+    pos.x = subset_unrank(rank / o_slots, num_cells, nx);
+    uint64_t o_compact = subset_unrank(rank % o_slots, num_cells - nx, no);
+
+    // Spread O's stones back over the cells X left free
+    pos.o = 0;
+    int free_cell = 0;
+    for (int cell = 0; cell < num_cells; cell++) {
+        if (pos.x >> cell & 1)
+            continue;
+        if (o_compact >> free_cell & 1)
+            pos.o |= 1ULL << cell;
+        free_cell++;
+    }
+    return pos;
+}
+
+// Depth-first walk over every position reachable from pos, marking slots
+static void mark_reachable(StateIndex* index, Position pos) {
+    uint64_t slot = state_index_combinatorial_rank(index, pos);
+    if (index->reachable[slot >> 6] >> (slot & 63) & 1)
+        return;
+    index->reachable[slot >> 6] |= 1ULL << (slot & 63);
+
+    const Game* game = index->game;
+    if (game_outcome(game, pos) != OUTCOME_ONGOING)
+        return;
+    int side = position_side_to_move(pos);
+    for (uint64_t moves = position_empty(game, pos); moves; moves &= moves - 1) {
+        Position next = pos;
+        if (side == 0)
+            next.x |= moves & -moves;
+        else
+            next.o |= moves & -moves;
+        mark_reachable(index, next);
+    }
+}
+
+// Function to enumerate the reachable positions and build the rank/select tables
+int state_index_build(StateIndex* index, const Game* game) {
+    int num_cells = game->num_cells;
+    if (num_cells > STATE_INDEX_MAX_CELLS)
+        return -1;
+    init_binomial();
+
+    index->game = game;
+    index->states = NULL;
+    index->space_size = 0;
+    for (int level = 0; level <= num_cells + 1; level++) {
+        index->level_offset[level] = index->space_size;
+        if (level <= num_cells) {
+            int nx = (level + 1) / 2;
+            int no = level / 2;
+            index->space_size += choose(num_cells, nx) * choose(num_cells - nx, no);
+        }
+    }
+
+    size_t num_words = (size_t)(index->space_size + 63) / 64;
+    index->reachable = calloc(num_words, sizeof(uint64_t));
+    index->word_rank = malloc(num_words * sizeof(uint32_t));
+    if (index->reachable == NULL || index->word_rank == NULL) {
+        state_index_free(index);
+        return -1;
+    }
+
+    Position empty = {0, 0};
+    mark_reachable(index, empty);
+
+    uint32_t count = 0;
+    for (size_t word = 0; word < num_words; word++) {
+        index->word_rank[word] = count;
+        count += engine_popcount(index->reachable[word]);
+    }
+    index->num_states = count;
+
+    index->states = malloc((size_t)count * sizeof(uint32_t));
+    if (index->states == NULL) {
+        state_index_free(index);
+        return -1;
+    }
+    uint32_t next = 0;
+    for (size_t word = 0; word < num_words; word++) {
+        for (uint64_t bits = index->reachable[word]; bits; bits &= bits - 1)
+            index->states[next++] = (uint32_t)(word * 64 + engine_lowest_cell(bits));
+    }
+
+    // Dense ranks follow combinatorial order, so levels stay contiguous
+    uint32_t state = 0;
+    for (int level = 0; level <= num_cells + 1; level++) {
+        while (state < count && index->states[state] < index->level_offset[level])
+            state++;
+        index->level_begin[level] = state;
+    }
+    return 0;
+}
+
+void state_index_free(StateIndex* index) {
+    free(index->reachable);
+    free(index->word_rank);
+    free(index->states);
+    index->reachable = NULL;
+    index->word_rank = NULL;
+    index->states = NULL;
+    index->num_states = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef STATE_INDEX_H
+#define STATE_INDEX_H
+
+#include <stdint.h>
+#include "engine.h"
+
+#define STATE_INDEX_MAX_CELLS 16
+#define STATE_INDEX_NONE UINT32_MAX
+
+// Dense index over the positions reachable from the empty board.
+//
+// A position is first ranked combinatorially by its piece counts (the counts
+// are fixed by the number of stones, since X moves first), which already packs
+// the 3x3 board into 6,046 slots instead of 3^9. A rank/select bitmap over
+// that space then drops the unreachable slots, leaving 5,478 dense indices.
+// Dense indices are grouped by number of stones, in increasing order.
+typedef struct {
+    const Game* game;
+    uint32_t num_states;
+    uint64_t space_size;
+    uint64_t level_offset[STATE_INDEX_MAX_CELLS + 2]; // combinatorial rank of the first slot per level
+    uint32_t level_begin[STATE_INDEX_MAX_CELLS + 2];  // dense index of the first state per level
+    uint64_t* reachable;  // one bit per combinatorial slot
+    uint32_t* word_rank;  // number of reachable slots before each bitmap word
+    uint32_t* states;     // dense index -> combinatorial rank
+} StateIndex;
+
+int state_index_build(StateIndex* index, const Game* game);
+void state_index_free(StateIndex* index);
+
+uint64_t state_index_combinatorial_rank(const StateIndex* index, Position pos);
+Position state_index_combinatorial_unrank(const StateIndex* index, uint64_t rank);
+
+// Dense rank of a position, or STATE_INDEX_NONE if it is not reachable.
+// Boards no game can produce (overlapping stones, stones off the board, or
+// piece counts X-first play cannot give) have no combinatorial slot, so they
+// are turned away before ranking.
+static inline uint32_t state_index_rank(const StateIndex* index, Position pos) {
+    int balance = engine_popcount(pos.x) - engine_popcount(pos.o);
+    if ((pos.x & pos.o) != 0 || ((pos.x | pos.o) & ~index->game->full_mask) != 0 || balance < 0 || balance > 1)
+        return STATE_INDEX_NONE;
+    uint64_t slot = state_index_combinatorial_rank(index, pos);
+    uint64_t word = index->reachable[slot >> 6];
+    uint64_t bit = 1ULL << (slot & 63);
+    if (!(word & bit))
+        return STATE_INDEX_NONE;
+    return index->word_rank[slot >> 6] + (uint32_t)engine_popcount(word & (bit - 1));
+}
+
+static inline Position state_index_unrank(const StateIndex* index, uint32_t rank) {
+    return state_index_combinatorial_unrank(index, index->states[rank]);
+}
+
+// Dense indices of the positions with the given number of stones are [begin, end)
+static inline void state_index_level_range(const StateIndex* index, int level, uint32_t* begin, uint32_t* end) {
+    *begin = index->level_begin[level];
+    *end = index->level_begin[level + 1];
+}
+
+#endif
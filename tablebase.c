@@ -0,0 +1,338 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tablebase.h"
+#include "timer.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define TABLEBASE_MAX_THREADS 64
+#define TABLEBASE_CHUNK 4096 // positions per work item, a multiple of 32 so chunks own whole words
+
+// One level (stone count) being solved by a pool of threads
+typedef struct {
+    const Game* game;
+    const StateIndex* index;
+    uint64_t* values;
+    int level;
+    uint32_t begin;
+    uint32_t end;
+    _Atomic uint32_t next_chunk;
+    _Atomic uint32_t solved;
+    _Atomic uint64_t counts[4];
+    double last_report;
+} LevelJob;
+
+static size_t values_words(uint32_t num_states) {
+    return ((size_t)num_states + 31) / 32;
+}
+
+static int load_value(const uint64_t* values, uint32_t rank) {
+    uint64_t word = __atomic_load_n(&values[rank >> 5], __ATOMIC_RELAXED);
+    return (int)(word >> ((rank & 31) * 2) & 3);
+}
+
+// Function to compute a position's value from its children one level up,
+// which are all solved already
+static int solve_position(const Game* game, const StateIndex* index, const uint64_t* values, Position pos) {
+    int side = position_side_to_move(pos);
+    if (game_is_win(game, position_stones(pos, side ^ 1)))
+        return TB_LOSS;
+    uint64_t empty = position_empty(game, pos);
+    if (empty == 0)
+        return TB_DRAW;
+
+    bool draw = false;
+    for (; empty; empty &= empty - 1) {
+        int cell = engine_lowest_cell(empty);
+        Position child = pos;
+        position_make(&child, side, cell);
+        if (game_move_wins(game, position_stones(child, side), cell))
+            return TB_WIN;
+        int value = load_value(values, state_index_rank(index, child));
+        if (value == TB_LOSS)
+            return TB_WIN;
+        draw |= value == TB_DRAW;
+    }
+    return draw ? TB_DRAW : TB_LOSS;
+}
+
+// Function to solve chunks of the level until none are left. The calling
+// thread (report set) also prints progress about once a second.
+static void solve_chunks(LevelJob* job, bool report) {
+    uint32_t base = job->begin & ~(uint32_t)(TABLEBASE_CHUNK - 1);
+    uint64_t counts[4] = {0, 0, 0, 0};
+    for (;;) {
+        uint32_t chunk = atomic_fetch_add(&job->next_chunk, 1);
+        uint64_t chunk_begin = (uint64_t)base + (uint64_t)chunk * TABLEBASE_CHUNK;
+        if (chunk_begin >= job->end)
+            break;
+        uint32_t first = chunk_begin > job->begin ? (uint32_t)chunk_begin : job->begin;
+        uint32_t last = chunk_begin + TABLEBASE_CHUNK < job->end ? (uint32_t)chunk_begin + TABLEBASE_CHUNK : job->end;
+
+        // Words at the edges of a level are shared with the neighbouring
+        // level, so bits go in with an atomic OR, one word at a time
+        uint64_t word = 0;
+        for (uint32_t rank = first; rank < last; rank++) {
+            int value = solve_position(job->game, job->index, job->values, state_index_unrank(job->index, rank));
+            counts[value]++;
+            word |= (uint64_t)value << ((rank & 31) * 2);
+            if ((rank & 31) == 31 || rank + 1 == last) {
+                __atomic_fetch_or(&job->values[rank >> 5], word, __ATOMIC_RELAXED);
+                word = 0;
+            }
+        }
+
+        uint32_t solved = atomic_fetch_add(&job->solved, last - first) + (last - first);
+        double now = report ? monotonic_seconds() : 0;
+        if (report && now - job->last_report >= 1.0) {
+            job->last_report = now;
+            printf("  level %d: %u/%u positions (%.1f%%)\n", job->level, solved, job->end - job->begin,
+                   100.0 * solved / (job->end - job->begin));
+            fflush(stdout);
+        }
+    }
+    for (int v = 0; v < 4; v++)
+        atomic_fetch_add(&job->counts[v], counts[v]);
+}
+
+static void* level_worker(void* arg) {
+    solve_chunks(arg, false);
+    return NULL;
+}
+
+// Function to clear the entries of [begin, end), e.g. a level left half done
+static void clear_range(uint64_t* values, uint32_t begin, uint32_t end) {
+    for (uint32_t rank = begin; rank < end; rank++)
+        __atomic_fetch_and(&values[rank >> 5], ~(3ULL << ((rank & 31) * 2)), __ATOMIC_RELAXED);
+}
+
+// Function to count the values of the finished levels, from lowest_done up
+static void count_finished(const StateIndex* index, const uint64_t* values, const TablebaseHeader* header,
+                           uint64_t counts[4]) {
+    memset(counts, 0, 4 * sizeof(uint64_t));
+    int level = (int)header->lowest_done <= index->game->num_cells ? (int)header->lowest_done : index->game->num_cells + 1;
+    uint32_t begin = index->level_begin[level];
+    for (uint32_t rank = begin; rank < index->num_states; rank++)
+        counts[load_value(values, rank)]++;
+}
+
+static void solve_level(LevelJob* job, int num_threads) {
+    pthread_t threads[TABLEBASE_MAX_THREADS];
+    bool started[TABLEBASE_MAX_THREADS];
+    for (int t = 1; t < num_threads; t++)
+        started[t] = pthread_create(&threads[t], NULL, level_worker, job) == 0;
+    solve_chunks(job, true);
+    for (int t = 1; t < num_threads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+}
+
+#ifndef _WIN32
+
+// Function to create the tablebase file, or reopen one left by an earlier run
+static int map_for_writing(const Game* game, const StateIndex* index, const char* filename, void** map, size_t* size) {
+    *size = TABLEBASE_HEADER_SIZE + values_words(index->num_states) * sizeof(uint64_t);
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        printf("Error: Unable to open file for writing.\n");
+        return -1;
+    }
+    struct stat st;
+    bool fresh = fstat(fd, &st) != 0 || st.st_size == 0;
+    if (!fresh && (size_t)st.st_size != *size) {
+        printf("Error: %s exists but is not a tablebase for this board.\n", filename);
+        close(fd);
+        return -1;
+    }
+    if (fresh && ftruncate(fd, (off_t)*size) != 0) {
+        printf("Error: Unable to size %s.\n", filename);
+        close(fd);
+        return -1;
+    }
+    *map = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (*map == MAP_FAILED) {
+        printf("Error: Unable to map %s.\n", filename);
+        return -1;
+    }
+
+    TablebaseHeader* header = *map;
+    if (fresh) {
+        memcpy(header->magic, TABLEBASE_MAGIC, 4);
+        header->version = TABLEBASE_VERSION;
+        header->board_size = game->size;
+        header->win_length = game->win_length;
+        header->num_states = index->num_states;
+        header->lowest_done = game->num_cells + 1;
+    } else if (memcmp(header->magic, TABLEBASE_MAGIC, 4) != 0 || header->version != TABLEBASE_VERSION ||
+               (int)header->board_size != game->size || (int)header->win_length != game->win_length ||
+               header->num_states != index->num_states) {
+        printf("Error: %s exists but is not a tablebase for this board.\n", filename);
+        munmap(*map, *size);
+        return -1;
+    }
+    return 0;
+}
+
+// Solve every level from the full board down to first_level, saving after
+// each level so an interrupted run picks up where it stopped
+int tablebase_generate(const Game* game, const char* filename, int first_level, int num_threads) {
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > TABLEBASE_MAX_THREADS)
+        num_threads = TABLEBASE_MAX_THREADS;
+    if (first_level < 0)
+        first_level = 0;
+    StateIndex index;
+    double start = monotonic_seconds();
+    if (state_index_build(&index, game) != 0) {
+        printf("Error: Unable to index a %dx%d board (at most %d cells).\n", game->size, game->size, STATE_INDEX_MAX_CELLS);
+        return -1;
+    }
+    printf("Indexed %u positions in %.2fs\n", index.num_states, monotonic_seconds() - start);
+
+    void* map;
+    size_t size;
+    if (map_for_writing(game, &index, filename, &map, &size) != 0) {
+        state_index_free(&index);
+        return -1;
+    }
+    TablebaseHeader* header = map;
+    uint64_t* values = (uint64_t*)((char*)map + TABLEBASE_HEADER_SIZE);
+    header->first_level = first_level;
+    if ((int)header->lowest_done <= game->num_cells)
+        printf("Resuming below level %u\n", header->lowest_done);
+
+    // The header counts are recounted from the finished levels rather than
+    // trusted, in case an earlier run stopped between writing the two
+    uint64_t counts[4];
+    count_finished(&index, values, header, counts);
+    memcpy(header->counts, counts, sizeof(counts));
+    msync(map, TABLEBASE_HEADER_SIZE, MS_SYNC);
+
+    for (int level = (int)header->lowest_done - 1; level >= first_level; level--) {
+        LevelJob job = {.game = game, .index = &index, .values = values, .level = level, .last_report = monotonic_seconds()};
+        state_index_level_range(&index, level, &job.begin, &job.end);
+        clear_range(values, job.begin, job.end);
+        double level_start = monotonic_seconds();
+        solve_level(&job, num_threads);
+
+        // Values reach the disk before the header that says they are done;
+        // the counts and lowest_done then go out together in the header page
+        msync((char*)map + TABLEBASE_HEADER_SIZE, size - TABLEBASE_HEADER_SIZE, MS_SYNC);
+        for (int v = 0; v < 4; v++) {
+            counts[v] += atomic_load(&job.counts[v]);
+            header->counts[v] = counts[v];
+        }
+        header->lowest_done = level;
+        msync(map, TABLEBASE_HEADER_SIZE, MS_SYNC);
+        printf("level %2d: %9u positions  win %9llu  draw %9llu  loss %9llu  %.2fs\n", level, job.end - job.begin,
+               (unsigned long long)atomic_load(&job.counts[TB_WIN]), (unsigned long long)atomic_load(&job.counts[TB_DRAW]),
+               (unsigned long long)atomic_load(&job.counts[TB_LOSS]), monotonic_seconds() - level_start);
+        fflush(stdout);
+    }
+
+    printf("Tablebase complete down to %u stones: %s (%zu bytes, %.2fs)\n", header->lowest_done, filename, size,
+           monotonic_seconds() - start);
+    munmap(map, size);
+    state_index_free(&index);
+    return 0;
+}
+
+// Function to map a finished (or partial) tablebase read-only for probing
+int tablebase_open(Tablebase* tablebase, const char* filename) {
+    memset(tablebase, 0, sizeof(*tablebase));
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        printf("Error: Unable to open file for reading.\n");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < TABLEBASE_HEADER_SIZE) {
+        printf("Error: %s is not a tablebase.\n", filename);
+        close(fd);
+        return -1;
+    }
+    tablebase->map_size = (size_t)st.st_size;
+    tablebase->map = mmap(NULL, tablebase->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (tablebase->map == MAP_FAILED) {
+        printf("Error: Unable to map %s.\n", filename);
+        tablebase->map = NULL;
+        return -1;
+    }
+    tablebase->header = tablebase->map;
+    tablebase->values = (const uint64_t*)((const char*)tablebase->map + TABLEBASE_HEADER_SIZE);
+
+    const TablebaseHeader* header = tablebase->header;
+    if (memcmp(header->magic, TABLEBASE_MAGIC, 4) != 0 || header->version != TABLEBASE_VERSION ||
+        game_init(&tablebase->game, (int)header->board_size, (int)header->win_length) != 0 ||
+        state_index_build(&tablebase->index, &tablebase->game) != 0 || tablebase->index.num_states != header->num_states ||
+        tablebase->map_size != TABLEBASE_HEADER_SIZE + values_words(header->num_states) * sizeof(uint64_t)) {
+        printf("Error: %s is not a tablebase.\n", filename);
+        tablebase_close(tablebase);
+        return -1;
+    }
+    return 0;
+}
+
+void tablebase_close(Tablebase* tablebase) {
+    if (tablebase->index.reachable != NULL)
+        state_index_free(&tablebase->index);
+    if (tablebase->map != NULL)
+        munmap(tablebase->map, tablebase->map_size);
+    memset(tablebase, 0, sizeof(*tablebase));
+}
+
+#else
+
+int tablebase_generate(const Game* game, const char* filename, int first_level, int num_threads) {
+    printf("Error: Tablebases need mmap, which this build does not have.\n");
+    return -1;
+}
+
+int tablebase_open(Tablebase* tablebase, const char* filename) {
+    memset(tablebase, 0, sizeof(*tablebase));
+    printf("Error: Tablebases need mmap, which this build does not have.\n");
+    return -1;
+}
+
+void tablebase_close(Tablebase* tablebase) {
+    memset(tablebase, 0, sizeof(*tablebase));
+}
+
+#endif
+
+// Function to pick a move that keeps the tablebase value: a win if there is
+// one, else a draw. Returns -1 if the position is not covered.
+int tablebase_best_move(const Tablebase* tablebase, Position pos) {
+    const Game* game = &tablebase->game;
+    if (tablebase_probe(tablebase, pos) == TB_UNKNOWN)
+        return -1;
+    int side = position_side_to_move(pos);
+    int draw_move = -1, any_move = -1;
+    for (uint64_t empty = position_empty(game, pos); empty; empty &= empty - 1) {
+        int cell = engine_lowest_cell(empty);
+        Position child = pos;
+        position_make(&child, side, cell);
+        if (game_move_wins(game, position_stones(child, side), cell))
+            return cell;
+        int value = tablebase_probe(tablebase, child);
+        if (value == TB_LOSS)
+            return cell;
+        if (value == TB_DRAW && draw_move < 0)
+            draw_move = cell;
+        if (any_move < 0)
+            any_move = cell;
+    }
+    return draw_move >= 0 ? draw_move : any_move;
+}
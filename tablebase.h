@@ -0,0 +1,63 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+#include "state_index.h"
+
+#define TABLEBASE_MAGIC "TTTB"
+#define TABLEBASE_VERSION 1
+#define TABLEBASE_HEADER_SIZE 4096 // values start on a page boundary
+
+// Game-theoretic value for the side to move, 2 bits per position
+enum { TB_UNKNOWN = 0, TB_WIN = 1, TB_DRAW = 2, TB_LOSS = 3 };
+
+// On-disk header. lowest_done is the lowest stone count whose values are all
+// written; a generator that stops part way resumes from the level below it.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t board_size;
+    uint32_t win_length;
+    uint32_t num_states;   // positions under the dense StateIndex order
+    uint32_t first_level;  // fewest stones the file is meant to cover
+    uint32_t lowest_done;  // num_cells + 1 while nothing is done
+    uint32_t reserved;
+    uint64_t counts[4];    // positions per value, over the finished levels
+} TablebaseHeader;
+
+// A tablebase mapped read-only for probing. It points into itself, so it
+// must stay where tablebase_open put it.
+typedef struct {
+    Game game;
+    StateIndex index;
+    TablebaseHeader* header;
+    const uint64_t* values;
+    void* map;
+    size_t map_size;
+} Tablebase;
+
+int tablebase_generate(const Game* game, const char* filename, int first_level, int num_threads);
+int tablebase_open(Tablebase* tablebase, const char* filename);
+void tablebase_close(Tablebase* tablebase);
+
+static inline int tablebase_value_at(const uint64_t* values, uint32_t rank) {
+    return (int)(values[rank >> 5] >> ((rank & 31) * 2) & 3);
+}
+
+// Value of a position for its side to move, TB_UNKNOWN if the file does not cover it
+static inline int tablebase_probe(const Tablebase* tablebase, Position pos) {
+    int stones = position_num_stones(pos);
+    if (stones < (int)tablebase->header->lowest_done)
+        return TB_UNKNOWN;
+    uint32_t rank = state_index_rank(&tablebase->index, pos);
+    if (rank == STATE_INDEX_NONE)
+        return TB_UNKNOWN;
+    return tablebase_value_at(tablebase->values, rank);
+}
+
+int tablebase_best_move(const Tablebase* tablebase, Position pos);
+
+#endif
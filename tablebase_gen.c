@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "tablebase.h"
+
+// Solve a board by retrograde analysis into a 2-bit-per-position tablebase.
+// Rerunning on a partial file resumes at the first unfinished level.
+// Usage: tablebase_gen [size] [win_length] [file] [--from-level L] [--threads N]
+int main(int argc, char* argv[]) {
+    int positional[2] = {3, 0};
+    int num_positional = 0;
+    const char* filename = NULL;
+    int first_level = 0;
+    int num_threads = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--from-level") == 0 && i + 1 < argc) {
+            first_level = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (num_positional < 2 && argv[i][0] >= '0' && argv[i][0] <= '9') {
+            positional[num_positional++] = atoi(argv[i]);
+        } else if (filename == NULL && argv[i][0] != '-') {
+            filename = argv[i];
+        } else {
+            printf("Usage: tablebase_gen [size] [win_length] [file] [--from-level L] [--threads N]\n");
+            return 1;
+        }
+    }
+    int size = positional[0];
+    int win_length = num_positional > 1 ? positional[1] : size;
+
+    Game game;
+    if (game_init(&game, size, win_length) != 0) {
+        printf("Error: Unsupported board %dx%d with %d in a row.\n", size, size, win_length);
+        return 1;
+    }
+    char default_name[64];
+    if (filename == NULL) {
+        snprintf(default_name, sizeof(default_name), "tablebase_%dx%d_%d.tb", size, size, win_length);
+        filename = default_name;
+    }
+    if (tablebase_generate(&game, filename, first_level, num_threads) != 0)
+        return 1;
+
+    Tablebase tablebase;
+    if (tablebase_open(&tablebase, filename) != 0)
+        return 1;
+    static const char* names[4] = {"unknown", "win", "draw", "loss"};
+    printf("Empty board: %s for X\n", names[tablebase_probe(&tablebase, (Position){0, 0})]);
+    tablebase_close(&tablebase);
+    return 0;
+}
@@ -1,124 +1,173 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
+#include "engine.h"
+#include "latency.h"
+#include "live_qtable.h"
+#include "mcts.h"
+#include "model.h"
+#include "policy.h"
+#include "state_index.h"
+#include "tablebase.h"
 
 #define BOARD_SIZE 3
 
-// Player symbols
-#define PLAYER_X 'X'
-#define PLAYER_O 'O'
-#define EMPTY_CELL ' '
-
 float q_values[2][BOARD_SIZE][BOARD_SIZE]; // Q-values for the AI agent
-
-// Function to load Q-values from a file
+QTable q_table = {.values = &q_values[0][0][0], .num_cells = BOARD_SIZE * BOARD_SIZE}; // The same values, as the engine sees them
+StateIndex state_index; // For a q_values.dat written by "solve", one row per position
+Game game; // Board geometry shared with the engine
+bool use_mcts = false; // Search with MCTS instead of reading the Q-values
+long mcts_playouts = 20000; // MCTS playouts per move
+MctsTree mcts_tree; // Kept between moves so the searched subtree is reused
+Tablebase tablebase; // Solved positions, for "theGame tablebase"
+Policy ai; // Greedy on the Q-values, MCTS or the tablebase
+bool online = false; // Keep learning across games, for "theGame online"
+long publish_interval = 1; // Games between snapshots the AI is allowed to see
+LiveQTable live; // Online: the table being learned into and the snapshots served from
+int live_reader; // Online: the AI's reader slot
+
+// Function to load Q-values from a file; a state-indexed, sparse or network
+// file replaces the positional table with one of its own layout
 void load_q_values(const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (file != NULL) {
-        fread(q_values, sizeof(float), 2 * BOARD_SIZE * BOARD_SIZE, file);
-        fclose(file);
-    } else {
-        printf("Error: Unable to open file for reading.\n");
+    ModelHeader header;
+    bool found = model_read_header(filename, &header) == 0;
+    if (found && header.kind == MODEL_STATE_INDEXED &&
+        (state_index_build(&state_index, &game) != 0 || qtable_init_state_indexed(&q_table, &state_index) != 0)) {
+        printf("Error: Unable to allocate a state-indexed Q-table.\n");
+        exit(1);
+    }
+    if (found && header.kind == MODEL_SPARSE && qtable_init_sparse(&q_table, &game, (size_t)SPARSE_QTABLE_DEFAULT_MB << 20) != 0) {
+        printf("Error: Unable to allocate a sparse Q-table.\n");
+        exit(1);
+    }
+    if (found && header.kind == MODEL_MLP &&
+        qtable_init_mlp(&q_table, &game, mlp_hidden_units(header.num_values, (int)header.num_cells), 0) != 0) {
+        printf("Error: Unable to allocate the network.\n");
         exit(1);
     }
+    if (model_load_qtable(filename, &game, &q_table) != 0)
+        exit(1);
 }
 
 // Function to save Q-values to a file
 void save_q_values(const char* filename) {
-    FILE* file = fopen(filename, "wb");
-    if (file != NULL) {
-        fwrite(q_values, sizeof(float), 2 * BOARD_SIZE * BOARD_SIZE, file);
-        fclose(file);
-    } else {
-        printf("Error: Unable to open file for writing.\n");
-    }
+    model_save_qtable(filename, &game, &q_table);
 }
 
 // Function to print the board
-void print_board(char board[][BOARD_SIZE]) {
-    printf("   0   1   2\n");
-    printf("  -----------\n");
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        printf("%d |", i);
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            printf(" %c |", board[i][j]);
-        }
-        printf("\n");
-        printf("  -----------\n");
-    }
+void print_board(Position board) {
+    game_print_board(&game, board);
 }
 
-// Function to check if the game is over
-int game_over(char board[][BOARD_SIZE]) {
-    // Check rows
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        if (board[i][0] != EMPTY_CELL && board[i][0] == board[i][1] && board[i][1] == board[i][2])
-            return (board[i][0] == PLAYER_X) ? 1 : 2; // Player X wins (1), Player O wins (2)
-    }
-    // Check columns
-    for (int j = 0; j < BOARD_SIZE; j++) {
-        if (board[0][j] != EMPTY_CELL && board[0][j] == board[1][j] && board[1][j] == board[2][j])
-            return (board[0][j] == PLAYER_X) ? 1 : 2; // Player X wins (1), Player O wins (2)
-    }
-    // Check diagonals
-    if (board[0][0] != EMPTY_CELL && board[0][0] == board[1][1] && board[1][1] == board[2][2])
-        return (board[0][0] == PLAYER_X) ? 1 : 2; // Player X wins (1), Player O wins (2)
-    if (board[0][2] != EMPTY_CELL && board[0][2] == board[1][1] && board[1][1] == board[2][0])
-        return (board[0][2] == PLAYER_X) ? 1 : 2; // Player X wins (1), Player O wins (2)
-    // Check for draw
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (board[i][j] == EMPTY_CELL)
-                return 0; // Game continues
-        }
-    }
-    return -1; // Draw
-}
-
-// Function to perform AI's action
-void ai_action(char board[][BOARD_SIZE], char ai_symbol) {
-    int row, col;
-    float max_q_value = -9999.0;
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (board[i][j] == EMPTY_CELL && q_values[ai_symbol == PLAYER_X ? 0 : 1][i][j] > max_q_value) {
-                max_q_value = q_values[ai_symbol == PLAYER_X ? 0 : 1][i][j];
-                row = i;
-                col = j;
-            }
-        }
-    }
-    board[row][col] = ai_symbol;
-}
-
-// Function to update Q-values based on game outcome
-void update_q_values(char board[][BOARD_SIZE], char player_symbol, char ai_symbol, int outcome) {
+// Function to update Q-values based on game outcome. Only the positional
+// table learns here: state-indexed tables come from the solver and are exact
+// already, and sparse ones and networks are left to the trainer that made them.
+void update_q_values(QTable* table, Position board, char player_symbol, char ai_symbol, int outcome) {
+    if (table->index != NULL || table->sparse != NULL || table->mlp != NULL)
+        return;
     float reward;
-    if (outcome == 1) { // Player X wins
+    if (outcome == OUTCOME_X_WINS) {
         reward = (player_symbol == PLAYER_X) ? 1.0 : -1.0;
-    } else if (outcome == 2) { // Player O wins
+    } else if (outcome == OUTCOME_O_WINS) {
         reward = (player_symbol == PLAYER_O) ? 1.0 : -1.0;
     } else { // Draw
         reward = 0.0;
     }
 
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (board[i][j] == EMPTY_CELL) {
-                q_values[ai_symbol == PLAYER_X ? 0 : 1][i][j] += reward;
-            }
+    float* row = table->values + side_index(ai_symbol) * table->num_cells;
+    for (uint64_t empty = position_empty(&game, board); empty; empty &= empty - 1)
+        row[engine_lowest_cell(empty)] += reward;
+}
+
+// Function to play one game from the empty board, printing every move.
+// Returns the outcome (the final position in *final), or OUTCOME_ONGOING if
+// the input ran out.
+int play_game(Policy* players[2], Position* final) {
+    Position board = {0, 0};
+    while (true) {
+        int side = position_side_to_move(board);
+        // Online, the AI reads the latest published snapshot, never the
+        // table that is being learned into
+        bool pinned = online && players[side] == &ai;
+        if (pinned)
+            ai.table = live_qtable_read_begin(&live, live_reader);
+        int cell = policy_choose_move(players[side], &game, board);
+        if (pinned)
+            live_qtable_read_end(&live, live_reader);
+        if (cell < 0)
+            return OUTCOME_ONGOING;
+        position_make(&board, side, cell);
+
+        // Print the board after each move
+        printf("Current board:\n");
+        print_board(board);
+
+        // Check if the game is over after each move
+        int outcome = game_outcome(&game, board);
+        if (outcome == OUTCOME_X_WINS) {
+            printf("Player X wins!\n");
+        } else if (outcome == OUTCOME_O_WINS) {
+            printf("Player O wins!\n");
+        } else if (outcome == OUTCOME_DRAW) {
+            printf("It's a draw!\n");
+        }
+        if (outcome != OUTCOME_ONGOING) {
+            *final = board;
+            return outcome;
         }
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     srand(time(NULL)); // Seed for random number generation
-    char board[BOARD_SIZE][BOARD_SIZE];
+    latency_init_from_env(); // TICTACTOE_LATENCY=1 prints per-move latency percentiles at exit
+    Position board;
     char player_symbol, ai_symbol;
+    game_init(&game, BOARD_SIZE, BOARD_SIZE);
+
+    // "theGame mcts [playouts]" plays against MCTS instead of the Q-values
+    if (argc > 1 && strcmp(argv[1], "mcts") == 0) {
+        use_mcts = true;
+        if (argc > 2)
+            mcts_playouts = atol(argv[2]);
+        if (mcts_init(&mcts_tree, &game, 1u << 20, (uint64_t)time(NULL)) != 0) {
+            printf("Error: Unable to allocate the MCTS arena.\n");
+            return 1;
+        }
+        policy_init_mcts(&ai, &mcts_tree, mcts_playouts);
+    } else if (argc > 1 && strcmp(argv[1], "tablebase") == 0) {
+        // "theGame tablebase [file]" plays perfectly from a generated tablebase
+        if (tablebase_open(&tablebase, argc > 2 ? argv[2] : "tablebase_3x3_3.tb") != 0)
+            return 1;
+        if (tablebase.game.size != BOARD_SIZE || tablebase.game.win_length != BOARD_SIZE) {
+            printf("Error: The tablebase is not for a %dx%d board.\n", BOARD_SIZE, BOARD_SIZE);
+            return 1;
+        }
+        policy_init_tablebase(&ai, &tablebase, (uint64_t)rand());
+    } else if (argc > 1 && strcmp(argv[1], "search") == 0) {
+        // "theGame search [microseconds]" plays alpha-beta with a time limit per move
+        policy_init_search(&ai, (uint64_t)((argc > 2 ? atof(argv[2]) : 5000) * 1e3), 0);
+    } else if (argc > 1 && strcmp(argv[1], "online") == 0) {
+        // "theGame online [games per publish]" plays game after game, learning as it goes
+        online = true;
+        if (argc > 2 && atol(argv[2]) > 0)
+            publish_interval = atol(argv[2]);
+        policy_init_greedy(&ai, NULL);
+    } else {
+        policy_init_greedy(&ai, &q_table);
+    }
 
     // Load Q-values from file
     load_q_values("q_values.dat");
+    if (online) {
+        if (live_qtable_init(&live, &q_table) != 0) {
+            printf("Error: Unable to allocate the Q-tables.\n");
+            return 1;
+        }
+        live_reader = live_qtable_register_reader(&live);
+    }
 
     // Ask the user to choose X or O
     printf("Choose X or O (X goes first): ");
@@ -134,65 +183,38 @@ int main() {
         return 1;
     }
 
-    // Initialize the board
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            board[i][j] = EMPTY_CELL;
-        }
-    }
+    // The human and the AI each keep their symbol; whoever is to move picks
+    Policy human;
+    policy_init_human(&human, "Your turn as %c (enter row and column): ");
+    Policy* players[2];
+    players[side_index(player_symbol)] = &human;
+    players[side_index(ai_symbol)] = &ai;
 
     // Main game loop
-    while (true) {
-        // Player's turn
-        if (player_symbol == PLAYER_X) {
-            int row, col;
-            printf("Your turn (enter row and column): ");
-            scanf("%d %d", &row, &col);
-            getchar(); // Consume newline character
-            if (board[row][col] != EMPTY_CELL || row < 0 || row >= BOARD_SIZE || col < 0 || col >= BOARD_SIZE) {
-                printf("Invalid move. Try again.\n");
-                continue;
-            }
-            board[row][col] = player_symbol;
-        } else {
-            // AI's turn
-            ai_action(board, ai_symbol);
-        }
-        
-        // Print the board after each move
-        printf("Current board:\n");
-        print_board(board);
-        
-        // Check if the game is over after each move
-        int outcome = game_over(board);
-        if (outcome == 1) {
-            printf("Player X wins!\n");
-            update_q_values(board, player_symbol, ai_symbol, 1);
-            save_q_values("q_values.dat"); // Save Q-values after the game
-            break;
-        } else if (outcome == 2) {
-            printf("Player O wins!\n");
-            update_q_values(board, player_symbol, ai_symbol, 2);
+    for (long games_played = 1;; games_played++) {
+        int outcome = play_game(players, &board);
+        if (outcome == OUTCOME_ONGOING)
+            return 1;
+        if (!online) {
+            update_q_values(&q_table, board, player_symbol, ai_symbol, outcome);
             save_q_values("q_values.dat"); // Save Q-values after the game
             break;
-        } else if (outcome == -1) {
-            printf("It's a draw!\n");
-            update_q_values(board, player_symbol, ai_symbol, -1);
-            save_q_values("q_values.dat"); // Save Q-values after the game
-            break;
-        }
-        
-        // Switch player turns
-        if (player_symbol == PLAYER_X) {
-            player_symbol = PLAYER_O;
-            ai_symbol = PLAYER_X;
-        } else {
-            player_symbol = PLAYER_X;
-            ai_symbol = PLAYER_O;
         }
+
+        // Learn into the writer's table; the AI sees it from the next publish
+        QTable* learning = live_qtable_writer(&live);
+        update_q_values(learning, board, player_symbol, ai_symbol, outcome);
+        if (games_played % publish_interval == 0 && live_qtable_publish(&live) == 0)
+            printf("The AI now plays with what it learned from %ld games.\n", games_played);
+        model_save_qtable("q_values.dat", &game, learning);
+
+        char play_again;
+        printf("Play again? (y/n): ");
+        if (scanf(" %c", &play_again) != 1 || (play_again != 'y' && play_again != 'Y'))
+            break;
     }
 
+    if (online)
+        live_qtable_free(&live);
     return 0;
 }
-
-
@@ -0,0 +1,278 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+#include "rng.h"
+#include "trainer.h"
+
+#define MAX_AXES 16
+#define MAX_AXIS_VALUES 64
+#define MAX_GEOMETRIES 16
+
+// Usage: train [--config file] [key=value ...] [--sweep key=a,b,c ...]
+//              [--sample N key=lo:hi ...] [--jobs N] [--summary file]
+// --sweep axes form a grid (every combination is run); --sample adds N random
+// draws of the lo:hi ranges for each grid point. Results go to the summary
+// file as one JSON object per line.
+
+typedef struct {
+    char key[64];
+    char values[MAX_AXIS_VALUES][64];
+    int num_values;
+} SweepAxis;
+
+typedef struct {
+    char key[64];
+    double lo, hi;
+    bool integer;
+} SampleRange;
+
+typedef struct {
+    TrainConfig config;
+    const TrainShared* shared;
+    TrainResult result;
+    int status;
+} Job;
+
+typedef struct {
+    Job* jobs;
+    int num_jobs;
+    atomic_int next;
+    pthread_mutex_t print_lock;
+} JobQueue;
+
+static void print_usage() {
+    printf("Usage: train [--config file] [key=value ...] [--sweep key=a,b,c ...]\n");
+    printf("             [--sample N key=lo:hi ...] [--jobs N] [--summary file]\n");
+}
+
+// Function to split "key=rest" in place; returns the part after '=' or NULL
+static char* split_assignment(char* text) {
+    char* equals = strchr(text, '=');
+    if (equals == NULL)
+        return NULL;
+    *equals = '\0';
+    return equals + 1;
+}
+
+// Function to parse "key=a,b,c", checking every value on a scratch config
+// so that a bad one fails here rather than as a default in some job
+static int parse_axis(SweepAxis* axis, char* text) {
+    char* values = split_assignment(text);
+    if (values == NULL || !trainer_is_option(text))
+        return -1;
+    snprintf(axis->key, sizeof(axis->key), "%s", text);
+    axis->num_values = 0;
+    TrainConfig scratch;
+    trainer_default_config(&scratch);
+    for (char* value = strtok(values, ","); value != NULL; value = strtok(NULL, ",")) {
+        if (axis->num_values == MAX_AXIS_VALUES || trainer_set_option(&scratch, axis->key, value) != 0)
+            return -1;
+        snprintf(axis->values[axis->num_values++], sizeof(axis->values[0]), "%s", value);
+    }
+    return axis->num_values > 0 ? 0 : -1;
+}
+
+static int parse_range(SampleRange* range, char* text) {
+    char* bounds = split_assignment(text);
+    char* colon = bounds != NULL ? strchr(bounds, ':') : NULL;
+    if (colon == NULL || !trainer_is_option(text))
+        return -1;
+    *colon = '\0';
+    snprintf(range->key, sizeof(range->key), "%s", text);
+    range->lo = atof(bounds);
+    range->hi = atof(colon + 1);
+    range->integer = strpbrk(bounds, ".eE") == NULL && strpbrk(colon + 1, ".eE") == NULL;
+    return range->lo <= range->hi ? 0 : -1;
+}
+
+static void* job_worker(void* arg) {
+    JobQueue* queue = arg;
+    for (;;) {
+        int j = atomic_fetch_add(&queue->next, 1);
+        if (j >= queue->num_jobs)
+            break;
+        Job* job = &queue->jobs[j];
+        job->status = train_run(&job->config, job->shared, &job->result);
+        pthread_mutex_lock(&queue->print_lock);
+        printf("job %d/%d: %d generations, win %.3f draw %.3f loss %.3f, %.2fs (%s)\n", j + 1, queue->num_jobs,
+               job->result.generations, job->result.win_rate, job->result.draw_rate, job->result.loss_rate,
+               job->result.seconds, job->status == 0 ? job->result.stop_reason : "failed");
+        if (job->result.table_bytes > 0)
+            printf("job %d/%d: sparse tables hold %.1f MB, %llu rows evicted\n", j + 1, queue->num_jobs,
+                   job->result.table_bytes / 1048576.0, (unsigned long long)job->result.table_evicted);
+        pthread_mutex_unlock(&queue->print_lock);
+    }
+    return NULL;
+}
+
+// Function to write one JSON line per job: its parameters, then its results
+static int write_summary(const Job* jobs, int num_jobs, const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Error: Unable to open file for writing.\n");
+        return -1;
+    }
+    for (int j = 0; j < num_jobs; j++) {
+        const Job* job = &jobs[j];
+        fprintf(file, "{\"job\": %d, \"params\": {", j);
+        trainer_write_config_json(file, &job->config);
+        fprintf(file, "}, \"status\": \"%s\", \"generations\": %d, \"best_instance\": %d, ",
+                job->status == 0 ? "ok" : "failed", job->result.generations, job->result.best_instance);
+        fprintf(file, "\"win_rate\": ");
+        trainer_write_json_number(file, "%.4f", job->result.win_rate);
+        fprintf(file, ", \"draw_rate\": ");
+        trainer_write_json_number(file, "%.4f", job->result.draw_rate);
+        fprintf(file, ", \"loss_rate\": ");
+        trainer_write_json_number(file, "%.4f", job->result.loss_rate);
+        fprintf(file, ", \"table_bytes\": %zu, \"table_evicted\": %llu, \"stop_reason\": ", job->result.table_bytes,
+                (unsigned long long)job->result.table_evicted);
+        trainer_write_json_string(file, job->result.stop_reason);
+        fprintf(file, ", \"seconds\": ");
+        trainer_write_json_number(file, "%.3f", job->result.seconds);
+        fprintf(file, "}\n");
+    }
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    TrainConfig base;
+    trainer_default_config(&base);
+    SweepAxis* axes = calloc(MAX_AXES, sizeof(SweepAxis));
+    SampleRange ranges[MAX_AXES];
+    int num_axes = 0, num_ranges = 0, num_samples = 0, num_threads = 1;
+    const char* summary = "train_summary.jsonl";
+    if (axes == NULL)
+        return 1;
+
+    for (int i = 1; i < argc; i++) {
+        char* arg = argv[i];
+        if (strcmp(arg, "--config") == 0 && i + 1 < argc) {
+            if (trainer_load_config(&base, argv[++i]) != 0)
+                return 1;
+        } else if (strcmp(arg, "--sweep") == 0 && i + 1 < argc) {
+            if (num_axes == MAX_AXES || parse_axis(&axes[num_axes++], argv[++i]) != 0) {
+                printf("Error: Invalid sweep %s.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--sample") == 0 && i + 2 < argc) {
+            // Every range is drawn once per job, so they must agree on N
+            int samples = atoi(argv[++i]);
+            if (samples < 1 || (num_samples > 0 && samples != num_samples)) {
+                printf("Error: Invalid sample count %s (every --sample needs the same N, at least 1).\n", argv[i]);
+                return 1;
+            }
+            num_samples = samples;
+            if (num_ranges == MAX_AXES || parse_range(&ranges[num_ranges++], argv[++i]) != 0) {
+                printf("Error: Invalid sample range %s.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--jobs") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "--summary") == 0 && i + 1 < argc) {
+            summary = argv[++i];
+        } else if (strcmp(arg, "--help") == 0) {
+            print_usage();
+            return 0;
+        } else {
+            char* value = split_assignment(arg);
+            if (value == NULL || trainer_set_option(&base, arg, value) != 0) {
+                printf("Error: Invalid option %s.\n", argv[i]);
+                print_usage();
+                return 1;
+            }
+        }
+    }
+    if (num_threads < 1)
+        num_threads = 1;
+    metrics_init_from_env(); // TICTACTOE_METRICS=9100 serves Prometheus metrics at /metrics
+
+    int grid_size = 1;
+    for (int a = 0; a < num_axes; a++)
+        grid_size *= axes[a].num_values;
+    int per_point = num_samples > 0 ? num_samples : 1;
+    int num_jobs = grid_size * per_point;
+    Job* jobs = calloc(num_jobs, sizeof(Job));
+    TrainShared* geometries = calloc(MAX_GEOMETRIES, sizeof(TrainShared));
+    TrainConfig geometry_keys[MAX_GEOMETRIES];
+    int num_geometries = 0;
+    if (jobs == NULL || geometries == NULL) {
+        printf("Error: Unable to allocate %d jobs.\n", num_jobs);
+        return 1;
+    }
+
+    Rng rng;
+    rng_seed(&rng, base.seed);
+    for (int j = 0; j < num_jobs; j++) {
+        TrainConfig* config = &jobs[j].config;
+        *config = base;
+        // Grid point j / per_point, decoded as a mixed-radix number over the axes
+        int point = j / per_point;
+        for (int a = 0; a < num_axes; a++) {
+            const char* value = axes[a].values[point % axes[a].num_values];
+            if (trainer_set_option(config, axes[a].key, value) != 0) {
+                printf("Error: Invalid sweep %s=%s.\n", axes[a].key, value);
+                return 1;
+            }
+            point /= axes[a].num_values;
+        }
+        for (int r = 0; r < num_ranges; r++) {
+            double value = ranges[r].lo + (ranges[r].hi - ranges[r].lo) * rng_uniform(&rng);
+            char text[64];
+            if (ranges[r].integer)
+                snprintf(text, sizeof(text), "%ld", (long)ranges[r].lo + (long)rng_below(&rng, (uint32_t)(ranges[r].hi - ranges[r].lo + 1)));
+            else
+                snprintf(text, sizeof(text), "%.6g", value);
+            if (trainer_set_option(config, ranges[r].key, text) != 0) {
+                printf("Error: Invalid sample range for %s (drew %s).\n", ranges[r].key, text);
+                return 1;
+            }
+        }
+        if (num_jobs > 1 && base.output[0] != '\0')
+            snprintf(config->output, TRAINER_MAX_PATH, "%.240s.%d", base.output, j);
+
+        // Game tables and the state index are built once per geometry and shared
+        int g = 0;
+        while (g < num_geometries && (geometry_keys[g].board_size != config->board_size ||
+                                      geometry_keys[g].win_length != config->win_length ||
+                                      geometry_keys[g].layers != config->layers ||
+                                      geometry_keys[g].table != config->table))
+            g++;
+        if (g == num_geometries) {
+            if (g == MAX_GEOMETRIES || trainer_prepare_shared(&geometries[g], config) != 0) {
+                printf("Error: Unsupported board %dx%d with %d in a row.\n", config->board_size, config->board_size, config->win_length);
+                return 1;
+            }
+            geometry_keys[g] = *config;
+            num_geometries++;
+        }
+        jobs[j].shared = &geometries[g];
+    }
+
+    printf("Running %d training jobs on %d threads\n", num_jobs, num_threads);
+    JobQueue queue = {jobs, num_jobs, 0, PTHREAD_MUTEX_INITIALIZER};
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    int started = 0;
+    for (; threads != NULL && started < num_threads; started++) {
+        if (pthread_create(&threads[started], NULL, job_worker, &queue) != 0)
+            break;
+    }
+    if (started == 0)
+        job_worker(&queue);
+    for (int t = 0; t < started; t++)
+        pthread_join(threads[t], NULL);
+
+    int status = write_summary(jobs, num_jobs, summary);
+    if (status == 0)
+        printf("Summary written to %s\n", summary);
+    for (int g = 0; g < num_geometries; g++)
+        trainer_free_shared(&geometries[g]);
+    free(threads);
+    free(geometries);
+    free(jobs);
+    free(axes);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,505 @@
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trainer.h"
+#include "batch_inference.h"
+#include "checkpoint.h"
+#include "convergence.h"
+#include "metrics.h"
+#include "model.h"
+#include "qtable.h"
+#include "rng.h"
+#include "timer.h"
+#include "trajectory.h"
+
+#define TRAINER_MAX_LEARN_THREADS 64
+
+typedef enum { OPTION_INT, OPTION_FLOAT, OPTION_U64, OPTION_TABLE, OPTION_STRING } OptionType;
+
+typedef struct {
+    const char* name;
+    OptionType type;
+    size_t offset;
+} OptionSpec;
+
+static const OptionSpec options[] = {
+    {"board_size", OPTION_INT, offsetof(TrainConfig, board_size)},
+    {"win_length", OPTION_INT, offsetof(TrainConfig, win_length)},
+    {"layers", OPTION_INT, offsetof(TrainConfig, layers)},
+    {"table", OPTION_TABLE, offsetof(TrainConfig, table)},
+    {"learning_rate", OPTION_FLOAT, offsetof(TrainConfig, learning_rate)},
+    {"discount_factor", OPTION_FLOAT, offsetof(TrainConfig, discount_factor)},
+    {"lambda", OPTION_FLOAT, offsetof(TrainConfig, lambda)},
+    {"monte_carlo", OPTION_INT, offsetof(TrainConfig, monte_carlo)},
+    {"initial_epsilon", OPTION_FLOAT, offsetof(TrainConfig, initial_epsilon)},
+    {"epsilon_decay_rate", OPTION_FLOAT, offsetof(TrainConfig, epsilon_decay_rate)},
+    {"min_epsilon", OPTION_FLOAT, offsetof(TrainConfig, min_epsilon)},
+    {"num_instances", OPTION_INT, offsetof(TrainConfig, num_instances)},
+    {"num_generations", OPTION_INT, offsetof(TrainConfig, num_generations)},
+    {"win_reward", OPTION_FLOAT, offsetof(TrainConfig, win_reward)},
+    {"draw_reward", OPTION_FLOAT, offsetof(TrainConfig, draw_reward)},
+    {"loss_reward", OPTION_FLOAT, offsetof(TrainConfig, loss_reward)},
+    {"seed", OPTION_U64, offsetof(TrainConfig, seed)},
+    {"eval_interval", OPTION_INT, offsetof(TrainConfig, eval_interval)},
+    {"eval_games", OPTION_INT, offsetof(TrainConfig, eval_games)},
+    {"convergence_window", OPTION_INT, offsetof(TrainConfig, convergence_window)},
+    {"convergence_delta", OPTION_FLOAT, offsetof(TrainConfig, convergence_delta)},
+    {"rate_tolerance", OPTION_FLOAT, offsetof(TrainConfig, rate_tolerance)},
+    {"output", OPTION_STRING, offsetof(TrainConfig, output)},
+    {"checkpoint_interval", OPTION_INT, offsetof(TrainConfig, checkpoint_interval)},
+    {"compact_interval", OPTION_INT, offsetof(TrainConfig, compact_interval)},
+    {"sparse_memory_mb", OPTION_INT, offsetof(TrainConfig, sparse_memory_mb)},
+    {"hidden_units", OPTION_INT, offsetof(TrainConfig, hidden_units)},
+    {"shared_table", OPTION_INT, offsetof(TrainConfig, shared_table)},
+    {"learn_threads", OPTION_INT, offsetof(TrainConfig, learn_threads)},
+};
+
+// Values of the table option, in TableKind order
+static const char* const table_names[] = {"positional", "state", "sparse", "mlp"};
+
+#define NUM_OPTIONS (int)(sizeof(options) / sizeof(options[0]))
+
+// Defaults follow Tic-Tac-Toe-AI-v4.c
+void trainer_default_config(TrainConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->board_size = 3;
+    config->win_length = 3;
+    config->layers = 1;
+    config->table = TABLE_POSITIONAL;
+    config->learning_rate = 0.1f;
+    config->discount_factor = 0.9f;
+    config->lambda = 0.8f;
+    config->initial_epsilon = 0.5f;
+    config->epsilon_decay_rate = 0.01f;
+    config->min_epsilon = 0.0f;
+    config->num_instances = 50;
+    config->num_generations = 100;
+    config->win_reward = 1;
+    config->draw_reward = 0;
+    config->loss_reward = -1;
+    config->seed = 1;
+    config->eval_interval = 10;
+    config->eval_games = 1000;
+    config->convergence_window = 5;
+    config->convergence_delta = 1e-3f;
+    config->rate_tolerance = 0.02f;
+    config->compact_interval = 8;
+    config->sparse_memory_mb = SPARSE_QTABLE_DEFAULT_MB;
+    config->hidden_units = MLP_DEFAULT_HIDDEN;
+    config->learn_threads = 1;
+}
+
+static const OptionSpec* find_option(const char* key) {
+    for (int i = 0; i < NUM_OPTIONS; i++) {
+        if (strcmp(options[i].name, key) == 0)
+            return &options[i];
+    }
+    return NULL;
+}
+
+bool trainer_is_option(const char* key) {
+    return find_option(key) != NULL;
+}
+
+// Function to set one option from its text form; returns -1 for unknown keys or bad values
+int trainer_set_option(TrainConfig* config, const char* key, const char* value) {
+    const OptionSpec* option = find_option(key);
+    if (option == NULL)
+        return -1;
+    char* field = (char*)config + option->offset;
+    char* end;
+    switch (option->type) {
+    case OPTION_INT:
+        *(int*)field = (int)strtol(value, &end, 10);
+        return *end == '\0' && end != value ? 0 : -1;
+    case OPTION_FLOAT:
+        *(float*)field = strtof(value, &end);
+        return *end == '\0' && end != value ? 0 : -1;
+    case OPTION_U64:
+        *(uint64_t*)field = strtoull(value, &end, 10);
+        return *end == '\0' && end != value ? 0 : -1;
+    case OPTION_TABLE:
+        for (int kind = 0; kind < (int)(sizeof(table_names) / sizeof(table_names[0])); kind++) {
+            if (strcmp(value, table_names[kind]) == 0) {
+                *(TableKind*)field = (TableKind)kind;
+                return 0;
+            }
+        }
+        return -1;
+    case OPTION_STRING:
+        snprintf(field, TRAINER_MAX_PATH, "%s", value);
+        return 0;
+    }
+    return -1;
+}
+
+static char* trim(char* text) {
+    while (*text == ' ' || *text == '\t')
+        text++;
+    char* end = text + strlen(text);
+    while (end > text && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+        *--end = '\0';
+    return text;
+}
+
+// Function to read "key = value" lines; '#' starts a comment
+int trainer_load_config(TrainConfig* config, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("Error: Unable to open file for reading.\n");
+        return -1;
+    }
+    char line[512];
+    int line_number = 0;
+    int status = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL)
+            *comment = '\0';
+        char* text = trim(line);
+        if (*text == '\0')
+            continue;
+        char* equals = strchr(text, '=');
+        if (equals == NULL) {
+            printf("Error: %s:%d: expected key = value.\n", filename, line_number);
+            status = -1;
+            continue;
+        }
+        *equals = '\0';
+        char* key = trim(text);
+        char* value = trim(equals + 1);
+        if (trainer_set_option(config, key, value) != 0) {
+            printf("Error: %s:%d: invalid option %s = %s.\n", filename, line_number, key, value);
+            status = -1;
+        }
+    }
+    fclose(file);
+    return status;
+}
+
+// Function to write a JSON string, escaping quotes, backslashes and control
+// characters (paths and stop reasons come from the user)
+void trainer_write_json_string(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(file, "\\u%04x", *c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Function to write a number, or null for NaN and infinity, which JSON lacks
+void trainer_write_json_number(FILE* file, const char* format, double value) {
+    if (isfinite(value))
+        fprintf(file, format, value);
+    else
+        fputs("null", file);
+}
+
+// Function to write every option as JSON members (no surrounding braces)
+void trainer_write_config_json(FILE* file, const TrainConfig* config) {
+    for (int i = 0; i < NUM_OPTIONS; i++) {
+        const char* field = (const char*)config + options[i].offset;
+        fprintf(file, "%s\"%s\": ", i > 0 ? ", " : "", options[i].name);
+        switch (options[i].type) {
+        case OPTION_INT:
+            fprintf(file, "%d", *(const int*)field);
+            break;
+        case OPTION_FLOAT:
+            trainer_write_json_number(file, "%g", *(const float*)field);
+            break;
+        case OPTION_U64:
+            fprintf(file, "%llu", (unsigned long long)*(const uint64_t*)field);
+            break;
+        case OPTION_TABLE:
+            fprintf(file, "\"%s\"", table_names[*(const TableKind*)field]);
+            break;
+        case OPTION_STRING:
+            trainer_write_json_string(file, field);
+            break;
+        }
+    }
+}
+
+int trainer_prepare_shared(TrainShared* shared, const TrainConfig* config) {
+    shared->has_index = false;
+    if (game_init_variant(&shared->game, config->board_size, config->win_length, config->layers) != 0)
+        return -1;
+    if (config->table == TABLE_STATE) {
+        if (state_index_build(&shared->index, &shared->game) != 0)
+            return -1;
+        shared->has_index = true;
+    }
+    return 0;
+}
+
+void trainer_free_shared(TrainShared* shared) {
+    if (shared->has_index)
+        state_index_free(&shared->index);
+    shared->has_index = false;
+}
+
+// One learning thread's share of a generation: every stride-th game from first
+typedef struct {
+    const Game* game;
+    const Trajectory* trajectories;
+    QTable* tables;
+    const TdConfig* td;
+    bool shared_table;
+    int count;
+    int first;
+    int stride;
+    double change;
+} LearnSlice;
+
+static void* learn_slice(void* arg) {
+    LearnSlice* slice = arg;
+    for (int i = slice->first; i < slice->count; i += slice->stride) {
+        if (slice->shared_table)
+            slice->change += trajectory_apply_shared(&slice->trajectories[i], slice->game, &slice->tables[0], slice->td);
+        else
+            slice->change += trajectory_apply(&slice->trajectories[i], slice->game, &slice->tables[i], slice->td);
+    }
+    return NULL;
+}
+
+// Function to apply a generation's games on up to num_threads threads and
+// return the sum of the squared changes. Each thread owns whole tables, or
+// with a shared table updates it under the shards' locks. A slice whose
+// thread fails to start runs on the caller.
+static double learn(const Game* game, const Trajectory* trajectories, QTable* tables, int count, const TdConfig* td,
+                    bool shared_table, int num_threads) {
+    if (num_threads > TRAINER_MAX_LEARN_THREADS)
+        num_threads = TRAINER_MAX_LEARN_THREADS;
+    if (num_threads > count)
+        num_threads = count;
+    if (num_threads < 1)
+        num_threads = 1;
+    LearnSlice slices[TRAINER_MAX_LEARN_THREADS];
+    pthread_t threads[TRAINER_MAX_LEARN_THREADS];
+    bool started[TRAINER_MAX_LEARN_THREADS];
+    for (int t = 0; t < num_threads; t++) {
+        slices[t] = (LearnSlice){game, trajectories, tables, td, shared_table, count, t, num_threads, 0};
+        started[t] = t > 0 && pthread_create(&threads[t], NULL, learn_slice, &slices[t]) == 0;
+    }
+    learn_slice(&slices[0]);
+    double change = slices[0].change;
+    for (int t = 1; t < num_threads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        else
+            learn_slice(&slices[t]);
+        change += slices[t].change;
+    }
+    return change;
+}
+
+// Function to total the memory and evictions of the sparse tables in use
+static void sparse_usage(const QTable* tables, int count, size_t* bytes, uint64_t* evicted) {
+    *bytes = 0;
+    *evicted = 0;
+    for (int i = 0; i < count; i++) {
+        if (tables[i].sparse != NULL) {
+            *bytes += sparse_qtable_bytes(tables[i].sparse);
+            *evicted += sparse_qtable_evicted(tables[i].sparse);
+        }
+    }
+}
+
+int train_run(const TrainConfig* config, const TrainShared* shared, TrainResult* result) {
+    const Game* game = &shared->game;
+    int n = config->num_instances;
+    double start = monotonic_seconds();
+    memset(result, 0, sizeof(*result));
+    if (n < 1 || (config->table == TABLE_STATE && !shared->has_index))
+        return -1;
+    // Counts the loops below divide by or step with
+    if (config->eval_games < 1 || config->num_generations < 0 || config->checkpoint_interval < 0 ||
+        config->learn_threads < 1 || config->sparse_memory_mb < 1) {
+        printf("Error: eval_games, learn_threads and sparse_memory_mb must be at least 1, "
+               "num_generations and checkpoint_interval at least 0.\n");
+        return -1;
+    }
+    // With a shared table there is one table, and every instance plays and learns with it
+    bool shared_table = config->shared_table != 0;
+    if (shared_table && config->table != TABLE_SPARSE) {
+        printf("Error: shared_table=1 needs table=sparse.\n");
+        return -1;
+    }
+    int num_tables = shared_table ? 1 : n;
+
+    QTable* tables = calloc(n, sizeof(QTable));
+    const QTable** active_tables = calloc(n, sizeof(QTable*));
+    Trajectory* trajectories = malloc(n * sizeof(Trajectory));
+    Position* boards = malloc(n * sizeof(Position));
+    Position* batch = malloc(n * sizeof(Position));
+    int* active = malloc(n * sizeof(int));
+    int* moves = malloc(n * sizeof(int));
+    float* epsilons = malloc(n * sizeof(float));
+    int* wins = calloc(n, sizeof(int));
+    int status = -1;
+    if (tables == NULL || active_tables == NULL || trajectories == NULL || boards == NULL || batch == NULL ||
+        active == NULL || moves == NULL || epsilons == NULL || wins == NULL)
+        goto out;
+    for (int i = 0; i < num_tables; i++) {
+        int failed = config->table == TABLE_STATE  ? qtable_init_state_indexed(&tables[i], &shared->index)
+                     : config->table == TABLE_SPARSE ? qtable_init_sparse(&tables[i], game, (size_t)config->sparse_memory_mb << 20)
+                     : config->table == TABLE_MLP    ? qtable_init_mlp(&tables[i], game, config->hidden_units, rng_mix(config->seed + i))
+                                                     : qtable_init_positional(&tables[i], game);
+        if (failed)
+            goto out;
+    }
+
+    // A chain of delta checkpoints follows one instance; the best one is
+    // picked again each time a full base is due, so every table records the
+    // blocks it writes
+    Checkpointer checkpoint;
+    int checkpointed = -1;
+    bool checkpointing = config->checkpoint_interval > 0 && config->output[0] != '\0';
+    checkpoint_init(&checkpoint, config->output, game, config->compact_interval);
+    for (int i = 0; checkpointing && i < num_tables; i++) {
+        if (qtable_track_dirty(&tables[i]) != 0)
+            goto out;
+    }
+
+    TdConfig td = {config->learning_rate, config->discount_factor, config->lambda, config->monte_carlo != 0,
+                   config->win_reward, config->draw_reward, config->loss_reward};
+    ConvergenceConfig convergence = convergence_default_config();
+    convergence.window = config->convergence_window;
+    convergence.delta_threshold = config->convergence_delta;
+    convergence.rate_tolerance = config->rate_tolerance;
+    convergence.eval_interval = config->eval_interval;
+    convergence.eval_games = config->eval_games;
+    ConvergenceTracker tracker;
+    convergence_init(&tracker, &convergence);
+
+    Rng rng;
+    rng_seed(&rng, config->seed);
+    float epsilon = config->initial_epsilon;
+    int best = 0;
+    for (int generation = 0; generation < config->num_generations; generation++) {
+        for (int i = 0; i < n; i++) {
+            boards[i] = (Position){0, 0};
+            trajectory_clear(&trajectories[i]);
+        }
+
+        // Every instance plays one self-play game; a ply of all games is one batch call
+        uint64_t phase = metrics_phase_begin();
+        for (;;) {
+            int count = 0;
+            for (int i = 0; i < n; i++) {
+                if (trajectories[i].outcome != OUTCOME_ONGOING)
+                    continue;
+                active[count] = i;
+                batch[count] = boards[i];
+                active_tables[count] = &tables[shared_table ? 0 : i];
+                epsilons[count] = epsilon;
+                count++;
+            }
+            if (count == 0)
+                break;
+            BatchRequest request = {.game = game, .tables = active_tables, .epsilons = epsilons, .seed = rng_next(&rng), .num_threads = 1};
+            choose_moves_batch(&request, batch, NULL, count, moves);
+            for (int k = 0; k < count; k++) {
+                int i = active[k];
+                int side = position_side_to_move(boards[i]);
+                trajectory_record(&trajectories[i], boards[i], side, moves[k]);
+                position_make(&boards[i], side, moves[k]);
+                if (game_move_wins(game, position_stones(boards[i], side), moves[k]))
+                    trajectories[i].outcome = side == 0 ? OUTCOME_X_WINS : OUTCOME_O_WINS;
+                else if (position_empty(game, boards[i]) == 0)
+                    trajectories[i].outcome = OUTCOME_DRAW;
+            }
+        }
+
+        metrics_phase_end(METRIC_PLAY, phase);
+
+        phase = metrics_phase_begin();
+        double change = learn(game, trajectories, tables, n, &td, shared_table, config->learn_threads);
+        for (int i = 0; i < n; i++) {
+            metrics_add_outcome(trajectories[i].outcome, trajectories[i].length);
+            if (trajectories[i].outcome == OUTCOME_X_WINS)
+                wins[i]++;
+            if (wins[i] > wins[best])
+                best = i;
+        }
+        metrics_phase_end(METRIC_LEARN, phase);
+        metrics_set(METRIC_Q_DELTA, sqrt(change));
+        metrics_set(METRIC_EPSILON, epsilon);
+        if (metrics_enabled && config->table == TABLE_SPARSE) {
+            size_t bytes;
+            uint64_t evicted;
+            sparse_usage(tables, num_tables, &bytes, &evicted);
+            metrics_set(METRIC_TABLE_BYTES, (double)bytes);
+            metrics_set(METRIC_TABLE_EVICTED, (double)evicted);
+        }
+        result->generations = generation + 1;
+        if (checkpointing && result->generations % config->checkpoint_interval == 0) {
+            phase = metrics_phase_begin();
+            if (checkpointed < 0 || checkpoint.num_deltas >= checkpoint.compact_interval)
+                checkpointed = shared_table ? 0 : best;
+            if (checkpoint_save(&checkpoint, &tables[checkpointed]) != 0)
+                goto out;
+            metrics_phase_end(METRIC_CHECKPOINT, phase);
+        }
+        epsilon -= config->epsilon_decay_rate;
+        if (epsilon < config->min_epsilon)
+            epsilon = config->min_epsilon;
+
+        convergence_record_episode(&tracker, (float)sqrt(change));
+        if (convergence_evaluation_due(&tracker)) {
+            EvaluationResult evaluation;
+            phase = metrics_phase_begin();
+            evaluate_against_random(game, &tables[shared_table ? 0 : best], config->eval_games, convergence.eval_seed, &evaluation);
+            metrics_phase_end(METRIC_EVALUATE, phase);
+            result->win_rate = (float)evaluation.wins / evaluation.games;
+            result->draw_rate = (float)evaluation.draws / evaluation.games;
+            result->loss_rate = (float)evaluation.losses / evaluation.games;
+            metrics_set(METRIC_EVAL_WIN_RATE, result->win_rate);
+            metrics_set(METRIC_EVAL_DRAW_RATE, result->draw_rate);
+            metrics_set(METRIC_EVAL_LOSS_RATE, result->loss_rate);
+            if (convergence_record_evaluation(&tracker, &evaluation))
+                break;
+        }
+    }
+    convergence_finish(&tracker, "reached the generation limit");
+
+    // Final numbers always come from an evaluation of the table being kept
+    if (shared_table)
+        best = 0;
+    EvaluationResult evaluation;
+    evaluate_against_random(game, &tables[best], config->eval_games, convergence.eval_seed, &evaluation);
+    result->win_rate = (float)evaluation.wins / evaluation.games;
+    result->draw_rate = (float)evaluation.draws / evaluation.games;
+    result->loss_rate = (float)evaluation.losses / evaluation.games;
+    result->best_instance = best;
+    sparse_usage(tables, num_tables, &result->table_bytes, &result->table_evicted);
+    snprintf(result->stop_reason, sizeof(result->stop_reason), "%s", tracker.reason);
+    status = 0;
+    if (config->output[0] != '\0')
+        status = model_save_qtable(config->output, game, &tables[best]);
+
+out:
+    if (tables != NULL) {
+        for (int i = 0; i < num_tables; i++)
+            qtable_free(&tables[i]);
+    }
+    free(tables);
+    free(active_tables);
+    free(trajectories);
+    free(boards);
+    free(batch);
+    free(active);
+    free(moves);
+    free(epsilons);
+    free(wins);
+    result->seconds = monotonic_seconds() - start;
+    return status;
+}
@@ -0,0 +1,88 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "engine.h"
+#include "state_index.h"
+
+#define TRAINER_MAX_PATH 256
+
+typedef enum {
+    TABLE_POSITIONAL,  // q_values[2][cells], the format of q_values.dat
+    TABLE_STATE,       // one row per reachable position, through a StateIndex
+    TABLE_SPARSE,      // rows only for the positions played, in a hash map
+    TABLE_MLP          // a small network computing every row
+} TableKind;
+
+// Everything that used to be a #define in the v2/v3/v4 trainers. A population
+// of num_instances learners each plays one self-play game per generation.
+typedef struct {
+    int board_size;
+    int win_length;
+    int layers;                // 1 for a flat board, 4 (with board_size 4, win_length 4) for Qubic
+    TableKind table;
+    float learning_rate;
+    float discount_factor;
+    float lambda;
+    int monte_carlo;
+    float initial_epsilon;
+    float epsilon_decay_rate;  // subtracted once per generation
+    float min_epsilon;
+    int num_instances;
+    int num_generations;
+    float win_reward;
+    float draw_reward;
+    float loss_reward;
+    uint64_t seed;
+    int eval_interval;         // generations between evaluations
+    int eval_games;
+    int convergence_window;
+    float convergence_delta;
+    float rate_tolerance;
+    char output[TRAINER_MAX_PATH];  // where the best instance's table is saved, empty for nowhere
+    int checkpoint_interval;        // generations between checkpoints of the best table to output, 0 for none
+    int compact_interval;           // delta checkpoints between full ones
+    int sparse_memory_mb;           // cap on each sparse table, rarely visited positions are evicted beyond it
+    int hidden_units;               // width of each network's hidden layer
+    int shared_table;               // every instance learns into one sparse table
+    int learn_threads;              // threads applying a generation's games
+} TrainConfig;
+
+typedef struct {
+    int generations;
+    int best_instance;
+    float win_rate;
+    float draw_rate;
+    float loss_rate;
+    double seconds;
+    size_t table_bytes;      // sparse tables: memory held at the end
+    uint64_t table_evicted;  // sparse tables: rows evicted to stay under the cap
+    char stop_reason[256];
+} TrainResult;
+
+// Precomputed engine tables for one board geometry, read-only once built and
+// shared by every run on that geometry
+typedef struct {
+    Game game;
+    StateIndex index;
+    bool has_index;
+} TrainShared;
+
+void trainer_default_config(TrainConfig* config);
+int trainer_set_option(TrainConfig* config, const char* key, const char* value);
+int trainer_load_config(TrainConfig* config, const char* filename);
+void trainer_write_config_json(FILE* file, const TrainConfig* config);
+void trainer_write_json_string(FILE* file, const char* text);
+void trainer_write_json_number(FILE* file, const char* format, double value);
+bool trainer_is_option(const char* key);
+
+int trainer_prepare_shared(TrainShared* shared, const TrainConfig* config);
+void trainer_free_shared(TrainShared* shared);
+
+// Train one configuration. Uses no global state, so runs can go in parallel.
+int train_run(const TrainConfig* config, const TrainShared* shared, TrainResult* result);
+
+#endif
@@ -0,0 +1,123 @@
+#include <math.h>
+#include "trajectory.h"
+
+// Reward for side at the end of the game
+static float final_reward(const TdConfig* config, int outcome, int side) {
+    if (outcome == OUTCOME_DRAW || outcome == OUTCOME_ONGOING)
+        return config->draw_reward;
+    bool x_won = outcome == OUTCOME_X_WINS;
+    return x_won == (side == 0) ? config->win_reward : config->loss_reward;
+}
+
+// Row of pos. A sparse table other threads are updating is read under its
+// shard's lock, into buffer.
+static const float* read_row(const QTable* table, Position pos, int side, bool shared, float* buffer) {
+    if (shared)
+        return sparse_qtable_read(table->sparse, pos, buffer) ? buffer : NULL;
+    return qtable_row(table, pos, side);
+}
+
+// Highest Q-value among the legal moves of pos
+static float max_legal_q(const Game* game, const QTable* table, Position pos, int side, bool shared) {
+    float buffer[ENGINE_MAX_CELLS];
+    const float* row = read_row(table, pos, side, shared, buffer);
+    uint64_t legal = position_empty(game, pos);
+    if (row == NULL || legal == 0)
+        return 0;
+    float best = -INFINITY;
+    for (; legal; legal &= legal - 1) {
+        float q = row[engine_lowest_cell(legal)];
+        best = q > best ? q : best;
+    }
+    return best;
+}
+
+// Each side learns from its own sequence of decisions: the state after a move
+// is the position at that side's next turn, and only the last decision sees
+// the final reward. TD errors are computed from the table as it was at the end
+// of the game, then folded backward through the eligibility traces,
+// E_k = delta_k + discount * lambda * E_(k+1).
+// A network is trained on the targets of the whole game in one pass.
+static float apply(const Trajectory* trajectory, const Game* game, const QTable* table, const TdConfig* config, bool shared) {
+    float change = 0;
+    float buffer[ENGINE_MAX_CELLS];
+    Position sample_positions[TRAJECTORY_CAPACITY];
+    uint8_t sample_sides[TRAJECTORY_CAPACITY], sample_moves[TRAJECTORY_CAPACITY];
+    float sample_targets[TRAJECTORY_CAPACITY];
+    int num_samples = 0;
+    for (int side = 0; side < 2; side++) {
+        int plies[TRAJECTORY_CAPACITY];
+        int count = 0;
+        for (int i = 0; i < trajectory->length; i++) {
+            if (trajectory->steps[i].side == side)
+                plies[count++] = i;
+        }
+        if (count == 0)
+            continue;
+
+        float reward = final_reward(config, trajectory->outcome, side);
+        float targets[TRAJECTORY_CAPACITY];
+        if (config->monte_carlo) {
+            float g = reward;
+            for (int k = count - 1; k >= 0; k--) {
+                targets[k] = g;
+                g *= config->discount;
+            }
+        } else {
+            float trace = 0;
+            float deltas[TRAJECTORY_CAPACITY];
+            for (int k = 0; k < count; k++) {
+                const TrajectoryStep* step = &trajectory->steps[plies[k]];
+                const float* row = read_row(table, step->position, side, shared, buffer);
+                float q = row != NULL ? row[step->move] : 0;
+                float next = k + 1 < count ? config->discount * max_legal_q(game, table, trajectory->steps[plies[k + 1]].position, side, shared)
+                                           : reward;
+                deltas[k] = next - q;
+            }
+            for (int k = count - 1; k >= 0; k--) {
+                trace = deltas[k] + config->discount * config->lambda * trace;
+                const TrajectoryStep* step = &trajectory->steps[plies[k]];
+                const float* row = read_row(table, step->position, side, shared, buffer);
+                targets[k] = (row != NULL ? row[step->move] : 0) + trace;
+            }
+        }
+
+        for (int k = 0; k < count; k++) {
+            const TrajectoryStep* step = &trajectory->steps[plies[k]];
+            if (table->mlp != NULL) {
+                sample_positions[num_samples] = step->position;
+                sample_sides[num_samples] = (uint8_t)side;
+                sample_moves[num_samples] = step->move;
+                sample_targets[num_samples++] = targets[k];
+                continue;
+            }
+            if (shared) {
+                // Another thread may move the value between the read and
+                // the add; the add itself is never lost
+                const float* row = read_row(table, step->position, side, true, buffer);
+                float step_change = config->learning_rate * (targets[k] - (row != NULL ? row[step->move] : 0));
+                if (sparse_qtable_add(table->sparse, step->position, step->move, step_change) == 0)
+                    change += step_change * step_change;
+                continue;
+            }
+            float* row = qtable_row_for_update(table, step->position, side);
+            if (row != NULL) {
+                float step_change = config->learning_rate * (targets[k] - row[step->move]);
+                row[step->move] += step_change;
+                qtable_mark_dirty(table, &row[step->move]);
+                change += step_change * step_change;
+            }
+        }
+    }
+    if (num_samples > 0)
+        change += mlp_train(table->mlp, sample_positions, sample_sides, sample_moves, sample_targets, num_samples, config->learning_rate);
+    return change;
+}
+
+float trajectory_apply(const Trajectory* trajectory, const Game* game, const QTable* table, const TdConfig* config) {
+    return apply(trajectory, game, table, config, false);
+}
+
+float trajectory_apply_shared(const Trajectory* trajectory, const Game* game, const QTable* table, const TdConfig* config) {
+    return apply(trajectory, game, table, config, true);
+}
@@ -0,0 +1,58 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+#include "qtable.h"
+
+// A game never has more plies than cells
+#define TRAJECTORY_CAPACITY ENGINE_MAX_CELLS
+
+typedef struct {
+    Position position; // before the move
+    uint8_t side;
+    uint8_t move;
+} TrajectoryStep;
+
+// Every ply of one game, in a fixed buffer that is reused from game to game
+typedef struct {
+    TrajectoryStep steps[TRAJECTORY_CAPACITY];
+    int length;
+    int outcome;
+} Trajectory;
+
+// TD(lambda) settings. lambda = 0 is one-step TD (Q-learning), monte_carlo
+// replaces bootstrapping with the discounted final reward.
+typedef struct {
+    float learning_rate;
+    float discount;
+    float lambda;
+    bool monte_carlo;
+    float win_reward;
+    float draw_reward;
+    float loss_reward;
+} TdConfig;
+
+static inline void trajectory_clear(Trajectory* trajectory) {
+    trajectory->length = 0;
+    trajectory->outcome = OUTCOME_ONGOING;
+}
+
+static inline void trajectory_record(Trajectory* trajectory, Position pos, int side, int move) {
+    TrajectoryStep* step = &trajectory->steps[trajectory->length++];
+    step->position = pos;
+    step->side = (uint8_t)side;
+    step->move = (uint8_t)move;
+}
+
+// Apply the end-of-game update to every move of the trajectory, for both
+// sides. Returns the sum of the squared changes made to the table.
+float trajectory_apply(const Trajectory* trajectory, const Game* game, const QTable* table, const TdConfig* config);
+
+// The same for a sparse table other threads are updating at the same time:
+// rows are read and written under their shard's lock, never through a
+// pointer that an insert or an eviction could move
+float trajectory_apply_shared(const Trajectory* trajectory, const Game* game, const QTable* table, const TdConfig* config);
+
+#endif
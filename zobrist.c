@@ -0,0 +1,44 @@
+#include <string.h>
+#include "zobrist.h"
+
+#define ZOBRIST_KEYS8(size, side, cell)                                                       \
+    ZOBRIST_KEY(size, side, (cell) + 0), ZOBRIST_KEY(size, side, (cell) + 1),                 \
+    ZOBRIST_KEY(size, side, (cell) + 2), ZOBRIST_KEY(size, side, (cell) + 3),                 \
+    ZOBRIST_KEY(size, side, (cell) + 4), ZOBRIST_KEY(size, side, (cell) + 5),                 \
+    ZOBRIST_KEY(size, side, (cell) + 6), ZOBRIST_KEY(size, side, (cell) + 7)
+#define ZOBRIST_SIDE(size, side)                                                              \
+    {ZOBRIST_KEYS8(size, side, 0), ZOBRIST_KEYS8(size, side, 8), ZOBRIST_KEYS8(size, side, 16), \
+     ZOBRIST_KEYS8(size, side, 24), ZOBRIST_KEYS8(size, side, 32), ZOBRIST_KEYS8(size, side, 40), \
+     ZOBRIST_KEYS8(size, side, 48), ZOBRIST_KEYS8(size, side, 56)}
+#define ZOBRIST_SIZE(size) {ZOBRIST_SIDE(size, 0), ZOBRIST_SIDE(size, 1)}
+
+#if ENGINE_MAX_CELLS != 64 || ENGINE_MAX_SIZE != 8
+#error "zobrist_keys is written out for 8x8 boards"
+#endif
+
+const uint64_t zobrist_keys[ENGINE_MAX_SIZE + 1][2][ENGINE_MAX_CELLS] = {
+    ZOBRIST_SIZE(0), ZOBRIST_SIZE(1), ZOBRIST_SIZE(2), ZOBRIST_SIZE(3), ZOBRIST_SIZE(4),
+    ZOBRIST_SIZE(5), ZOBRIST_SIZE(6), ZOBRIST_SIZE(7), ZOBRIST_SIZE(8),
+};
+
+// Function to lay out the keys of every cell's 8 images next to each other
+void zobrist_symmetry_init(ZobristSymmetry* symmetry, const Game* game) {
+    uint8_t map[ENGINE_NUM_SYMMETRIES][ENGINE_MAX_CELLS];
+    game_symmetries(game, map);
+    const uint64_t (*keys)[ENGINE_MAX_CELLS] = zobrist_table(game);
+    memset(symmetry, 0, sizeof(*symmetry));
+    for (int side = 0; side < 2; side++) {
+        for (int cell = 0; cell < game->num_cells; cell++) {
+            for (int t = 0; t < ENGINE_NUM_SYMMETRIES; t++)
+                symmetry->keys[side][cell][t] = keys[side][map[t][cell]];
+        }
+    }
+}
+
+void symmetric_hash_init(SymmetricHash* hash, const ZobristSymmetry* symmetry, Position pos) {
+    memset(hash, 0, sizeof(*hash));
+    for (uint64_t bits = pos.x; bits; bits &= bits - 1)
+        symmetric_hash_toggle(hash, symmetry, 0, engine_lowest_cell(bits));
+    for (uint64_t bits = pos.o; bits; bits &= bits - 1)
+        symmetric_hash_toggle(hash, symmetry, 1, engine_lowest_cell(bits));
+}
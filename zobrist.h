@@ -0,0 +1,90 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+#include "engine.h"
+
+// Zobrist hashing: a position's hash is the XOR of one random key per stone,
+// so placing or removing a stone is a single XOR. The keys are splitmix64
+// outputs written as constant expressions, so the table is computed by the
+// compiler and lives in read-only data. Each geometry (game_slot) gets its
+// own keys, so hashes of different geometries do not collide.
+#define ZOBRIST_SEED 0x5a0b1257c0ffee11ULL
+#define ZOBRIST_MIX1(z) (((z) ^ ((z) >> 30)) * 0xbf58476d1ce4e5b9ULL)
+#define ZOBRIST_MIX2(z) (((z) ^ ((z) >> 27)) * 0x94d049bb133111ebULL)
+#define ZOBRIST_MIX3(z) ((z) ^ ((z) >> 31))
+#define ZOBRIST_SPLITMIX(n) ZOBRIST_MIX3(ZOBRIST_MIX2(ZOBRIST_MIX1(ZOBRIST_SEED + (uint64_t)(n) * 0x9e3779b97f4a7c15ULL)))
+#define ZOBRIST_KEY(size, side, cell) ZOBRIST_SPLITMIX((((size) * 2 + (side)) * ENGINE_MAX_CELLS + (cell)) + 1)
+
+extern const uint64_t zobrist_keys[ENGINE_MAX_SIZE + 1][2][ENGINE_MAX_CELLS];
+
+static inline const uint64_t (*zobrist_table(const Game* game))[ENGINE_MAX_CELLS] {
+    return zobrist_keys[game_slot(game)];
+}
+
+// Hash of a position from scratch
+static inline uint64_t zobrist_hash(const Game* game, Position pos) {
+    const uint64_t (*keys)[ENGINE_MAX_CELLS] = zobrist_table(game);
+    uint64_t hash = 0;
+    for (uint64_t bits = pos.x; bits; bits &= bits - 1)
+        hash ^= keys[0][engine_lowest_cell(bits)];
+    for (uint64_t bits = pos.o; bits; bits &= bits - 1)
+        hash ^= keys[1][engine_lowest_cell(bits)];
+    return hash;
+}
+
+// Hash after side places or removes a stone on cell (the same XOR both ways)
+static inline uint64_t zobrist_toggle(const Game* game, uint64_t hash, int side, int cell) {
+    return hash ^ zobrist_keys[game_slot(game)][side][cell];
+}
+
+// A position that carries its hash along through make/unmake
+typedef struct {
+    Position pos;
+    uint64_t hash;
+} HashedPosition;
+
+static inline void hashed_position_init(HashedPosition* hp, const Game* game, Position pos) {
+    hp->pos = pos;
+    hp->hash = zobrist_hash(game, pos);
+}
+
+static inline void hashed_position_make(HashedPosition* hp, const Game* game, int side, int cell) {
+    position_make(&hp->pos, side, cell);
+    hp->hash = zobrist_toggle(game, hp->hash, side, cell);
+}
+
+static inline void hashed_position_unmake(HashedPosition* hp, const Game* game, int side, int cell) {
+    position_unmake(&hp->pos, cell);
+    hp->hash = zobrist_toggle(game, hp->hash, side, cell);
+}
+
+// Symmetry-invariant hashing keeps the hashes of all 8 images of the position
+// under D4 side by side. keys[side][cell][t] is the key of cell's image under
+// symmetry t, so a move is 8 XORs over one 64-byte line. The smallest of the
+// 8 hashes is the same for every position in a symmetry class.
+typedef struct {
+    uint64_t keys[2][ENGINE_MAX_CELLS][ENGINE_NUM_SYMMETRIES] __attribute__((aligned(64)));
+} ZobristSymmetry;
+
+typedef struct {
+    uint64_t hashes[ENGINE_NUM_SYMMETRIES] __attribute__((aligned(64)));
+} SymmetricHash;
+
+void zobrist_symmetry_init(ZobristSymmetry* symmetry, const Game* game);
+void symmetric_hash_init(SymmetricHash* hash, const ZobristSymmetry* symmetry, Position pos);
+
+static inline void symmetric_hash_toggle(SymmetricHash* hash, const ZobristSymmetry* symmetry, int side, int cell) {
+    const uint64_t* keys = symmetry->keys[side][cell];
+    for (int t = 0; t < ENGINE_NUM_SYMMETRIES; t++)
+        hash->hashes[t] ^= keys[t];
+}
+
+static inline uint64_t symmetric_hash_canonical(const SymmetricHash* hash) {
+    uint64_t best = hash->hashes[0];
+    for (int t = 1; t < ENGINE_NUM_SYMMETRIES; t++)
+        best = hash->hashes[t] < best ? hash->hashes[t] : best;
+    return best;
+}
+
+#endif